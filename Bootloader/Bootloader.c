@@ -12,9 +12,180 @@
 
 
 
+bl_handoff_t bl_handoff __attribute__((section(".bl_handoff")));
+bl_warm_request_t bl_warm_request __attribute__((section(".bl_warm_request")));
+
 void Bootloader_Init(void);
+
+
+void Bootloader_Handoff_Begin(void)
+{
+	/* Invalidate whatever a previous boot left behind */
+	bl_handoff.magic = 0;
+	bl_handoff.magic_inverted = 0;
+
+	bl_handoff.reset_cause = RCC->CSR;
+	RCC->CSR |= RCC_CSR_RMVF;
+
+	bl_handoff.image_size = 0;
+	bl_handoff.image_crc = 0;
+	bl_handoff.image_verified = 0;
+	bl_handoff.timestamps.main_entry = BL_HANDOFF_TIMESTAMP();
+	bl_handoff.timestamps.clock_ready = 0;
+	bl_handoff.timestamps.image_verified = 0;
+	bl_handoff.timestamps.jump = 0;
+}
+
+void Bootloader_Handoff_Set_Image(uint32_t image_size, uint32_t image_crc, bool verified)
+{
+	bl_handoff.image_size = image_size;
+	bl_handoff.image_crc = image_crc;
+	bl_handoff.image_verified = verified ? BL_HANDOFF_IMAGE_VERIFIED : 0U;
+	bl_handoff.timestamps.image_verified = BL_HANDOFF_TIMESTAMP();
+}
+
+bool Bootloader_Take_Warm_Request(bl_warm_request_t *request)
+{
+	/* SRAM only survives a software reset, anything else is stale or random */
+	bool valid = ((bl_handoff.reset_cause & RCC_CSR_SFTRSTF) != 0U) &&
+			(bl_warm_request.magic == BL_WARM_REQUEST_MAGIC) &&
+			(bl_warm_request.magic_inverted == ~BL_WARM_REQUEST_MAGIC);
+
+	*request = bl_warm_request;
+	bl_warm_request.magic = 0;
+	bl_warm_request.magic_inverted = 0;
+
+	if (!valid) return false;
+
+	if (request->transport == BL_TRANSPORT_CAN1) {
+		if (request->baudrate == 0U) request->baudrate = BL_DEFAULT_CAN_BITRATE;
+		return true;
+	}
+	if (request->transport == BL_TRANSPORT_USB_DFU) return true;
+
+	if (request->transport != BL_TRANSPORT_USART1) request->transport = BL_TRANSPORT_UART4;
+	if ((request->baudrate < BL_MIN_BAUDRATE) || (request->baudrate > BL_MAX_BAUDRATE))
+		request->baudrate = BL_DEFAULT_BAUDRATE;
+
+	return true;
+}
+
+static void Bootloader_Handoff_Commit(uint32_t core_clock_hz)
+{
+	bl_handoff.version = BL_HANDOFF_VERSION;
+	bl_handoff.size = sizeof(bl_handoff_t);
+	bl_handoff.bootloader_version = BOOTLOADER_VERSION;
+	bl_handoff.core_clock_hz = core_clock_hz;
+	bl_handoff.timestamps.jump = BL_HANDOFF_TIMESTAMP();
+	bl_handoff.magic = BL_HANDOFF_MAGIC;
+	__DMB();
+	bl_handoff.magic_inverted = ~BL_HANDOFF_MAGIC;
+	__DSB();
+}
+
+
+static bool Section_In_Range(uint32_t start, uint32_t length, uint32_t region_start, uint32_t region_end)
+{
+	return (start >= region_start) && (start < region_end) && (length <= (region_end - start));
+}
+
+static bool Section_Is_Valid(const bl_section_entry_t *entry)
+{
+	if (entry->length == 0U) return false;
+
+	if (!Section_In_Range(entry->load_address, entry->length, APP_START_ADDRESS, APP_END_BOUNDARY_ADDRESS + 1U))
+		return false;
+
+	/* Never over the bootloader's own variables, the copy and CRC loops still use them */
+	if (Section_In_Range(entry->run_address, entry->length, BL_CCMRAM_START, BL_CCMRAM_END))
+		return true;
+
+	/* SRAM targets must also stay clear of the stack we are still running on */
+	return Section_In_Range(entry->run_address, entry->length, BL_SRAM_START,
+			__get_MSP() - BL_SCATTER_STACK_GUARD);
+}
+
+/* A later entry landing on an earlier one would overwrite data that was already checked */
+static bool Sections_Overlap(const bl_section_entry_t *a, const bl_section_entry_t *b)
+{
+	return (a->run_address < b->run_address + b->length) && (b->run_address < a->run_address + a->length);
+}
+
+static uint32_t Section_CRC(uint32_t address, uint32_t length, bool word_aligned)
+{
+	if (word_aligned) {
+		return CRC_Compute_32Bit_Block((volatile uint32_t *)address, length / 4U);
+	}
+	return CRC_Compute_8Bit_Block((volatile uint8_t *)address, length);
+}
+
+static void Section_Copy(const bl_section_entry_t *entry, bool word_aligned)
+{
+	uint32_t source = entry->load_address;
+	uint32_t destination = entry->run_address;
+	uint32_t remaining = entry->length;
+
+	/* CCM RAM sits on the D-bus only, the DMA cannot reach it */
+	if (entry->run_address >= BL_CCMRAM_BASE && entry->run_address < BL_CCMRAM_END) {
+		memcpy((void *)destination, (const void *)source, remaining);
+		return;
+	}
+
+	uint8_t data_size = word_aligned ? 32U : 8U;
+	uint32_t item_size = word_aligned ? 4U : 1U;
+
+	while (remaining > 0U) {
+		uint32_t items = remaining / item_size;
+		if (items > 0xFFFFU) items = 0xFFFFU;
+
+		DMA_Memory_To_Memory_Transfer((volatile void *)source, data_size, 1,
+				(volatile void *)destination, data_size, 1, (uint16_t)items);
+
+		source      += items * item_size;
+		destination += items * item_size;
+		remaining   -= items * item_size;
+	}
+}
+
+bool Bootloader_Scatter_Load(void)
+{
+	const bl_section_table_t *table = (const bl_section_table_t *)APP_SECTION_TABLE_ADDRESS;
+
+	/* The table is optional, images without it are started as-is */
+	if (table->magic != APP_SECTION_TABLE_MAGIC) return true;
+	if (table->count > APP_SECTION_TABLE_MAX_ENTRIES) return false;
+
+	/* Check the whole table before the first copy */
+	for (uint32_t i = 0; i < table->count; i++) {
+		if (!Section_Is_Valid(&table->entries[i])) return false;
+		for (uint32_t j = 0; j < i; j++) {
+			if (Sections_Overlap(&table->entries[i], &table->entries[j])) return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < table->count; i++) {
+		const bl_section_entry_t *entry = &table->entries[i];
+
+		bool word_aligned = ((entry->load_address | entry->run_address | entry->length) & 0x3U) == 0U;
+
+		Section_Copy(entry, word_aligned);
+
+		if (Section_CRC(entry->run_address, entry->length, word_aligned) !=
+				Section_CRC(entry->load_address, entry->length, word_aligned))
+			return false;
+	}
+
+	return true;
+}
+
+
 void Bootloader_Jump(void)
 {
+	/* Scatter-load runs while DMA2 and CRC are still clocked */
+	if (Bootloader_Scatter_Load() == false) return;
+
+	uint32_t core_clock_hz = SystemCoreClock;
+
 	MCU_Clock_DeInit();
 	/* 1. Disable SysTick */
 	SysTick->CTRL = 0;
@@ -83,6 +254,8 @@ void Bootloader_Jump(void)
 
 	__disable_irq();
 
+	Bootloader_Handoff_Commit(core_clock_hz);
+
 	__set_MSP(*((__IO uint32_t*) APP_START_ADDRESS));
 	void (*app_reset_handler)(void) = (void*)(*(volatile uint32_t *)(APP_RESET_HANDLER));
 	app_reset_handler();
@@ -96,19 +269,58 @@ bool Bootloader_Write_Meta_Data(const bl_metadata_t *data)
 	//Erase Flash
 	Flash_Unlock();
 	Flash_Write_Enable();
-	Flash_Erase_Sector(Sector_5);
+	int erase_status = Flash_Erase_Sector(Sector_5);
 	Flash_Write_Disable();
 	Flash_Lock();
 
+	if (erase_status != 0) return false;
+
 	// Program
+	return Flash_Program(BL_METADATA_ADDR, data, sizeof(bl_metadata_t)) == 0;
+}
+
+
+int Bootloader_Stage_Update(uint32_t image_address, uint32_t image_size, uint32_t image_crc)
+{
+	/* Staged image must live in flash above the metadata sector */
+	if ((image_size == 0U) || (image_size > BL_APP_REGION_SIZE)) return BL_STAGE_INVALID_RANGE;
+	if (image_address < BL_STAGING_START_ADDRESS || image_address >= BL_FLASH_END_ADDRESS) return BL_STAGE_INVALID_RANGE;
+	if (image_size > (BL_FLASH_END_ADDRESS - image_address)) return BL_STAGE_INVALID_RANGE;
+
+	CRC_Init();
+	if (CRC_Compute_8Bit_Block((volatile uint8_t *)image_address, image_size) != image_crc) return BL_STAGE_CRC_MISMATCH;
+
+	/* From here on the caller's code is being erased, nothing may run from sector 4 */
+	__disable_irq();
+
 	Flash_Unlock();
-	//	Flash_Write_Enable();
-	FLASH->CR &= ~FLASH_CR_PSIZE;
-	FLASH->CR |= (0 << FLASH_CR_PSIZE_Pos);
-	FLASH->CR |= FLASH_CR_PG;
-	DMA_Memory_To_Memory_Transfer((uint8_t *)data, 8, 1, (uint32_t)BL_METADATA_ADDR, 8, 1, sizeof(bl_metadata_t));
-	Flash_Write_Disable();
+	int erase_status = Flash_Erase_Sector(Sector_4_0x08010000);
+	if (erase_status == 0) erase_status = Flash_Erase_Sector(Sector_5);
 	Flash_Lock();
 
+	uint32_t size_crc[2] = { __REV(image_size), __REV(image_crc) };
 
+	if ((erase_status == 0) && Flash_Program_Fixed_Stream(APP_START_ADDRESS, (const volatile void *)image_address, image_size) == 0) {
+		Flash_Program_Fixed_Stream(APP_SIZE_ADDRESS, size_crc, sizeof(size_crc));
+	}
+
+	/* On an erase or programming error the metadata stays erased and the next boot stays in the bootloader */
+	NVIC_SystemReset();
+	return BL_STAGE_OK;
 }
+
+
+const bl_service_table_t bl_service_table __attribute__((section(".bl_service_table"), used)) =
+{
+	.magic = BL_SERVICE_TABLE_MAGIC,
+	.version = BL_SERVICE_TABLE_VERSION,
+	.size = sizeof(bl_service_table_t),
+	.CRC_Compute_8Bit_Block = CRC_Compute_8Bit_Block,
+	.CRC_Compute_32Bit_Block = CRC_Compute_32Bit_Block,
+	.Flash_Unlock = Flash_Unlock,
+	.Flash_Lock = Flash_Lock,
+	.Flash_Erase_Sector = Flash_Erase_Sector,
+	.Flash_Program = Flash_Program_Fixed_Stream,
+	.DMA_Memory_To_Memory_Transfer = DMA_Fixed_Stream_Transfer,
+	.Stage_Update = Bootloader_Stage_Update,
+};
@@ -10,6 +10,8 @@
 
 #include "main.h"
 #include "Flash/Flash.h"
+#include "CRC/CRC.h"
+#include "Timebase/Timebase.h"
 
 #define CHUNK_SIZE                          ((uint32_t)256U)
 #define APP_START_ADDRESS                   0x08010000U
@@ -19,6 +21,56 @@
 #define APP_SIZE_ADDRESS                    0x08020000U
 #define APP_CRC_ADDRESS                     0x08020004U
 
+#define APP_SECTION_TABLE_ADDRESS           (APP_START_ADDRESS + 0x200U)
+#define APP_SECTION_TABLE_MAGIC             0x4E544353U   /* "SCTN" */
+#define APP_SECTION_TABLE_MAX_ENTRIES       8U
+
+#define BOOTLOADER_VERSION                  0x01U
+#define BL_APP_REGION_SIZE                  (APP_END_BOUNDARY_ADDRESS - APP_START_ADDRESS + 1U)
+
+#define BL_STAGING_START_ADDRESS            0x08040000U   /* sector 6 onwards */
+#define BL_FLASH_END_ADDRESS                0x08100000U
+
+#define BL_SERVICE_TABLE_ADDRESS            0x08000200U
+#define BL_SERVICE_TABLE_MAGIC              0x53565243U   /* "CRVS" */
+#define BL_SERVICE_TABLE_VERSION            2U            /* 2: Flash_Erase_Sector returns a status */
+
+#define BL_SHARED_RAM_START                 0x20000000U
+#define BL_SHARED_RAM_END                   0x20000100U
+#define BL_HANDOFF_ADDRESS                  BL_SHARED_RAM_START
+#define BL_HANDOFF_MAGIC                    0x484E4442U   /* "BDNH" */
+#define BL_HANDOFF_VERSION                  2U
+#define BL_HANDOFF_IMAGE_VERIFIED           0x56455246U   /* "FREV" */
+
+#define BL_WARM_REQUEST_ADDRESS             (BL_SHARED_RAM_START + 0x80U)
+#define BL_WARM_REQUEST_MAGIC               0x4D524157U   /* "WARM" */
+
+#define BL_DEFAULT_BAUDRATE                 256000U
+#define BL_MIN_BAUDRATE                     1200U
+#define BL_MAX_BAUDRATE                     2625000U      /* APB1 42 MHz / 16 */
+#define BL_UART_AUTOBAUD                    1U            /* UART4 follows the rate of the host's frame header until Connect */
+
+#define BL_NODE_CONFIG_ADDRESS              0x1FFF7800U   /* OTP block 0: node address, multicast group */
+#define BL_NODE_UNASSIGNED                  0xFFU
+
+#define BL_DEFAULT_TRANSPORT                BL_TRANSPORT_UART4   /* rate given after a cold boot */
+#define BL_LISTEN_TRANSPORTS                ((1U << BL_TRANSPORT_UART4) | (1U << BL_TRANSPORT_CAN1) | (1U << BL_TRANSPORT_USART1))
+#define BL_DEBUG_BAUDRATE                   115200U       /* USART1 debug header */
+#define BL_DEFAULT_CAN_BITRATE              500000U
+#define BL_CAN_REQUEST_ID_BASE              0x400U        /* + 2 * node: request ID pair, see CAN_Comm.h */
+#define BL_CAN_RESPONSE_ID_BASE             0x600U        /* + node */
+
+#define BL_SRAM_START                       ((uint32_t)&_end)        /* past the bootloader's .data, .bss and .noinit */
+#define BL_SRAM_END                         0x20020000U
+#define BL_CCMRAM_START                     ((uint32_t)&_eccmram)
+#define BL_CCMRAM_BASE                      0x10000000U
+#define BL_CCMRAM_END                       0x10010000U
+#define BL_SCATTER_STACK_GUARD              0x400U
+
+/* Linker symbols: ends of the bootloader's own RAM use */
+extern uint32_t _end;
+extern uint32_t _eccmram;
+
 
 typedef struct __attribute__((packed))
 {
@@ -37,17 +89,172 @@ typedef struct __attribute__((packed))
 #define BL_METADATA_ADDR   ((uint32_t)0x08020000U)
 
 
+/*
+ * Optional scatter-load table placed by the application at
+ * APP_SECTION_TABLE_ADDRESS (right after its vector table).
+ * Each entry is copied from its flash load address to its RAM run
+ * address before the jump, and the copy is CRC checked against the source.
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t load_address;
+    uint32_t run_address;
+    uint32_t length;
+} bl_section_entry_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t count;
+    bl_section_entry_t entries[APP_SECTION_TABLE_MAX_ENTRIES];
+} bl_section_table_t;
+
+
+
+
+
+/*
+ * Handoff block left at BL_HANDOFF_ADDRESS for the application. Written by
+ * Bootloader_Jump() immediately before the jump; the application should
+ * check magic and magic_inverted before trusting the rest.
+ * Timestamps are microseconds since reset from the Timebase driver, so
+ * main_entry is the cost of the C runtime init (version 1 used raw cycles).
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                  /* sizeof(bl_handoff_t) */
+    uint32_t bootloader_version;
+    uint32_t reset_cause;           /* RCC->CSR latched at bootloader entry, then cleared */
+    uint32_t image_size;
+    uint32_t image_crc;
+    uint32_t image_verified;        /* BL_HANDOFF_IMAGE_VERIFIED when the CRC matched */
+    uint32_t core_clock_hz;
+    struct {
+        uint32_t main_entry;
+        uint32_t clock_ready;
+        uint32_t image_verified;
+        uint32_t jump;
+    } timestamps;
+    uint32_t magic_inverted;        /* ~magic, written last */
+} bl_handoff_t;
+
+extern bl_handoff_t bl_handoff;
+
 
+typedef enum
+{
+    BL_TRANSPORT_UART4 = 0,
+    BL_TRANSPORT_CAN1  = 1,
+    BL_TRANSPORT_USB_DFU = 2,   /* OTG FS, DFU 1.1; baudrate is ignored */
+    BL_TRANSPORT_USART1  = 3,   /* debug header */
+} bl_transport_t;
+
+/*
+ * Warm entry request at BL_WARM_REQUEST_ADDRESS. The application fills it
+ * and issues NVIC_SystemReset(); the bootloader consumes it on the next
+ * software reset, skips the LED delay and listens straight away.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t baudrate;          /* UART baud rate or CAN bit rate, 0 selects the default */
+    uint32_t transport;         /* bl_transport_t */
+    uint32_t magic_inverted;
+} bl_warm_request_t;
+
+
+typedef enum
+{
+    BL_STAGE_OK             = 0,
+    BL_STAGE_INVALID_RANGE  = -1,
+    BL_STAGE_CRC_MISMATCH   = -2,
+} bl_stage_status_t;
+
+/*
+ * Bootloader services exported at BL_SERVICE_TABLE_ADDRESS, in the spirit of
+ * a ROM API. None of these touch bootloader RAM, they only use the caller's
+ * stack. The caller must have the CRC clock enabled for the CRC entries and
+ * must not be using DMA2 Stream0 while calling the flash/DMA entries.
+ * Flash timeouts count DWT->CYCCNT, which the flash entries enable, at
+ * 168 MHz; at a slower core clock they are proportionally longer.
+ *
+ * Version 2: Flash_Erase_Sector returns 0, or 1 if the flash stayed busy
+ * (version 1 returned nothing). Flash_Program returns 0 or 1 in both.
+ *
+ * Stage_Update() verifies an image the application already wrote to
+ * BL_STAGING_START_ADDRESS or above, then copies it over the application
+ * with interrupts disabled and resets. It only returns on a validation error.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t (*CRC_Compute_8Bit_Block)(volatile uint8_t *wordBlock, size_t length);
+    uint32_t (*CRC_Compute_32Bit_Block)(volatile uint32_t *wordBlock, size_t length);
+    void (*Flash_Unlock)(void);
+    void (*Flash_Lock)(void);
+    int  (*Flash_Erase_Sector)(Flash_Sectors_Typedef sector_number);
+    int (*Flash_Program)(uint32_t Flash_Address, const volatile void *data, uint32_t length);
+    void (*DMA_Memory_To_Memory_Transfer)(volatile void *source,
+            uint8_t source_data_size, bool source_increment,
+            volatile void *destination, uint8_t dest_data_size,
+            bool destination_increment, uint16_t length);
+    int (*Stage_Update)(uint32_t image_address, uint32_t image_size, uint32_t image_crc);
+} bl_service_table_t;
+
+#define BL_SERVICES                ((const bl_service_table_t *)BL_SERVICE_TABLE_ADDRESS)
+
+#define BL_HANDOFF_TIMESTAMP()     ((uint32_t)Timebase_Now_us())
 
 
 void Bootloader_Init(void);
+void Bootloader_Handoff_Begin(void);
+void Bootloader_Handoff_Set_Image(uint32_t image_size, uint32_t image_crc, bool verified);
+bool Bootloader_Take_Warm_Request(bl_warm_request_t *request);
 void Bootloader_Jump(void);
+bool Bootloader_Scatter_Load(void);
 
 bool Bootloader_Write_Meta_Data(const bl_metadata_t *data);
+int Bootloader_Stage_Update(uint32_t image_address, uint32_t image_size, uint32_t image_crc);
 static inline void Bootloader_Read_Meta_Data(bl_metadata_t *data)
 {
     memcpy(data, (const void *)BL_METADATA_ADDR, sizeof(bl_metadata_t));
 }
 
+/* For the application: reboot straight into the bootloader's update mode */
+static inline void Bootloader_Request_Warm_Entry(uint32_t baudrate, bl_transport_t transport)
+{
+    volatile bl_warm_request_t *request = (volatile bl_warm_request_t *)BL_WARM_REQUEST_ADDRESS;
+    request->baudrate = baudrate;
+    request->transport = transport;
+    request->magic = BL_WARM_REQUEST_MAGIC;
+    request->magic_inverted = ~BL_WARM_REQUEST_MAGIC;
+    __DSB();
+    NVIC_SystemReset();
+}
+
+/* Address on a shared bus, BL_NODE_UNASSIGNED until programmed into OTP */
+static inline uint8_t Bootloader_Node_Address(void)
+{
+	return *(const volatile uint8_t *)BL_NODE_CONFIG_ADDRESS;
+}
+
+/* Multicast group 0xF0 - 0xFE this node also listens to, BL_NODE_UNASSIGNED for none */
+static inline uint8_t Bootloader_Node_Group(void)
+{
+	return *(const volatile uint8_t *)(BL_NODE_CONFIG_ADDRESS + 1U);
+}
+
+/* For the application: returns the handoff block, or NULL when the bootloader left none */
+static inline const bl_handoff_t *Bootloader_Get_Handoff(void)
+{
+    const bl_handoff_t *handoff = (const bl_handoff_t *)BL_HANDOFF_ADDRESS;
+    if ((handoff->magic != BL_HANDOFF_MAGIC) || (handoff->magic_inverted != ~BL_HANDOFF_MAGIC)) return NULL;
+    return handoff;
+}
+
 
 #endif /* BOOTLOADER_H_ */
@@ -0,0 +1,102 @@
+/*
+ * Autobaud.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "Autobaud.h"
+
+static const uint8_t autobaud_edge_bits[AUTOBAUD_HEADER_EDGES - 2U] = {3, 5, 7};
+
+// Edge offset in hundredths of a bit is within tolerance of bits
+static bool Autobaud_Near(uint32_t offset, uint32_t span, uint32_t bits)
+{
+	int32_t error = (int32_t)(100U * offset) - (int32_t)(10U * bits * span);
+	if (error < 0) error = -error;
+	return (uint32_t)error <= (AUTOBAUD_TOLERANCE_PCT * span / 10U);
+}
+
+// The last AUTOBAUD_HEADER_EDGES edges look like the 0xAA byte plus the next start bit
+static bool Autobaud_Header(const Autobaud *autobaud)
+{
+	uint32_t span = autobaud->edge[AUTOBAUD_HEADER_EDGES - 1U] - autobaud->edge[0];
+
+	if ((span < (10U * autobaud->min_bit_ticks)) || (span > (10U * autobaud->max_bit_ticks))) return false;
+
+	for (uint8_t i = 0; i < (AUTOBAUD_HEADER_EDGES - 2U); i++) {
+		if (!Autobaud_Near(autobaud->edge[i + 1U] - autobaud->edge[0], span, autobaud_edge_bits[i])) return false;
+	}
+	return true;
+}
+
+void Autobaud_Reset(Autobaud *autobaud, uint32_t min_bit_ticks, uint32_t max_bit_ticks)
+{
+	autobaud->min_bit_ticks = min_bit_ticks;
+	autobaud->max_bit_ticks = max_bit_ticks;
+	autobaud->edges = 0;
+	autobaud->span = 0;
+	autobaud->second = 0x56;
+	autobaud->state = AUTOBAUD_WAIT;
+}
+
+/*
+ * Feed every falling edge of RX. Until a header is found the edges slide
+ * through a window of five, so noise or the tail of a frame ahead of the
+ * header costs nothing. Short enough for an edge interrupt: a handful of
+ * multiplies per edge, no division.
+ */
+Autobaud_State Autobaud_Edge(Autobaud *autobaud, uint32_t timestamp)
+{
+	uint32_t offset;
+
+	switch (autobaud->state) {
+	case AUTOBAUD_WAIT:
+		if (autobaud->edges == AUTOBAUD_HEADER_EDGES) {
+			for (uint8_t i = 1; i < AUTOBAUD_HEADER_EDGES; i++) autobaud->edge[i - 1U] = autobaud->edge[i];
+			autobaud->edges--;
+		}
+		autobaud->edge[autobaud->edges++] = timestamp;
+
+		if ((autobaud->edges == AUTOBAUD_HEADER_EDGES) && Autobaud_Header(autobaud)) {
+			autobaud->span = timestamp - autobaud->edge[0];
+			autobaud->second = 0x56;
+			autobaud->state = AUTOBAUD_MEASURED;
+		}
+		break;
+
+	case AUTOBAUD_MEASURED:
+		offset = timestamp - autobaud->edge[0];
+		if (Autobaud_Near(offset, autobaud->span, 12)) {
+			autobaud->second = 0x55;
+		} else if ((20U * offset) >= (35U * autobaud->span)) {
+			// 17.5 bits on: the edge at 18, the receiver has until the next start bit at 20
+			if ((20U * offset) < (39U * autobaud->span)) {
+				autobaud->state = AUTOBAUD_LOCKED;
+			} else {
+				// Not a header after all, this edge may start the next one
+				autobaud->edge[0] = timestamp;
+				autobaud->edges = 1;
+				autobaud->state = AUTOBAUD_WAIT;
+			}
+		}
+		break;
+
+	case AUTOBAUD_LOCKED:
+		break;
+	}
+
+	return autobaud->state;
+}
+
+uint32_t Autobaud_Baudrate(const Autobaud *autobaud, uint32_t tick_hz)
+{
+	if (autobaud->span == 0U) return 0;
+	return (uint32_t)((((uint64_t)tick_hz * 10U) + (autobaud->span / 2U)) / autobaud->span);
+}
+
+// BRR = PCLK / baud = bit ticks / clock_ratio, rounded; mantissa and fraction fall out as is
+uint16_t Autobaud_BRR(const Autobaud *autobaud, uint32_t clock_ratio)
+{
+	uint32_t divisor = 10U * clock_ratio;
+	return (uint16_t)((autobaud->span + (divisor / 2U)) / divisor);
+}
@@ -0,0 +1,55 @@
+/*
+ * Autobaud.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef AUTOBAUD_AUTOBAUD_H_
+#define AUTOBAUD_AUTOBAUD_H_
+
+#include "main.h"
+
+/*
+ * Bit rate from the falling edges of the AA 55 (or AA 56) frame header,
+ * 8N1, LSB first. Counted in bit times from the start bit of 0xAA:
+ *
+ *   AA: start 0, then 3, 5, 7      55: start 10, then 12, 14, 16, 18
+ *                                  56: start 10, then     14, 16, 18
+ *
+ * The first five edges (0 - 10) are the same for both and give the rate,
+ * with 3, 5 and 7 checked against it. The edge at 18 is the last one
+ * before the stop bit of the second byte: from there until the next start
+ * bit the receiver can be switched on and picks up the following byte
+ * cleanly. Hardware free, timestamps come from any free running counter.
+ */
+
+#define AUTOBAUD_HEADER_EDGES     5U      // falling edges up to the start bit of the second byte
+#define AUTOBAUD_TOLERANCE_PCT    30U     // of a bit time, per checked edge
+
+typedef enum Autobaud_State
+{
+	AUTOBAUD_WAIT = 0,             // collecting the 0xAA edges
+	AUTOBAUD_MEASURED,             // rate known, waiting for the last edge of the second byte
+	AUTOBAUD_LOCKED,               // switch the receiver on now
+}Autobaud_State;
+
+typedef struct Autobaud
+{
+	uint32_t min_bit_ticks;        // fastest rate accepted
+	uint32_t max_bit_ticks;        // slowest rate accepted
+	uint32_t edge[AUTOBAUD_HEADER_EDGES];     // last edges seen, edge[0] is the 0xAA start bit once measured
+	uint32_t span;                 // ten bit times, 0xAA start bit to the start bit of the second byte
+	uint8_t edges;
+	uint8_t second;                // 0x55 or 0x56, told apart by the edge at 12
+	Autobaud_State state;
+}Autobaud;
+
+void Autobaud_Reset(Autobaud *autobaud, uint32_t min_bit_ticks, uint32_t max_bit_ticks);
+Autobaud_State Autobaud_Edge(Autobaud *autobaud, uint32_t timestamp);
+
+/* Valid once AUTOBAUD_MEASURED: bit rate for a tick_hz counter, USART BRR (oversampling 16) for clock_ratio = tick_hz / PCLK */
+uint32_t Autobaud_Baudrate(const Autobaud *autobaud, uint32_t tick_hz);
+uint16_t Autobaud_BRR(const Autobaud *autobaud, uint32_t clock_ratio);
+
+
+#endif /* AUTOBAUD_AUTOBAUD_H_ */
@@ -5,8 +5,341 @@
  *      Author: kunal
  */
 
-
 #include "CAN.h"
 
+CAN_Config *__can_1_config__;
+CAN_Config *__can_2_config__;
+
+static int8_t CAN_Clock_Enable(CAN_Config *config)
+{
+	if(config->CAN_Port == CAN1)
+	{
+		RCC -> APB1ENR |= RCC_APB1ENR_CAN1EN;
+	}
+	else if(config->CAN_Port == CAN2)
+	{
+		// CAN2 is a slave of CAN1, the filter banks are only reachable through CAN1
+		RCC -> APB1ENR |= RCC_APB1ENR_CAN1EN | RCC_APB1ENR_CAN2EN;
+	}
+	else
+	{
+		return -1;
+	}
+	return 1;
+}
+
+static void CAN_Pin_Init(GPIO_TypeDef *port, uint8_t pin)
+{
+	GPIO_Pin_Init(port, pin, GPIO_Configuration.Mode.Alternate_Function, GPIO_Configuration.Output_Type.Push_Pull, GPIO_Configuration.Speed.Very_High_Speed, GPIO_Configuration.Pull.Pull_Up, GPIO_Configuration.Alternate_Functions.CAN_1);
+}
+
+static int8_t PIN_Setup(CAN_Config *config)
+{
+	if(config->CAN_Port == CAN1)
+	{
+		__can_1_config__ = config;
+
+		if(config->RX_Pin == CAN_Configuration.Pin._CAN1.RX.PA11)CAN_Pin_Init(GPIOA, 11);
+		else if(config->RX_Pin == CAN_Configuration.Pin._CAN1.RX.PD0)CAN_Pin_Init(GPIOD, 0);
+		else if(config->RX_Pin == CAN_Configuration.Pin._CAN1.RX.PB8)CAN_Pin_Init(GPIOB, 8);
+		else return -1;
+
+		if(config->TX_Pin == CAN_Configuration.Pin._CAN1.TX.PA12)CAN_Pin_Init(GPIOA, 12);
+		else if(config->TX_Pin == CAN_Configuration.Pin._CAN1.TX.PD1)CAN_Pin_Init(GPIOD, 1);
+		else if(config->TX_Pin == CAN_Configuration.Pin._CAN1.TX.PB9)CAN_Pin_Init(GPIOB, 9);
+		else return -1;
+	}
+	else if(config->CAN_Port == CAN2)
+	{
+		__can_2_config__ = config;
+
+		if(config->RX_Pin == CAN_Configuration.Pin._CAN2.RX.PB12)CAN_Pin_Init(GPIOB, 12);
+		else if(config->RX_Pin == CAN_Configuration.Pin._CAN2.RX.PB5)CAN_Pin_Init(GPIOB, 5);
+		else return -1;
+
+		if(config->TX_Pin == CAN_Configuration.Pin._CAN2.TX.PB13)CAN_Pin_Init(GPIOB, 13);
+		else if(config->TX_Pin == CAN_Configuration.Pin._CAN2.TX.PB6)CAN_Pin_Init(GPIOB, 6);
+		else return -1;
+	}
+	else
+	{
+		return -1;
+	}
+	return 1;
+}
+
+static void CAN_NVIC_Setup(CAN_Config *config)
+{
+	uint32_t ier = (uint32_t)config->interrupt;
+	uint32_t rx0 = CAN_IER_FMPIE0 | CAN_IER_FFIE0 | CAN_IER_FOVIE0;
+	uint32_t rx1 = CAN_IER_FMPIE1 | CAN_IER_FFIE1 | CAN_IER_FOVIE1;
+	uint32_t sce = CAN_IER_ERRIE | CAN_IER_WKUIE | CAN_IER_SLKIE;
+
+	// One priority for all four vectors: the handlers never preempt each other
+	if(config->CAN_Port == CAN1)
+	{
+		if(ier & CAN_IER_TMEIE){NVIC_SetPriority(CAN1_TX_IRQn, 1); NVIC_EnableIRQ(CAN1_TX_IRQn);}
+		if(ier & rx0){NVIC_SetPriority(CAN1_RX0_IRQn, 1); NVIC_EnableIRQ(CAN1_RX0_IRQn);}
+		if(ier & rx1){NVIC_SetPriority(CAN1_RX1_IRQn, 1); NVIC_EnableIRQ(CAN1_RX1_IRQn);}
+		if(ier & sce){NVIC_SetPriority(CAN1_SCE_IRQn, 1); NVIC_EnableIRQ(CAN1_SCE_IRQn);}
+	}
+	else
+	{
+		if(ier & CAN_IER_TMEIE){NVIC_SetPriority(CAN2_TX_IRQn, 1); NVIC_EnableIRQ(CAN2_TX_IRQn);}
+		if(ier & rx0){NVIC_SetPriority(CAN2_RX0_IRQn, 1); NVIC_EnableIRQ(CAN2_RX0_IRQn);}
+		if(ier & rx1){NVIC_SetPriority(CAN2_RX1_IRQn, 1); NVIC_EnableIRQ(CAN2_RX1_IRQn);}
+		if(ier & sce){NVIC_SetPriority(CAN2_SCE_IRQn, 1); NVIC_EnableIRQ(CAN2_SCE_IRQn);}
+	}
+}
+
+/*
+ * Brings the controller up in normal mode at config->Baudrate. Transmit
+ * mailboxes go out in request order (TXFP) so a segmented message can use
+ * all three without being reordered by identifier priority, and bus-off is
+ * left automatically (ABOM). No filter is active afterwards, see CAN_Filter_Set().
+ * Returns -1 for an unknown port or pin, -2 if the controller did not leave
+ * initialisation mode (no transceiver or bus stuck dominant).
+ */
+int8_t CAN_Init(CAN_Config *config)
+{
+	if(CAN_Clock_Enable(config) < 0) return -1;
+	if(PIN_Setup(config) < 0) return -1;
+
+	CAN_TypeDef *port = config->CAN_Port;
+
+	port->MCR &= ~CAN_MCR_SLEEP;
+	port->MCR |= CAN_MCR_INRQ;
+	if(!Timebase_Wait_Until((port->MSR & CAN_MSR_INAK) != 0U, CAN_MODE_TIMEOUT_US)) return -2;
+
+	port->MCR = CAN_MCR_INRQ | CAN_MCR_TXFP | CAN_MCR_ABOM | (config->timestamp_enable ? CAN_MCR_TTCM : 0U);
+	port->BTR = config->Baudrate & (CAN_BTR_SJW | CAN_BTR_TS2 | CAN_BTR_TS1 | CAN_BTR_BRP);
+	port->IER = (uint32_t)config->interrupt;
+
+	CAN_NVIC_Setup(config);
+
+	port->MCR &= ~CAN_MCR_INRQ;
+	if(!Timebase_Wait_Until((port->MSR & CAN_MSR_INAK) == 0U, CAN_MODE_TIMEOUT_US)) return -2;
+
+	return 1;
+}
+
+/*
+ * Accepts standard identifiers with (received & mask) == (id & mask) into
+ * fifo, using bank as one 32 bit mask filter. Data frames only.
+ */
+int8_t CAN_Filter_Set(uint8_t bank, uint32_t id, uint32_t mask, uint8_t fifo)
+{
+	if((bank >= CAN_FILTER_BANKS) || (fifo >= CAN_RX_FIFOS)) return -1;
+
+	uint32_t bit = 1UL << bank;
+
+	CAN1->FMR |= CAN_FMR_FINIT;
+	CAN1->FA1R &= ~bit;
+
+	CAN1->FM1R &= ~bit;                       // mask mode
+	CAN1->FS1R |= bit;                        // single 32 bit scale
+	if(fifo) CAN1->FFA1R |= bit;
+	else CAN1->FFA1R &= ~bit;
+
+	CAN1->sFilterRegister[bank].FR1 = (id & 0x7FFU) << CAN_TI0R_STID_Pos;
+	CAN1->sFilterRegister[bank].FR2 = ((mask & 0x7FFU) << CAN_TI0R_STID_Pos) | CAN_TI0R_IDE | CAN_TI0R_RTR;
+
+	CAN1->FA1R |= bit;
+	CAN1->FMR &= ~CAN_FMR_FINIT;
+
+	return 1;
+}
+
+/* Loads frame into the next empty mailbox; returns the mailbox, or -1 when all three are pending */
+int8_t CAN_Transmit(CAN_Config *config, const CAN_Frame *frame)
+{
+	CAN_TypeDef *port = config->CAN_Port;
+	uint32_t tsr = port->TSR;
+
+	if((tsr & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) == 0U) return -1;
+
+	uint8_t mailbox = (tsr & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+	CAN_TxMailBox_TypeDef *box = &port->sTxMailBox[mailbox];
+
+	box->TDTR = frame->dlc & 0x0FU;
+	box->TDLR = ((uint32_t)frame->data[3] << 24) | ((uint32_t)frame->data[2] << 16) |
+			((uint32_t)frame->data[1] << 8) | frame->data[0];
+	box->TDHR = ((uint32_t)frame->data[7] << 24) | ((uint32_t)frame->data[6] << 16) |
+			((uint32_t)frame->data[5] << 8) | frame->data[4];
+
+	uint32_t tir = (frame->rtr == CAN_Configuration.Frame.Remote_Frame) ? CAN_TI0R_RTR : 0U;
+	if(frame->ide == CAN_Configuration.ID.Extended)
+		tir |= ((frame->id & 0x1FFFFFFFU) << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE;
+	else
+		tir |= (frame->id & 0x7FFU) << CAN_TI0R_STID_Pos;
+
+	box->TIR = tir | CAN_TI0R_TXRQ;
+
+	return (int8_t)mailbox;
+}
+
+uint8_t CAN_TX_Free(CAN_Config *config)
+{
+	uint32_t tsr = config->CAN_Port->TSR;
+	return ((tsr & CAN_TSR_TME0) ? 1U : 0U) + ((tsr & CAN_TSR_TME1) ? 1U : 0U) + ((tsr & CAN_TSR_TME2) ? 1U : 0U);
+}
+
+bool CAN_TX_Idle(CAN_Config *config)
+{
+	uint32_t empty = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+	return (config->CAN_Port->TSR & empty) == empty;
+}
+
+uint8_t CAN_RX_Pending(CAN_Config *config, uint8_t fifo)
+{
+	volatile uint32_t *rfr = fifo ? &config->CAN_Port->RF1R : &config->CAN_Port->RF0R;
+	return *rfr & CAN_RF0R_FMP0;
+}
+
+/* Copies out and releases the oldest frame in fifo; false when the FIFO is empty */
+bool CAN_Receive(CAN_Config *config, uint8_t fifo, CAN_Frame *frame)
+{
+	CAN_TypeDef *port = config->CAN_Port;
+	volatile uint32_t *rfr = fifo ? &port->RF1R : &port->RF0R;
+
+	if((*rfr & CAN_RF0R_FMP0) == 0U) return false;
+
+	CAN_FIFOMailBox_TypeDef *box = &port->sFIFOMailBox[fifo];
+	uint32_t rir = box->RIR;
+	uint32_t rdtr = box->RDTR;
+	uint32_t rdlr = box->RDLR;
+	uint32_t rdhr = box->RDHR;
+
+	*rfr = CAN_RF0R_RFOM0;
+
+	if(rir & CAN_RI0R_IDE)
+	{
+		frame->ide = CAN_Configuration.ID.Extended;
+		frame->id = rir >> CAN_RI0R_EXID_Pos;
+	}
+	else
+	{
+		frame->ide = CAN_Configuration.ID.Standard;
+		frame->id = rir >> CAN_RI0R_STID_Pos;
+	}
+	frame->rtr = (rir & CAN_RI0R_RTR) ? CAN_Configuration.Frame.Remote_Frame : CAN_Configuration.Frame.Data_Frame;
+	frame->dlc = (rdtr & CAN_RDT0R_DLC) > 8U ? 8U : (rdtr & CAN_RDT0R_DLC);
+	frame->filter = (rdtr & CAN_RDT0R_FMI) >> CAN_RDT0R_FMI_Pos;
+	frame->timestamp = (rdtr & CAN_RDT0R_TIME) >> CAN_RDT0R_TIME_Pos;
+
+	for(uint8_t i = 0; i < 4U; i++)
+	{
+		frame->data[i] = rdlr >> (8U * i);
+		frame->data[i + 4U] = rdhr >> (8U * i);
+	}
+
+	return true;
+}
+
+static void CAN_TX_ISR(CAN_Config *config)
+{
+	if(config == NULL) return;
+
+	// Write one to clear every completed request, including aborted and lost arbitration ones
+	config->CAN_Port->TSR = config->CAN_Port->TSR & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2);
+	if(config->ISR_Routines.Transmit_Mailbox_Empty_ISR != NULL) config->ISR_Routines.Transmit_Mailbox_Empty_ISR();
+}
+
+static void CAN_RX_ISR(CAN_Config *config, uint8_t fifo)
+{
+	if(config == NULL) return;
+
+	volatile uint32_t *rfr = fifo ? &config->CAN_Port->RF1R : &config->CAN_Port->RF0R;
+	uint32_t status = *rfr;
+
+	if(status & CAN_RF0R_FOVR0)
+	{
+		*rfr = CAN_RF0R_FOVR0;
+		if(config->ISR_Routines.FIFO_Overrun_ISR != NULL) config->ISR_Routines.FIFO_Overrun_ISR();
+	}
+	if(status & CAN_RF0R_FULL0)
+	{
+		*rfr = CAN_RF0R_FULL0;
+		if(config->ISR_Routines.FIFO_Full_ISR != NULL) config->ISR_Routines.FIFO_Full_ISR();
+	}
+
+	// FMPIE is level triggered, the handler has to empty the FIFO or it fires again
+	if(status & CAN_RF0R_FMP0)
+	{
+		if(config->ISR_Routines.FIFO_Message_Pending_ISR != NULL) config->ISR_Routines.FIFO_Message_Pending_ISR();
+		else while(CAN_RX_Pending(config, fifo)) *rfr = CAN_RF0R_RFOM0;
+	}
+}
+
+static void CAN_SCE_ISR(CAN_Config *config)
+{
+	if(config == NULL) return;
+
+	CAN_TypeDef *port = config->CAN_Port;
+	uint32_t msr = port->MSR;
+	uint32_t esr = port->ESR;
+
+	if(msr & CAN_MSR_WKUI)
+	{
+		port->MSR = CAN_MSR_WKUI;
+		if(config->ISR_Routines.Wake_UP_ISR != NULL) config->ISR_Routines.Wake_UP_ISR();
+	}
+	if(msr & CAN_MSR_SLAKI)
+	{
+		port->MSR = CAN_MSR_SLAKI;
+		if(config->ISR_Routines.Sleep_ISR != NULL) config->ISR_Routines.Sleep_ISR();
+	}
+	if(msr & CAN_MSR_ERRI)
+	{
+		port->MSR = CAN_MSR_ERRI;
+		if((esr & CAN_ESR_BOFF) && (config->ISR_Routines.Bus_off_ISR != NULL)) config->ISR_Routines.Bus_off_ISR();
+		if((esr & CAN_ESR_EPVF) && (config->ISR_Routines.Error_Passive_ISR != NULL)) config->ISR_Routines.Error_Passive_ISR();
+		if((esr & CAN_ESR_EWGF) && (config->ISR_Routines.Error_Warning_ISR != NULL)) config->ISR_Routines.Error_Warning_ISR();
+		if(esr & CAN_ESR_LEC)
+		{
+			port->ESR &= ~CAN_ESR_LEC;
+			if(config->ISR_Routines.Last_Error_Code_ISR != NULL) config->ISR_Routines.Last_Error_Code_ISR();
+		}
+		if(config->ISR_Routines.Error_ISR != NULL) config->ISR_Routines.Error_ISR();
+	}
+}
+
+void CAN1_TX_IRQHandler(void)
+{
+	CAN_TX_ISR(__can_1_config__);
+}
+
+void CAN1_RX0_IRQHandler(void)
+{
+	CAN_RX_ISR(__can_1_config__, 0);
+}
+
+void CAN1_RX1_IRQHandler(void)
+{
+	CAN_RX_ISR(__can_1_config__, 1);
+}
+
+void CAN1_SCE_IRQHandler(void)
+{
+	CAN_SCE_ISR(__can_1_config__);
+}
+
+void CAN2_TX_IRQHandler(void)
+{
+	CAN_TX_ISR(__can_2_config__);
+}
+
+void CAN2_RX0_IRQHandler(void)
+{
+	CAN_RX_ISR(__can_2_config__, 0);
+}
 
+void CAN2_RX1_IRQHandler(void)
+{
+	CAN_RX_ISR(__can_2_config__, 1);
+}
 
+void CAN2_SCE_IRQHandler(void)
+{
+	CAN_SCE_ISR(__can_2_config__);
+}
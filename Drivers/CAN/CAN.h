@@ -10,16 +10,23 @@
 
 #include "main.h"
 #include "GPIO/GPIO.h"
+#include "Timebase/Timebase.h"
+#include "CAN_Defs.h"
 //#include "Timer/Timer.h"
 
+#define CAN_TX_MAILBOXES        3U
+#define CAN_RX_FIFOS            2U
+#define CAN_FILTER_BANKS        28U      // shared by CAN1 and CAN2, the registers live in CAN1
+#define CAN_MODE_TIMEOUT_US     10000U   // INAK handshake, needs 11 recessive bits on the bus
+
 typedef struct CAN_Config
 {
 	CAN_TypeDef *CAN_Port;
 	uint8_t RX_Pin;
 	uint8_t TX_Pin;
-	uint32_t Baudrate;
+	uint32_t Baudrate;               // CAN_Configuration.Baudrate, BTR value for a 42 MHz APB1
 	int timestamp_enable;
-	int interrupt;
+	int interrupt;                   // CAN_Configuration.Interrupt_ID bits, written to IER
 
 	struct __CAN_Interrupts__{
 		void (* Sleep_ISR)(void);
@@ -31,15 +38,32 @@ typedef struct CAN_Config
 		void (*Error_Warning_ISR)(void);
 		void (*FIFO_Overrun_ISR)(void);
 		void (*FIFO_Full_ISR)(void);
-		void (*FIFO_Message_Pending_ISR)(void);
+		void (*FIFO_Message_Pending_ISR)(void);      // either FIFO, the handler drains both
 		void (*Transmit_Mailbox_Empty_ISR)(void);
 
 	}ISR_Routines;
 
 }CAN_Config;
 
+typedef struct CAN_Frame
+{
+	uint32_t id;                     // 11 bit standard or 29 bit extended identifier
+	uint8_t ide;                     // CAN_Configuration.ID
+	uint8_t rtr;                     // CAN_Configuration.Frame
+	uint8_t dlc;
+	uint8_t filter;                  // filter match index, receive only
+	uint16_t timestamp;              // receive only, 0 unless timestamp_enable
+	uint8_t data[8];
+}CAN_Frame;
+
 
-void CAN_Init(CAN_Config *config);
+int8_t CAN_Init(CAN_Config *config);
+int8_t CAN_Filter_Set(uint8_t bank, uint32_t id, uint32_t mask, uint8_t fifo);
+int8_t CAN_Transmit(CAN_Config *config, const CAN_Frame *frame);
+uint8_t CAN_TX_Free(CAN_Config *config);
+bool CAN_TX_Idle(CAN_Config *config);
+uint8_t CAN_RX_Pending(CAN_Config *config, uint8_t fifo);
+bool CAN_Receive(CAN_Config *config, uint8_t fifo, CAN_Frame *frame);
 
 
 
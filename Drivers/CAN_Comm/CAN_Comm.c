@@ -0,0 +1,472 @@
+/*
+ * CAN_Comm.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "CAN_Comm.h"
+
+/* ISO 15765-2 protocol control information, high nibble of the first byte */
+#define ISOTP_SINGLE               0x00U
+#define ISOTP_FIRST                0x10U
+#define ISOTP_CONSECUTIVE          0x20U
+#define ISOTP_FLOW                 0x30U
+
+#define ISOTP_FLOW_CTS             0x00U
+#define ISOTP_FLOW_WAIT            0x01U
+#define ISOTP_FLOW_OVERFLOW        0x02U
+#define ISOTP_FLOW_NONE            0xFFU
+
+typedef enum CAN_TX_State
+{
+	CAN_TX_IDLE = 0,
+	CAN_TX_FIRST,                  // single or first frame not loaded yet
+	CAN_TX_WAIT_FLOW,              // first frame or block sent, N_Bs running
+	CAN_TX_SENDING,                // consecutive frames
+	CAN_TX_DRAIN,                  // everything loaded, waiting for the mailboxes to empty
+}CAN_TX_State;
+
+static CAN_Config CAN_Comm;
+static uint16_t can_response_id;
+static CAN_Comm_Stats can_stats;
+
+/* Reassembly into a pool packet, posted whole; the next one is taken when a message starts */
+static Packet *can_rx_packet;
+static bool can_rx_active;
+static uint16_t can_rx_length;
+static uint16_t can_rx_count;
+static uint8_t can_rx_sn;
+static uint64_t can_rx_deadline;
+static uint8_t can_flow_pending = ISOTP_FLOW_NONE;   // flow control waiting for a mailbox
+
+/* Messages are sent one at a time from head; only Send_Frame() advances tail */
+static uint8_t CAN_TX_Slot[CAN_COMM_TX_QUEUE_LENGTH][CAN_COMM_FRAME_MAX];
+static uint16_t can_tx_length[CAN_COMM_TX_QUEUE_LENGTH];
+static uint8_t can_tx_head;
+static uint8_t can_tx_tail;
+static volatile uint8_t can_tx_count;
+static volatile CAN_TX_State can_tx_state;
+static uint16_t can_tx_offset;
+static uint8_t can_tx_sn;
+static uint8_t can_tx_block;       // consecutive frames per flow control, 0: all
+static uint8_t can_tx_block_left;
+static uint8_t can_tx_waits;
+static uint32_t can_tx_stmin_us;
+static uint64_t can_tx_deadline;   // N_Bs while waiting for flow control, next consecutive frame while sending
+
+static uint32_t CAN_Comm_BTR(uint32_t bitrate)
+{
+	switch (bitrate) {
+	case 1000000U: return CAN_Configuration.Baudrate._1000_KBPS;
+	case 750000U:  return CAN_Configuration.Baudrate._750_KBPS;
+	case 250000U:  return CAN_Configuration.Baudrate._250_KBPS;
+	case 125000U:  return CAN_Configuration.Baudrate._125_KBPS;
+	case 100000U:  return CAN_Configuration.Baudrate._100_KBPS;
+	default:       return CAN_Configuration.Baudrate._500_KBPS;
+	}
+}
+
+/* Separation time from a flow control frame; reserved values mean the longest one */
+static uint32_t CAN_Comm_STmin_us(uint8_t stmin)
+{
+	if (stmin <= 0x7FU) return (uint32_t)stmin * 1000U;
+	if ((stmin >= 0xF1U) && (stmin <= 0xF9U)) return (uint32_t)(stmin - 0xF0U) * 100U;
+	return 127000U;
+}
+
+// Every frame is padded to 8 bytes, so bus time does not depend on the data
+static bool CAN_Comm_Put(const uint8_t *data, uint8_t length)
+{
+	CAN_Frame frame;
+
+	frame.id = can_response_id;
+	frame.ide = CAN_Configuration.ID.Standard;
+	frame.rtr = CAN_Configuration.Frame.Data_Frame;
+	frame.dlc = 8;
+	for (uint8_t i = 0; i < 8U; i++) frame.data[i] = (i < length) ? data[i] : CAN_COMM_PADDING;
+
+	return CAN_Transmit(&CAN_Comm, &frame) >= 0;
+}
+
+// BS 0 and STmin 0: the host may send the rest of the message back to back
+static void CAN_Comm_Flow(uint8_t status)
+{
+	uint8_t flow[3] = {ISOTP_FLOW | status, 0x00, 0x00};
+
+	if (!CAN_Comm_Put(flow, sizeof(flow))) can_flow_pending = status;
+}
+
+static void CAN_Comm_TX_Pump(void);
+
+// Caller masks interrupts or runs in a CAN interrupt
+static void CAN_Comm_TX_Finish(bool sent)
+{
+	uint8_t slot = can_tx_head;
+
+	if (sent) can_stats.tx_messages++;
+	else can_stats.tx_aborted++;
+
+	can_tx_head = (can_tx_head + 1U) & (CAN_COMM_TX_QUEUE_LENGTH - 1U);
+	can_tx_count--;
+	can_tx_state = CAN_TX_IDLE;
+	Event_Post(EVENT_TX_DONE, slot);
+
+	if (can_tx_count != 0U) {
+		can_tx_state = CAN_TX_FIRST;
+		CAN_Comm_TX_Pump();
+	}
+}
+
+/*
+ * Loads as many frames as there are empty mailboxes. Called again from the
+ * mailbox empty interrupt, on flow control and from the tick for STmin.
+ * Caller masks interrupts or runs in a CAN interrupt.
+ */
+static void CAN_Comm_TX_Pump(void)
+{
+	uint8_t data[8];
+
+	if (can_flow_pending != ISOTP_FLOW_NONE) {
+		uint8_t status = can_flow_pending;
+		can_flow_pending = ISOTP_FLOW_NONE;
+		CAN_Comm_Flow(status);
+		if (can_flow_pending != ISOTP_FLOW_NONE) return;
+	}
+
+	if (can_tx_state == CAN_TX_IDLE) return;
+
+	const uint8_t *message = CAN_TX_Slot[can_tx_head];
+	uint16_t length = can_tx_length[can_tx_head];
+
+	if (can_tx_state == CAN_TX_FIRST) {
+		if (length <= 7U) {
+			data[0] = ISOTP_SINGLE | length;
+			memcpy(&data[1], message, length);
+			if (!CAN_Comm_Put(data, length + 1U)) return;
+			can_tx_state = CAN_TX_DRAIN;
+		} else {
+			data[0] = ISOTP_FIRST | (length >> 8);
+			data[1] = length & 0xFFU;
+			memcpy(&data[2], message, 6);
+			if (!CAN_Comm_Put(data, 8)) return;
+			can_tx_offset = 6;
+			can_tx_sn = 1;
+			can_tx_waits = 0;
+			can_tx_deadline = Timebase_Now_us() + CAN_COMM_N_BS_US;
+			can_tx_state = CAN_TX_WAIT_FLOW;
+		}
+	}
+
+	while (can_tx_state == CAN_TX_SENDING) {
+		if ((can_tx_stmin_us != 0U) && (Timebase_Now_us() < can_tx_deadline)) return;
+
+		uint16_t chunk = length - can_tx_offset;
+		if (chunk > 7U) chunk = 7U;
+
+		data[0] = ISOTP_CONSECUTIVE | can_tx_sn;
+		memcpy(&data[1], &message[can_tx_offset], chunk);
+		if (!CAN_Comm_Put(data, chunk + 1U)) return;
+
+		can_tx_offset += chunk;
+		can_tx_sn = (can_tx_sn + 1U) & 0x0FU;
+
+		if (can_tx_offset == length) {
+			can_tx_state = CAN_TX_DRAIN;
+		} else if ((can_tx_block != 0U) && (--can_tx_block_left == 0U)) {
+			can_tx_deadline = Timebase_Now_us() + CAN_COMM_N_BS_US;
+			can_tx_state = CAN_TX_WAIT_FLOW;
+		} else if (can_tx_stmin_us != 0U) {
+			// With a separation time only one frame is in flight, the tick loads the next
+			can_tx_deadline = Timebase_Now_us() + can_tx_stmin_us;
+		}
+	}
+
+	if ((can_tx_state == CAN_TX_DRAIN) && CAN_TX_Idle(&CAN_Comm)) CAN_Comm_TX_Finish(true);
+}
+
+static void CAN_Comm_TX_Flow(const CAN_Frame *frame)
+{
+	if ((can_tx_state != CAN_TX_WAIT_FLOW) || (frame->dlc < 3U)) return;
+
+	switch (frame->data[0] & 0x0FU) {
+	case ISOTP_FLOW_CTS:
+		can_tx_block = frame->data[1];
+		can_tx_block_left = can_tx_block;
+		can_tx_waits = 0;
+		can_tx_stmin_us = CAN_Comm_STmin_us(frame->data[2]);
+		can_tx_deadline = 0;
+		can_tx_state = CAN_TX_SENDING;
+		CAN_Comm_TX_Pump();
+		break;
+
+	case ISOTP_FLOW_WAIT:
+		if (++can_tx_waits > CAN_COMM_WAIT_MAX) CAN_Comm_TX_Finish(false);
+		else can_tx_deadline = Timebase_Now_us() + CAN_COMM_N_BS_US;
+		break;
+
+	default:
+		// Overflow or reserved: the host cannot take this message
+		CAN_Comm_TX_Finish(false);
+		break;
+	}
+}
+
+static void CAN_Comm_RX_Abort(void)
+{
+	if (can_rx_active) can_stats.rx_aborted++;
+	can_rx_active = false;
+}
+
+static void CAN_Comm_RX_Deliver(uint16_t length)
+{
+	Packet *packet = can_rx_packet;
+
+	can_stats.rx_messages++;
+	can_rx_packet = NULL;
+	packet->length = length;
+	Packet_Handoff(packet, PACKET_RX, PACKET_PARSER);
+	if (!Event_Post(EVENT_FRAME_RECEIVED, ((uint32_t)EVENT_SOURCE_CAN1 << EVENT_SOURCE_Pos) |
+			((uint32_t)packet->index << EVENT_PACKET_Pos) | length)) Packet_Free(packet);
+}
+
+static void CAN_Comm_RX_Message(const CAN_Frame *frame)
+{
+	if ((frame->dlc == 0U) || (frame->rtr != CAN_Configuration.Frame.Data_Frame)) return;
+
+	// Only single and first frames start a message, and only they need a packet
+	uint8_t pci = frame->data[0] & 0xF0U;
+	if ((can_rx_packet == NULL) && ((pci == ISOTP_SINGLE) || (pci == ISOTP_FIRST))) {
+		can_rx_packet = Packet_Alloc(PACKET_RX);
+		if (can_rx_packet == NULL) {
+			can_stats.rx_aborted++;
+			if (pci == ISOTP_FIRST) CAN_Comm_Flow(ISOTP_FLOW_OVERFLOW);
+			return;
+		}
+	}
+
+	uint8_t *target = (can_rx_packet != NULL) ? can_rx_packet->data : NULL;
+
+	switch (pci) {
+	case ISOTP_SINGLE: {
+		uint8_t length = frame->data[0] & 0x0FU;
+		if ((length == 0U) || (length > (frame->dlc - 1U))) return;
+
+		// A new message replaces one still being reassembled
+		CAN_Comm_RX_Abort();
+		memcpy(target, &frame->data[1], length);
+		CAN_Comm_RX_Deliver(length);
+		break;
+	}
+
+	case ISOTP_FIRST: {
+		uint16_t length = ((uint16_t)(frame->data[0] & 0x0FU) << 8) | frame->data[1];
+		if ((frame->dlc < 8U) || (length < 8U)) return;
+
+		CAN_Comm_RX_Abort();
+		if (length > CAN_COMM_FRAME_MAX) {
+			can_stats.rx_aborted++;
+			CAN_Comm_Flow(ISOTP_FLOW_OVERFLOW);
+			return;
+		}
+
+		memcpy(target, &frame->data[2], 6);
+		can_rx_length = length;
+		can_rx_count = 6;
+		can_rx_sn = 1;
+		can_rx_deadline = Timebase_Now_us() + CAN_COMM_N_CR_US;
+		can_rx_active = true;
+		CAN_Comm_Flow(ISOTP_FLOW_CTS);
+		break;
+	}
+
+	case ISOTP_CONSECUTIVE: {
+		if (!can_rx_active) return;
+
+		uint16_t chunk = can_rx_length - can_rx_count;
+		if (chunk > 7U) chunk = 7U;
+
+		// A lost or repeated frame ends the message, the host retries on its timeout
+		if (((frame->data[0] & 0x0FU) != can_rx_sn) || (chunk > (frame->dlc - 1U))) {
+			CAN_Comm_RX_Abort();
+			return;
+		}
+
+		memcpy(&target[can_rx_count], &frame->data[1], chunk);
+		can_rx_count += chunk;
+		can_rx_sn = (can_rx_sn + 1U) & 0x0FU;
+
+		if (can_rx_count == can_rx_length) {
+			can_rx_active = false;
+			CAN_Comm_RX_Deliver(can_rx_length);
+		} else {
+			can_rx_deadline = Timebase_Now_us() + CAN_COMM_N_CR_US;
+		}
+		break;
+	}
+
+	case ISOTP_FLOW:
+		CAN_Comm_TX_Flow(frame);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/*
+ * Both FIFO interrupts end up here and drain both FIFOs. Mid message the
+ * FIFO matching the parity of the next sequence number holds the older
+ * frame, so it is read first; that keeps the order when the host alternates
+ * between request_id and request_id + 1.
+ */
+static void CAN_Comm_RX_ISR(void)
+{
+	CAN_Frame frame;
+
+	for (;;) {
+		uint8_t fifo = can_rx_active ? (can_rx_sn & 1U) : 0U;
+
+		if (!CAN_Receive(&CAN_Comm, fifo, &frame) && !CAN_Receive(&CAN_Comm, fifo ^ 1U, &frame)) break;
+		CAN_Comm_RX_Message(&frame);
+	}
+}
+
+// SysTick: N_Cr and N_Bs timeouts, and the next consecutive frame when the host asked for STmin
+static void CAN_Comm_Tick(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint64_t now = Timebase_Now_us();
+
+	if (can_rx_active && (now >= can_rx_deadline)) CAN_Comm_RX_Abort();
+
+	if ((can_tx_state == CAN_TX_WAIT_FLOW) && (now >= can_tx_deadline)) CAN_Comm_TX_Finish(false);
+	else if (can_tx_state == CAN_TX_SENDING) CAN_Comm_TX_Pump();
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Brings up CAN_COMM_PORT at bitrate (1M, 750k, 500k, 250k, 125k or 100k,
+ * anything else selects 500k) with the APB1 clock at 42 MHz. request_id and
+ * request_id + 1 are accepted into FIFO0 and FIFO1 through filter banks 0
+ * and 1, replies go out on response_id. Returns CAN_Init()'s error.
+ */
+int8_t CAN_Comm_Init(uint32_t bitrate, uint16_t request_id, uint16_t response_id)
+{
+	CAN_Comm.CAN_Port = CAN_COMM_PORT;
+	CAN_Comm.RX_Pin = CAN_COMM_RX_PIN;
+	CAN_Comm.TX_Pin = CAN_COMM_TX_PIN;
+	CAN_Comm.Baudrate = CAN_Comm_BTR(bitrate);
+	CAN_Comm.timestamp_enable = 0;
+	CAN_Comm.interrupt = CAN_Configuration.Interrupt_ID.Transmit_Mailbox_Empty_Interrupt |
+			CAN_Configuration.Interrupt_ID.FIFO0_Message_Pending_Interrupt |
+			CAN_Configuration.Interrupt_ID.FIFO1_Message_Pending_Interrupt;
+	CAN_Comm.ISR_Routines.FIFO_Message_Pending_ISR = CAN_Comm_RX_ISR;
+	CAN_Comm.ISR_Routines.Transmit_Mailbox_Empty_ISR = CAN_Comm_TX_Pump;
+
+	can_response_id = response_id;
+	can_rx_active = false;
+	can_flow_pending = ISOTP_FLOW_NONE;
+	can_tx_head = 0;
+	can_tx_tail = 0;
+	can_tx_count = 0;
+	can_tx_state = CAN_TX_IDLE;
+	memset(&can_stats, 0, sizeof(can_stats));
+
+	int8_t status = CAN_Init(&CAN_Comm);
+	if (status < 0) return status;
+
+	// Nothing is taken off the FIFOs until CAN_Comm_Receive_Start()
+	CAN_COMM_PORT->IER &= ~(CAN_IER_FMPIE0 | CAN_IER_FMPIE1);
+
+	CAN_Filter_Set(0, request_id, 0x7FFU, 0);
+	CAN_Filter_Set(1, request_id + 1U, 0x7FFU, 1);
+
+	Timebase_Set_Tick_Hook(CAN_Comm_Tick);
+	return 1;
+}
+
+void CAN_Comm_Receive_Start(void)
+{
+	CAN_COMM_PORT->IER |= CAN_IER_FMPIE0 | CAN_IER_FMPIE1;
+}
+
+// The message reported by EVENT_FRAME_RECEIVED (pass its arg), owned by the caller until Packet_Free(); NULL if unusable
+Packet *CAN_Comm_Take(uint32_t frame)
+{
+	Packet *packet = Packet_At((frame >> EVENT_PACKET_Pos) & 0xFFU);
+
+	if ((packet == NULL) || (packet->owner != PACKET_PARSER)) return NULL;
+	if (packet->length < 2U) {
+		Packet_Free(packet);
+		return NULL;
+	}
+	return packet;
+}
+
+/*
+ * Assembles AA 55 | command | request | length | payload | CRC | BB 66 into a
+ * queue slot and sends it as one ISO-TP message. payload is copied, so it
+ * may change once this returns. Returns -1 if the queue did not drain in time.
+ */
+int8_t CAN_Comm_Send_Frame(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length)
+{
+	// Only this function fills the queue, the interrupts only drain it
+	if (!Timebase_Wait_Until(can_tx_count < CAN_COMM_TX_QUEUE_LENGTH, CAN_COMM_N_BS_US)) return -1;
+
+	uint8_t slot = can_tx_tail;
+	uint8_t *message = CAN_TX_Slot[slot];
+	uint16_t size = 0;
+
+	message[size++] = CUSTOM_FRAME_HEADER_1;
+	message[size++] = CUSTOM_FRAME_HEADER_2;
+	message[size++] = command;
+	message[size++] = request;
+	message[size++] = length;
+	for (uint8_t i = 0; i < length; i++) message[size++] = payload[i];
+
+	uint32_t crc = CRC_Compute_8Bit_Block(&message[2], size - 2U);
+
+	message[size++] = (crc & 0xFF000000) >> 24;
+	message[size++] = (crc & 0x00FF0000) >> 16;
+	message[size++] = (crc & 0x0000FF00) >> 8;
+	message[size++] = (crc & 0x000000FF) >> 0;
+	message[size++] = CUSTOM_FRAME_FOOTER_1;
+	message[size++] = CUSTOM_FRAME_FOOTER_2;
+
+	can_tx_length[slot] = size;
+	can_tx_tail = (slot + 1U) & (CAN_COMM_TX_QUEUE_LENGTH - 1U);
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	can_tx_count++;
+	if (can_tx_state == CAN_TX_IDLE) {
+		can_tx_state = CAN_TX_FIRST;
+		CAN_Comm_TX_Pump();
+	}
+	__set_PRIMASK(primask);
+
+	return 1;
+}
+
+// Free message slots; every CAN_Comm_Send_Frame() takes one
+uint8_t CAN_Comm_TX_Free(void)
+{
+	return CAN_COMM_TX_QUEUE_LENGTH - can_tx_count;
+}
+
+// Waits until every queued message is out or was given up on
+void CAN_Comm_Flush(void)
+{
+	Timebase_Wait_Until(can_tx_count == 0U, CAN_COMM_TX_QUEUE_LENGTH * CAN_COMM_N_BS_US);
+}
+
+void CAN_Comm_Get_Stats(CAN_Comm_Stats *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*stats = can_stats;
+	__set_PRIMASK(primask);
+}
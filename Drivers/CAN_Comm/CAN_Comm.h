@@ -0,0 +1,59 @@
+/*
+ * CAN_Comm.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef CAN_COMM_CAN_COMM_H_
+#define CAN_COMM_CAN_COMM_H_
+
+#include "main.h"
+#include "CAN/CAN.h"
+#include "CRC/CRC.h"
+#include "Event/Event.h"
+#include "Packet/Packet.h"
+#include "Custom_RS485_Comm/Custom_RS485_Comm.h"
+
+/*
+ * Bootloader frames (AA 55 ... BB 66, as on the UART) carried as ISO 15765-2
+ * messages: single frame up to 7 bytes, otherwise first frame, flow control
+ * from the receiver and consecutive frames. Normal addressing, classic CAN,
+ * 11 bit identifiers, one request ID pair and one response ID per node.
+ *
+ * The node receives on request_id into FIFO0 and request_id + 1 into FIFO1.
+ * A host that sends consecutive frames with an odd sequence number on
+ * request_id + 1 gets both FIFOs (6 frames) of hardware buffering; a host
+ * using request_id only still works through FIFO0.
+ */
+
+#define CAN_COMM_PORT              CAN1
+#define CAN_COMM_RX_PIN            CAN_Configuration.Pin._CAN1.RX.PD0
+#define CAN_COMM_TX_PIN            CAN_Configuration.Pin._CAN1.TX.PD1
+
+#define CAN_COMM_FRAME_MAX         (CUSTOM_FRAME_HEADER_MAX + 255U + CUSTOM_FRAME_TRAILER_LENGTH)
+#define CAN_COMM_TX_QUEUE_LENGTH   4U        // messages, power of two
+#define CAN_COMM_N_BS_US           1000000U  // first frame or end of block to flow control
+#define CAN_COMM_N_CR_US           1000000U  // between received consecutive frames
+#define CAN_COMM_WAIT_MAX          8U        // flow control WAIT frames accepted in a row
+#define CAN_COMM_PADDING           0xCCU     // unused bytes of the last frame
+
+typedef struct CAN_Comm_Stats
+{
+	uint32_t rx_messages;
+	uint32_t rx_aborted;           // sequence error, N_Cr timeout or overflow
+	uint32_t tx_messages;
+	uint32_t tx_aborted;           // N_Bs timeout, overflow or too many WAITs
+}CAN_Comm_Stats;
+
+int8_t CAN_Comm_Init(uint32_t bitrate, uint16_t request_id, uint16_t response_id);
+
+/* Event driven use: messages arrive as EVENT_FRAME_RECEIVED (arg for CAN_Comm_Take), sends finish with EVENT_TX_DONE (arg: slot) */
+void CAN_Comm_Receive_Start(void);
+Packet *CAN_Comm_Take(uint32_t frame);
+int8_t CAN_Comm_Send_Frame(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length);
+uint8_t CAN_Comm_TX_Free(void);
+void CAN_Comm_Flush(void);
+void CAN_Comm_Get_Stats(CAN_Comm_Stats *stats);
+
+
+#endif /* CAN_COMM_CAN_COMM_H_ */
@@ -0,0 +1,84 @@
+/*
+ * COBS.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "COBS.h"
+
+void COBS_Encode_Start(COBS_Encoder *encoder, uint8_t *out)
+{
+	encoder->out = out;
+	encoder->code_index = 0;
+	encoder->length = 1;
+	encoder->code = 0x01;
+}
+
+// A block is closed at every zero and after COBS_BLOCK_MAX data bytes
+void COBS_Encode(COBS_Encoder *encoder, const uint8_t *data, uint16_t length)
+{
+	for (uint16_t i = 0; i < length; i++) {
+		if (data[i] != 0x00) {
+			encoder->out[encoder->length++] = data[i];
+			encoder->code++;
+		}
+
+		if ((data[i] == 0x00) || (encoder->code == 0xFF)) {
+			encoder->out[encoder->code_index] = encoder->code;
+			encoder->code_index = encoder->length++;
+			encoder->code = 0x01;
+		}
+	}
+}
+
+// Closes the last block and appends the delimiter; returns the bytes to send
+uint16_t COBS_Encode_End(COBS_Encoder *encoder)
+{
+	encoder->out[encoder->code_index] = encoder->code;
+	encoder->out[encoder->length++] = COBS_DELIMITER;
+	return encoder->length;
+}
+
+void COBS_Decode_Reset(COBS_Decoder *decoder)
+{
+	decoder->length = 0;
+	decoder->remaining = 0;
+	decoder->pending_zero = false;
+	decoder->error = false;
+}
+
+/*
+ * Feed every received byte. Returns the length of the frame in out when byte
+ * is the delimiter that completes it, else 0. Whatever came before a
+ * delimiter is forgotten, so a corrupted frame costs only itself.
+ */
+uint16_t COBS_Decode(COBS_Decoder *decoder, uint8_t byte)
+{
+	if (byte == COBS_DELIMITER) {
+		uint16_t length = (!decoder->error && (decoder->remaining == 0U)) ? decoder->length : 0U;
+		COBS_Decode_Reset(decoder);
+		return length;
+	}
+
+	if (decoder->error) return 0;
+	if (decoder->out == NULL) {
+		decoder->error = true;
+		return 0;
+	}
+
+	if (decoder->remaining == 0U) {
+		// Code byte: byte - 1 data bytes follow
+		if (decoder->pending_zero) {
+			if (decoder->length >= decoder->capacity) { decoder->error = true; return 0; }
+			decoder->out[decoder->length++] = 0x00;
+		}
+		decoder->remaining = byte - 1U;
+		decoder->pending_zero = (byte != 0xFF);
+		return 0;
+	}
+
+	if (decoder->length >= decoder->capacity) { decoder->error = true; return 0; }
+	decoder->out[decoder->length++] = byte;
+	decoder->remaining--;
+	return 0;
+}
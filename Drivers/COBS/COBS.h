@@ -0,0 +1,52 @@
+/*
+ * COBS.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef COBS_COBS_H_
+#define COBS_COBS_H_
+
+#include "main.h"
+
+/*
+ * Consistent Overhead Byte Stuffing for the comm link: 0x00 only ever appears
+ * as the frame delimiter. Each block is a code byte n followed by n - 1 data
+ * bytes and an implied zero, except after a full 254 byte block (code 0xFF)
+ * or at the end of the frame. A frame costs its first code byte, one more per
+ * 254 non-zero bytes in a row, and the delimiter.
+ */
+
+#define COBS_DELIMITER              0x00U
+#define COBS_BLOCK_MAX              254U     // data bytes behind code 0xFF
+#define COBS_ENCODED_MAX(length)    ((length) + ((length) / COBS_BLOCK_MAX) + 2U)
+
+/* Streaming encoder: a frame may be fed in several pieces */
+typedef struct COBS_Encoder
+{
+	uint8_t *out;
+	uint16_t code_index;     // where the current block's code byte goes
+	uint16_t length;         // bytes written, including the reserved code byte
+	uint8_t code;            // current block length + 1
+}COBS_Encoder;
+
+/* Byte-wise decoder; out and capacity are set by the owner, out may be NULL until a frame starts */
+typedef struct COBS_Decoder
+{
+	uint8_t *out;
+	uint16_t capacity;
+	uint16_t length;         // decoded bytes of the current frame
+	uint8_t remaining;       // data bytes left in the current block
+	bool pending_zero;       // block ended below 0xFF, a zero follows unless the frame ends
+	bool error;              // frame too long or no buffer, dropped at the next delimiter
+}COBS_Decoder;
+
+void COBS_Encode_Start(COBS_Encoder *encoder, uint8_t *out);
+void COBS_Encode(COBS_Encoder *encoder, const uint8_t *data, uint16_t length);
+uint16_t COBS_Encode_End(COBS_Encoder *encoder);
+
+void COBS_Decode_Reset(COBS_Decoder *decoder);
+uint16_t COBS_Decode(COBS_Decoder *decoder, uint8_t byte);
+
+
+#endif /* COBS_COBS_H_ */
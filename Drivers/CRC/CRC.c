@@ -38,6 +38,40 @@ uint32_t CRC_Compute_8Bit_Block(volatile uint8_t *wordBlock, size_t length)
 	return (CRC -> DR);
 }
 
+/* Same as CRC_Compute_8Bit_Block without the reset, lets a long block be fed in chunks */
+uint32_t CRC_Accumulate_8Bit_Block(volatile uint8_t *wordBlock, size_t length)
+{
+	for(uint32_t i = 0; i < length; i++)
+	{
+		CRC -> DR = 0x00000000 | (wordBlock[i]);
+	}
+	return (CRC -> DR);
+}
+
+/*
+ * Software twin of CRC_Accumulate_8Bit_Block: every byte goes in as the word
+ * 0x000000XX, polynomial 0x4C11DB7 MSB first, a nibble at a time. Start from
+ * CRC_INITIAL_VALUE. For jobs that span several event loop turns and must not
+ * hold the CRC unit, which every frame received or sent also uses.
+ */
+static const uint32_t crc_nibble_table[16] = {
+	0x00000000, 0x04C11DB7, 0x09823B6E, 0x0D4326D9, 0x130476DC, 0x17C56B6B, 0x1A864DB2, 0x1E475005,
+	0x2608EDB8, 0x22C9F00F, 0x2F8AD6D6, 0x2B4BCB61, 0x350C9B64, 0x31CD86D3, 0x3C8EA00A, 0x384FBDBD,
+};
+
+uint32_t CRC_Software_Accumulate_8Bit_Block(uint32_t crc, const volatile uint8_t *wordBlock, size_t length)
+{
+	for(uint32_t i = 0; i < length; i++)
+	{
+		crc ^= wordBlock[i];
+		for(uint8_t n = 0; n < 8U; n++)
+		{
+			crc = (crc << 4) ^ crc_nibble_table[crc >> 28];
+		}
+	}
+	return crc;
+}
+
 uint32_t CRC_Compute_32Bit_Block(volatile uint32_t *wordBlock, size_t length)
 {
 	uint32_t temp = 0;
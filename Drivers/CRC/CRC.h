@@ -12,12 +12,15 @@
 #include "DMA/DMA.h"
 
 #define CRC_Polynomial 0x4C11DB7
+#define CRC_INITIAL_VALUE 0xFFFFFFFFU    // DR after CRC_Reset
 
 
 void CRC_Init(void);
 void CRC_Reset(void);
 uint32_t CRC_Compute_Single_Word(uint32_t word);
 uint32_t CRC_Compute_8Bit_Block(volatile uint8_t *wordBlock, size_t length);
+uint32_t CRC_Accumulate_8Bit_Block(volatile uint8_t *wordBlock, size_t length);
+uint32_t CRC_Software_Accumulate_8Bit_Block(uint32_t crc, const volatile uint8_t *wordBlock, size_t length);
 uint32_t CRC_Compute_32Bit_Block(volatile uint32_t *wordBlock, size_t length);
 uint32_t CRC_Compute_Flash_Data(volatile uint32_t Flash_Address, size_t length);
 #endif /* CRC_CRC_H_ */
@@ -9,9 +9,8 @@ volatile int rx_flag = 0;     // Indicates if data reception is complete
 
 #define RX_Buffer_Length 200 // Length of the reception buffer
 
-// Variables to track the length of received data and the reception buffer
+// Length of received data; each call borrows a pool packet as its buffer
 volatile int RX_Length = 0;
-volatile uint8_t TRX_Buffer[RX_Buffer_Length]; // Buffer for received and transmitted data
 
 // USART configuration structure
 USART_Config serial;
@@ -122,20 +121,22 @@ void Console_Init(int32_t baudrate) {
   */
  void printConsole(char *msg, ...) {
      va_list args;
+     Packet *packet = Packet_Alloc(PACKET_TX);
+     if (packet == NULL) return;
+
      va_start(args, msg);
 
      // Format the message and store it in the transmission buffer
-//     vsprintf((char *)TRX_Buffer, msg, args);
-
-     vsnprintf((char *)TRX_Buffer, RX_Buffer_Length, msg, args);
+     vsnprintf((char *)packet->data, RX_Buffer_Length, msg, args);
 
      // Get the length of the formatted string
-     uint16_t len = strlen((char *)TRX_Buffer);
+     uint16_t len = strlen((char *)packet->data);
 
-     // Transmit the buffer using DMA
-     USART_TX_Buffer(&serial, (uint8_t *)&TRX_Buffer[0], len);
+     // Transmit the buffer using DMA, USART_TX_Buffer() returns once it is sent
+     USART_TX_Buffer(&serial, packet->data, len);
 
      va_end(args);
+     Packet_Free(packet);
  }
 
 //int readConsole(const char *msg, ...)
@@ -170,11 +171,13 @@ void Console_Init(int32_t baudrate) {
  int readConsole(const char *msg, ...) {
      va_list args;
      int result;
+     Packet *packet = Packet_Alloc(PACKET_RX);
+     if (packet == NULL) return -1;
 
      rx_get_flag = 1; // Enable reception
 
      // Start DMA reception
-     USART_RX_Buffer(&serial, (uint8_t *)TRX_Buffer, RX_Buffer_Length, 0);
+     USART_RX_Buffer(&serial, packet->data, RX_Buffer_Length, 0);
 
      // Wait until data reception is complete
      while (rx_flag == 0) {
@@ -186,21 +189,23 @@ void Console_Init(int32_t baudrate) {
          // Reset flags and return error
          rx_get_flag = 0;
          rx_flag = 0;
+         Packet_Free(packet);
          return -1;
      }
 
      // Null-terminate the received string
-     TRX_Buffer[RX_Length - 1] = '\0';
+     packet->data[RX_Length - 1] = '\0';
 
      // Parse the input using the format string
      va_start(args, msg);
-     result = vsscanf((char *)TRX_Buffer, msg, args);
+     result = vsscanf((char *)packet->data, msg, args);
      va_end(args);
 
      // Reset reception flags
      rx_get_flag = 0;
      rx_flag = 0;
 
+     Packet_Free(packet);
      return result;
  }
 
@@ -79,6 +79,7 @@
 #include "GPIO/GPIO.h"
 #include "USART/USART.h"
 #include "DMA/DMA.h"
+#include "Packet/Packet.h"
 
 /**
  * @brief Initializes the console interface with a specified baud rate.
@@ -4,17 +4,180 @@
 // Flags to control and monitor UART reception
 volatile int custom_rx_get_flag = 0; // Indicates if the reception is active
 volatile int custom_rx_flag = 0;     // Indicates if data reception is complete
+volatile int custom_event_mode = 0;  // Post EVENT_FRAME_RECEIVED / EVENT_TX_DONE instead of only setting flags
 
-#define Custom_RX_Buffer_Length 300 // Length of the reception buffer
+#define Custom_RX_Buffer_Length 300 // Length of the reception buffer, at most PACKET_DATA_LENGTH
 
-// Variables to track the length of received data and the reception buffer
+// Variables to track the length of received data and the reception packet
 volatile int Custom_RX_Length = 0;
-volatile uint8_t Custom_TRX_Buffer[Custom_RX_Buffer_Length]; // Buffer for received and transmitted data
+static Packet *custom_rx_packet;   // DMA target: one frame under IDLE framing, the circular ring under COBS
 
 // USART configuration structure
 USART_Config Custom_Comm;
 
+// Copied or encoded frames go out of a pool packet, freed by the TX done callback of its slot
+static USART_TX_Queue Custom_TX_Queue;
+static Packet *custom_tx_packet[USART_TX_QUEUE_LENGTH];
+
+// Header and trailer of a gathered frame, indexed by the queue slot of its trailer
+typedef struct Custom_Frame_Wrap
+{
+	uint8_t header[CUSTOM_FRAME_HEADER_MAX];
+	uint8_t trailer[CUSTOM_FRAME_TRAILER_LENGTH];
+}Custom_Frame_Wrap;
+
+__NOINIT static Custom_Frame_Wrap Custom_TX_Wrap[USART_TX_QUEUE_LENGTH];
+
+// Framing in use on the link, switched by Custom_Comm_Set_Framing()
+static volatile Custom_Framing custom_framing = CUSTOM_FRAMING_IDLE;
+
+// COBS reception: bytes are decoded straight out of the circular DMA buffer into a pool packet per frame
+typedef struct Custom_COBS_Decoder
+{
+	uint16_t rx_tail;        // next byte of the ring to decode
+	COBS_Decoder decoder;
+	Packet *packet;          // frame being filled, taken at its first byte
+}Custom_COBS_Decoder;
+
+static Custom_COBS_Decoder Custom_COBS_RX;
+
+// Software RTS: asserted (low) only while nothing holds reception back
+static volatile uint8_t custom_rts_hold = 0;      // CUSTOM_HOLD_* bits
+static volatile uint8_t custom_rx_pending = 0;    // frames posted but not read yet
+static bool custom_flow_control = false;
+
+static void Custom_RTS_Update(void)
+{
+	if (!custom_flow_control) return;
+
+	if (custom_rts_hold != 0U)
+		GPIO_Pin_High(CUSTOM_COMM_RTS_PORT, CUSTOM_COMM_RTS_PIN);
+	else
+		GPIO_Pin_Low(CUSTOM_COMM_RTS_PORT, CUSTOM_COMM_RTS_PIN);
+}
+
+// RS485 driver enable: high from just before the first queued byte until the USART TC interrupt, or CUSTOM_COMM_DE_TIMER after it
+static volatile bool custom_de_active = false;
+static volatile uint64_t custom_rx_end_us = 0;    // end of the last received frame, 0 once answered
+static volatile uint64_t custom_de_tc_us = 0;     // TC interrupt that started the tail guard
+static uint16_t custom_de_lead_us = 0;
+static uint16_t custom_de_tail_us = 0;
+static Custom_RS485_Stats custom_rs485_stats;
+
+// packet waits for Custom_Comm_Take(); hold the host once CUSTOM_RX_PENDING_MAX frames are unread
+static void Custom_RX_Frame_Posted(Packet *packet, uint16_t length)
+{
+	packet->length = length;
+	Packet_Handoff(packet, PACKET_RX, PACKET_PARSER);
+	if (!Event_Post(EVENT_FRAME_RECEIVED, ((uint32_t)EVENT_SOURCE_UART4 << EVENT_SOURCE_Pos) |
+			((uint32_t)packet->index << EVENT_PACKET_Pos) | length)) {
+		Packet_Free(packet);
+		return;
+	}
+
+	custom_rx_end_us = Timebase_Now_us();
+	custom_rx_pending++;
+	if (custom_rx_pending >= CUSTOM_RX_PENDING_MAX) {
+		custom_rts_hold |= CUSTOM_HOLD_RX;
+		Custom_RTS_Update();
+	}
+}
+
+// How replies are framed, follows the addressing of the request being answered
+static Custom_Reply_Mode custom_reply_mode = CUSTOM_REPLY_LEGACY;
+static uint8_t custom_reply_address = 0;
+
+// Reed-Solomon parity symbols per block, 0 = no FEC; set by Custom_Comm_Set_FEC()
+static uint8_t custom_fec_parity = 0;
+
+static void Custom_COBS_Decode(uint8_t byte)
+{
+	Custom_COBS_Decoder *rx = &Custom_COBS_RX;
+
+	if ((rx->packet == NULL) && (byte != COBS_DELIMITER) && !rx->decoder.error) {
+		rx->packet = Packet_Alloc(PACKET_RX);
+		rx->decoder.out = (rx->packet != NULL) ? rx->packet->data : NULL;
+	}
+
+	// A complete frame is handed over; anything else before a delimiter is dropped
+	uint16_t length = COBS_Decode(&rx->decoder, byte);
+	if (length != 0U) {
+		custom_rx_flag = 1;
+		Custom_RX_Frame_Posted(rx->packet, length);
+		rx->packet = NULL;
+		rx->decoder.out = NULL;
+	}
+}
+
+// Decodes everything DMA has written since the last call; runs from the IDLE and RX DMA half/full interrupts
+static void Custom_COBS_Drain(void)
+{
+	if (custom_framing != CUSTOM_FRAMING_COBS) return;
+
+	uint16_t head = Custom_RX_Buffer_Length - Custom_Comm.USART_DMA_Instance_RX.Request.Stream->NDTR;
+	if (head >= Custom_RX_Buffer_Length) head = 0;
+
+	while (Custom_COBS_RX.rx_tail != head) {
+		Custom_COBS_Decode(custom_rx_packet->data[Custom_COBS_RX.rx_tail]);
+		if (++Custom_COBS_RX.rx_tail >= Custom_RX_Buffer_Length) Custom_COBS_RX.rx_tail = 0;
+	}
+}
+
+/*
+ * Autobaud: between frames the receiver is off and EXTI11 timestamps the
+ * falling edges of PC11 with DWT->CYCCNT. Once Autobaud_Edge() has seen the
+ * AA 55 / AA 56 header, BRR is set and the receiver switched on before the
+ * third byte; the two header bytes are filled in by hand and DMA continues
+ * behind them, so the frame reads back whole.
+ */
+static Autobaud custom_autobaud;
+static volatile bool custom_autobaud_enable = false;
+static bool custom_autobaud_ready = false;     // EXTI line set up
+static uint32_t custom_autobaud_ratio = 1;     // HCLK / PCLK1
+
+// Caller masks interrupts; RX DMA is idle at the start of the buffer
+static void Custom_Autobaud_Arm(void)
+{
+	uint32_t pclk = SystemAPB1_Clock_Speed();
+
+	custom_autobaud_ratio = (pclk != 0) ? (SystemCoreClock / pclk) : 1U;
+	Autobaud_Reset(&custom_autobaud, SystemCoreClock / CUSTOM_AUTOBAUD_MAX_BAUDRATE, SystemCoreClock / CUSTOM_AUTOBAUD_MIN_BAUDRATE);
+
+	Custom_Comm.Port->CR1 &= ~USART_CR1_RE;
+	EXTI->PR = 1U << CUSTOM_COMM_RX_PIN;
+	EXTI->IMR |= 1U << CUSTOM_COMM_RX_PIN;
+}
+
+static void Custom_Autobaud_Edge_IRQ(void)
+{
+	if (Autobaud_Edge(&custom_autobaud, DWT->CYCCNT) != AUTOBAUD_LOCKED) return;
+
+	// Stop bit of the second byte: two bit times until the next start bit
+	Custom_Comm.Port->BRR = Autobaud_BRR(&custom_autobaud, custom_autobaud_ratio);
+	Custom_Comm.Port->CR1 |= USART_CR1_RE;
+	EXTI->IMR &= ~(1U << CUSTOM_COMM_RX_PIN);
+
+	// The first byte lands a full character later, time enough to move DMA past the header
+	DMA_Stream_TypeDef *stream = Custom_Comm.USART_DMA_Instance_RX.Request.Stream;
+	stream->CR &= ~DMA_SxCR_EN;
+	custom_rx_packet->data[0] = CUSTOM_FRAME_HEADER_1;
+	custom_rx_packet->data[1] = custom_autobaud.second;
+	stream->M0AR = (uint32_t)&custom_rx_packet->data[2];
+	stream->NDTR = Custom_RX_Buffer_Length - 2U;
+	stream->CR |= DMA_SxCR_EN;
+
+	// Timeouts and Custom_Comm_Clock_Changed() follow the detected rate
+	Custom_Comm.baudrate = Autobaud_Baudrate(&custom_autobaud, SystemCoreClock);
+}
+
 void Custom_Console_IRQ(void){
+	if (custom_framing == CUSTOM_FRAMING_COBS) {
+		(void)UART4->SR;
+		(void)UART4->DR;
+		Custom_COBS_Drain();
+		return;
+	}
+
 	if (custom_rx_get_flag == 1) { // Check if reception is active
 		(void)UART4->SR; // Read the status register to clear flags
 		(void)UART4->DR; // Read the data register to clear flags
@@ -32,13 +195,125 @@ void Custom_Console_IRQ(void){
 			Custom_RX_Length = Custom_RX_Buffer_Length;
 		}
 
-		// Reset DMA stream for the next reception
+		// Event driven, the frame keeps its packet and the next one lands in a fresh one; with the pool empty it is dropped
+		Packet *filled = custom_rx_packet;
+		Packet *next = (custom_event_mode && (Custom_RX_Length != 0)) ? Packet_Alloc(PACKET_RX) : NULL;
+		if (next != NULL) custom_rx_packet = next;
+
+		// Reset DMA stream for the next reception, autobaud may have moved it past the header
+		Custom_Comm.USART_DMA_Instance_RX.Request.Stream->M0AR = (uint32_t)custom_rx_packet->data;
 		Custom_Comm.USART_DMA_Instance_RX.Request.Stream->NDTR = Custom_RX_Buffer_Length;
 		Custom_Comm.USART_DMA_Instance_RX.Request.Stream->CR |= DMA_SxCR_EN;
 
+		// Measure the next frame again
+		if (custom_autobaud_enable) Custom_Autobaud_Arm();
+
 		__enable_irq(); // Re-enable interrupts
 
 		custom_rx_flag = 1; // Set the flag indicating data reception is complete
+
+		if (next != NULL) Custom_RX_Frame_Posted(filled, Custom_RX_Length);
+	}
+}
+
+// Stops a tail guard still running; the bus stays driven for the next transfer
+static void Custom_DE_Timer_Stop(void)
+{
+	CUSTOM_COMM_DE_TIMER->CR1 = 0;
+	CUSTOM_COMM_DE_TIMER->SR = 0;
+	NVIC_ClearPendingIRQ(CUSTOM_COMM_DE_TIMER_IRQn);
+}
+
+// One-shot update after tail_us at a 1 us tick; TIM7 runs at twice PCLK1 unless APB1 is undivided
+static void Custom_DE_Timer_Start(uint16_t tail_us)
+{
+	uint32_t clock = SystemAPB1_Clock_Speed();
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) clock *= 2U;
+
+	CUSTOM_COMM_DE_TIMER->CR1 = 0;
+	CUSTOM_COMM_DE_TIMER->PSC = (clock / 1000000U) - 1U;
+	CUSTOM_COMM_DE_TIMER->ARR = tail_us;
+	CUSTOM_COMM_DE_TIMER->EGR = TIM_EGR_UG;    // load PSC now, the update this raises is cleared below
+	CUSTOM_COMM_DE_TIMER->SR = 0;
+	CUSTOM_COMM_DE_TIMER->DIER = TIM_DIER_UIE;
+	CUSTOM_COMM_DE_TIMER->CR1 = TIM_CR1_OPM | TIM_CR1_CEN;
+}
+
+static void Custom_DE_Release(void)
+{
+	GPIO_Pin_Low(CUSTOM_COMM_DE_PORT, CUSTOM_COMM_DE_PIN);
+	custom_de_active = false;
+
+	custom_rs485_stats.release_us = (uint32_t)(Timebase_Now_us() - custom_de_tc_us);
+	if (custom_rs485_stats.release_us > custom_rs485_stats.release_max_us)
+		custom_rs485_stats.release_max_us = custom_rs485_stats.release_us;
+}
+
+/*
+ * Drives DE/RE before queueing, atomically with the enqueue so the TC interrupt
+ * cannot release the bus in between. Waits the lead guard only when the
+ * transceiver was off, with interrupts masked for up to CUSTOM_DE_LEAD_MAX_US.
+ */
+static int8_t Custom_Comm_Enqueue(const uint8_t *data, uint16_t length, void (*complete)(void *context), void *context)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	// Sending again inside the tail guard: keep driving
+	if (custom_de_active) Custom_DE_Timer_Stop();
+
+	if (!custom_de_active) {
+		GPIO_Pin_High(CUSTOM_COMM_DE_PORT, CUSTOM_COMM_DE_PIN);
+		custom_de_active = true;
+
+		if (custom_rx_end_us != 0U) {
+			custom_rs485_stats.rx_to_tx_us = (uint32_t)(Timebase_Now_us() - custom_rx_end_us);
+			if (custom_rs485_stats.rx_to_tx_us > custom_rs485_stats.rx_to_tx_max_us)
+				custom_rs485_stats.rx_to_tx_max_us = custom_rs485_stats.rx_to_tx_us;
+			custom_rx_end_us = 0;
+		}
+
+		if (custom_de_lead_us != 0U) Timebase_Delay_us(custom_de_lead_us);
+	}
+
+	int8_t result = USART_TX_Enqueue(&Custom_Comm, data, length, complete, context);
+
+	__set_PRIMASK(primask);
+	return result;
+}
+
+// USART TC: the last stop bit is on the wire, hand the bus back unless more is queued; a tail guard runs on the timer
+static void Custom_Comm_TC_IRQ(void)
+{
+	if (!custom_de_active) return;
+	if (USART_TX_Busy(&Custom_Comm)) return;
+
+	custom_de_tc_us = Timebase_Now_us();
+	if (custom_de_tail_us != 0U)
+		Custom_DE_Timer_Start(custom_de_tail_us);
+	else
+		Custom_DE_Release();
+}
+
+// Tail guard over; Custom_Comm_Enqueue() stops the timer when more is queued first
+void TIM7_IRQHandler(void)
+{
+	CUSTOM_COMM_DE_TIMER->SR = 0;
+
+	if (custom_de_active && !USART_TX_Busy(&Custom_Comm)) Custom_DE_Release();
+}
+
+// Queue descriptor callback, context is the slot index; a packet sent from that slot goes back to the pool
+static void Custom_Comm_TX_Done_IRQ(void *context) {
+	uint32_t slot = (uint32_t)context;
+
+	if (custom_tx_packet[slot] != NULL) {
+		Packet_Free(custom_tx_packet[slot]);
+		custom_tx_packet[slot] = NULL;
+	}
+
+	if (custom_event_mode) {
+		Event_Post(EVENT_TX_DONE, (uint32_t)context);
 	}
 }
 
@@ -54,13 +329,46 @@ void Custom_Comm_Init(int32_t baudrate) {
 	Custom_Comm.stop_bits = USART_Configuration.Stop_Bits.Bit_1; // 1 stop bit
 	Custom_Comm.TX_Pin = UART4_TX_Pin.PC10; // TX pin is PC10
 	Custom_Comm.RX_Pin = UART4_RX_Pin.PC11; // RX pin is PC11
-	Custom_Comm.interrupt = USART_Configuration.Interrupt_Type.IDLE_Enable; // Enable IDLE interrupt
+	Custom_Comm.interrupt = USART_Configuration.Interrupt_Type.IDLE_Enable | USART_Configuration.Interrupt_Type.Transmission_Complete_Enable; // IDLE frames in, TC releases DE
 	Custom_Comm.dma_enable = USART_Configuration.DMA_Enable.TX_Enable | USART_Configuration.DMA_Enable.RX_Enable; // Enable DMA for TX and RX
 	Custom_Comm.ISR_Routines.Idle_Line_ISR = Custom_Console_IRQ;
+	Custom_Comm.ISR_Routines.RX_DMA_ISR = Custom_COBS_Drain;
+	Custom_Comm.ISR_Routines.Transmission_Complete_ISR = Custom_Comm_TC_IRQ;
+	custom_framing = CUSTOM_FRAMING_IDLE;
+	Custom_TX_Queue.head = 0;
+	Custom_TX_Queue.tail = 0;
+	custom_rts_hold = 0;
+	custom_rx_pending = 0;
+	custom_reply_mode = CUSTOM_REPLY_LEGACY;
+	custom_de_active = false;
+	custom_rx_end_us = 0;
+	custom_autobaud_enable = false;
+
+	RCC->APB1ENR |= RCC_APB1ENR_TIM7EN;
+	Custom_DE_Timer_Stop();
+	NVIC_EnableIRQ(CUSTOM_COMM_DE_TIMER_IRQn);
+	memset(&custom_rs485_stats, 0, sizeof(custom_rs485_stats));
+	if (custom_rx_packet == NULL) custom_rx_packet = Packet_Alloc(PACKET_RX);
+
+	// Receive until the first reply; DE and /RE are tied on the transceiver
+	GPIO_Pin_Init(CUSTOM_COMM_DE_PORT, CUSTOM_COMM_DE_PIN, GPIO_Configuration.Mode.General_Purpose_Output,
+			GPIO_Configuration.Output_Type.Push_Pull,
+			GPIO_Configuration.Speed.Very_High_Speed,
+			GPIO_Configuration.Pull.No_Pull_Up_Down,
+			GPIO_Configuration.Alternate_Functions.None);
+	GPIO_Pin_Low(CUSTOM_COMM_DE_PORT, CUSTOM_COMM_DE_PIN);
+	Custom_Comm.tx_queue = &Custom_TX_Queue;
 	// Initialize USART
 	if (USART_Init(&Custom_Comm) != true) {}
 }
 
+// Recompute the baud rate divider after SYSCLK/APB1 changed
+void Custom_Comm_Clock_Changed(void) {
+	if (Custom_Comm.Port == NULL) return; // Not initialised yet
+
+	USART_Set_Baudrate(&Custom_Comm);
+}
+
 
 void Custom_Comm_Send(volatile uint8_t *buffer, size_t buffer_size) {
 
@@ -82,7 +390,7 @@ uint16_t Custom_Comm_Receive(volatile uint8_t *buffer)
 	custom_rx_get_flag = 1; // Enable reception
 
 	// Start DMA reception
-	USART_RX_Buffer(&Custom_Comm, (uint8_t *)Custom_TRX_Buffer, Custom_RX_Buffer_Length, 0);
+	USART_RX_Buffer(&Custom_Comm, custom_rx_packet->data, Custom_RX_Buffer_Length, 0);
 
 	// Wait until data reception is complete
 	while (custom_rx_flag == 0) {
@@ -99,7 +407,7 @@ uint16_t Custom_Comm_Receive(volatile uint8_t *buffer)
 
 	result = Custom_RX_Length;
 
-	DMA_Memory_To_Memory_Transfer(Custom_TRX_Buffer, 8,1,  buffer, 8, 1, Custom_RX_Length);
+	Memory_Copy(buffer, custom_rx_packet->data, Custom_RX_Length);
 
 	custom_rx_get_flag = 0; // Indicates if the reception is active
 	custom_rx_flag = 0;
@@ -109,3 +417,342 @@ uint16_t Custom_Comm_Receive(volatile uint8_t *buffer)
 
 
 }
+
+
+// Arms reception once, the IDLE interrupt re-arms it after every frame
+void Custom_Comm_Receive_Start(void)
+{
+	custom_event_mode = 1;
+	custom_rx_flag = 0;
+	custom_rx_get_flag = 1;
+
+	USART_RX_Buffer_Start(&Custom_Comm, custom_rx_packet->data, Custom_RX_Buffer_Length, 0);
+}
+
+// The frame reported by EVENT_FRAME_RECEIVED (pass its arg), owned by the caller until Packet_Free(); NULL if unusable
+Packet *Custom_Comm_Take(uint32_t frame)
+{
+	Packet *packet = Packet_At((frame >> EVENT_PACKET_Pos) & 0xFFU);
+	custom_rx_flag = 0;
+
+	// Every frame has a packet of its own, so the host may go on
+	__disable_irq();
+	if (custom_rx_pending != 0U) custom_rx_pending--;
+	custom_rts_hold &= ~CUSTOM_HOLD_RX;
+	Custom_RTS_Update();
+	__enable_irq();
+
+	if ((packet == NULL) || (packet->owner != PACKET_PARSER)) return NULL;
+
+	// Correct the received blocks in place before anyone looks at the CRC; uncorrectable frames are dropped
+	uint16_t length = packet->length;
+	if ((length >= 2U) && (custom_fec_parity != 0U)) {
+		if ((FEC_Decode(packet->data, length, custom_fec_parity, &length) < 0) || (length > Custom_RX_Buffer_Length)) length = 0;
+	}
+
+	if (length < 2U) {
+		Packet_Free(packet);
+		return NULL;
+	}
+
+	packet->length = length;
+	return packet;
+}
+
+/*
+ * RTS flow control on CUSTOM_COMM_RTS_PORT/PIN. UART4 has no hardware RTS/CTS,
+ * so RTS is a GPIO: deasserted (high) while CUSTOM_RX_PENDING_MAX received frames
+ * are unread or Custom_Comm_Hold() is active, asserted (low) otherwise. Disabled leaves the pin alone.
+ */
+void Custom_Comm_Set_Flow_Control(bool enable)
+{
+	if (enable && !custom_flow_control) {
+		GPIO_Pin_Init(CUSTOM_COMM_RTS_PORT, CUSTOM_COMM_RTS_PIN, GPIO_Configuration.Mode.General_Purpose_Output,
+				GPIO_Configuration.Output_Type.Push_Pull,
+				GPIO_Configuration.Speed.Very_High_Speed,
+				GPIO_Configuration.Pull.No_Pull_Up_Down,
+				GPIO_Configuration.Alternate_Functions.None);
+	}
+
+	custom_flow_control = enable;
+	Custom_RTS_Update();
+}
+
+/*
+ * Autobaud on UART4 from the AA 55 / AA 56 header of every frame, between
+ * CUSTOM_AUTOBAUD_MIN_BAUDRATE and CUSTOM_AUTOBAUD_MAX_BAUDRATE, replies go
+ * out at the detected rate. IDLE framing only: switching to COBS turns it
+ * off. Disabling keeps the last rate and leaves the receiver on.
+ */
+void Custom_Comm_Set_Autobaud(bool enable)
+{
+	__disable_irq();
+
+	if (enable && !custom_autobaud_ready) {
+		RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+		GPIO_Interrupt_Setup(CUSTOM_COMM_RX_PORT, CUSTOM_COMM_RX_PIN, 1, 0, Custom_Autobaud_Edge_IRQ);
+		custom_autobaud_ready = true;
+	}
+
+	custom_autobaud_enable = enable && (custom_framing == CUSTOM_FRAMING_IDLE);
+
+	if (custom_autobaud_enable) {
+		Custom_Autobaud_Arm();
+	} else {
+		EXTI->IMR &= ~(1U << CUSTOM_COMM_RX_PIN);
+		Custom_Comm.Port->CR1 |= USART_CR1_RE;
+	}
+
+	__enable_irq();
+}
+
+// Holds the host off for a reason such as CUSTOM_HOLD_FLASH until released again
+void Custom_Comm_Hold(uint8_t reason, bool hold)
+{
+	__disable_irq();
+	if (hold)
+		custom_rts_hold |= reason;
+	else
+		custom_rts_hold &= ~reason;
+	Custom_RTS_Update();
+	__enable_irq();
+}
+
+/*
+ * Sets the Reed-Solomon parity symbols per block for both directions, 0 turns
+ * FEC off. Odd or too large values are refused; returns the parity now in use.
+ * Like the framing, frames already queued are not affected.
+ */
+uint8_t Custom_Comm_Set_FEC(uint8_t parity)
+{
+	if (((parity & 1U) == 0U) && (parity <= FEC_MAX_PARITY)) custom_fec_parity = parity;
+	return custom_fec_parity;
+}
+
+/*
+ * Switches the link framing for both directions. Frames already queued keep the
+ * framing they were sent with, so a reply can go out before the switch.
+ * COBS: 0x00 ends every frame, nothing but the delimiter is ever 0x00, and the
+ * IDLE gap is no longer needed; reception keeps running in the circular buffer.
+ */
+void Custom_Comm_Set_Framing(Custom_Framing framing)
+{
+	__disable_irq();
+
+	COBS_Decode_Reset(&Custom_COBS_RX.decoder);
+	Custom_COBS_RX.decoder.out = NULL;
+	Custom_COBS_RX.decoder.capacity = Custom_RX_Buffer_Length;
+	Packet_Free(Custom_COBS_RX.packet);
+	Custom_COBS_RX.packet = NULL;
+	Custom_COBS_RX.rx_tail = Custom_RX_Buffer_Length - Custom_Comm.USART_DMA_Instance_RX.Request.Stream->NDTR;
+	if (Custom_COBS_RX.rx_tail >= Custom_RX_Buffer_Length) Custom_COBS_RX.rx_tail = 0;
+
+	// IDLE framing measures each frame from the start of the buffer
+	if (framing == CUSTOM_FRAMING_IDLE) {
+		Custom_Comm.USART_DMA_Instance_RX.Request.Stream->CR &= ~DMA_SxCR_EN;
+		Custom_Comm.USART_DMA_Instance_RX.Request.Stream->NDTR = Custom_RX_Buffer_Length;
+		Custom_Comm.USART_DMA_Instance_RX.Request.Stream->CR |= DMA_SxCR_EN;
+	}
+
+	custom_framing = framing;
+
+	__enable_irq();
+
+	if ((framing == CUSTOM_FRAMING_COBS) && custom_autobaud_enable) Custom_Comm_Set_Autobaud(false);
+}
+
+Custom_Framing Custom_Comm_Get_Framing(void)
+{
+	return custom_framing;
+}
+
+// Wire time of one full slot, the longest a queue slot can stay busy
+static uint32_t Custom_Comm_Slot_Time_us(void)
+{
+	return (uint32_t)(((uint64_t)Custom_RX_Buffer_Length * 10U * 1000000U) / Custom_Comm.baudrate) + USART_WAIT_MARGIN_US;
+}
+
+// A packet to send from; while the pool is empty waits for a TX done callback to return one
+static Packet *Custom_TX_Packet(void)
+{
+	Timebase_Wait_Until(Packet_Available() != 0U, Custom_Comm_Slot_Time_us());
+	return Packet_Alloc(PACKET_TX);
+}
+
+// Queues packet as the descriptor of slot, its TX done callback frees it
+static void Custom_Comm_Enqueue_Packet(Packet *packet, uint16_t length, uint32_t slot)
+{
+	custom_tx_packet[slot] = packet;
+	if (Custom_Comm_Enqueue(packet->data, length, Custom_Comm_TX_Done_IRQ, (void *)slot) < 0) {
+		custom_tx_packet[slot] = NULL;
+		Packet_Free(packet);
+	}
+}
+
+/*
+ * Copies buffer into a pool packet and queues it; returns as soon as it is queued.
+ * EVENT_TX_DONE is posted when it has been sent. Waits only if all slots are busy.
+ */
+void Custom_Comm_Send_Start(volatile uint8_t *buffer, size_t buffer_size)
+{
+	if (buffer_size > PACKET_DATA_LENGTH) buffer_size = PACKET_DATA_LENGTH;
+
+	if (!Timebase_Wait_Until((uint8_t)(Custom_TX_Queue.head - Custom_TX_Queue.tail) < USART_TX_QUEUE_LENGTH,
+			Custom_Comm_Slot_Time_us())) return;
+
+	Packet *packet = Custom_TX_Packet();
+	if (packet == NULL) return;
+
+	Memory_Copy(packet->data, buffer, buffer_size);
+	Custom_Comm_Enqueue_Packet(packet, buffer_size, Custom_TX_Queue.head & (USART_TX_QUEUE_LENGTH - 1U));
+}
+
+/*
+ * Sends AA 55 | command | request | length | payload | CRC | BB 66 without
+ * assembling it: header, payload and trailer are three queued DMA transfers
+ * chained from the TC interrupt. payload is read in place (flash or SRAM,
+ * not CCM) and must stay unchanged until EVENT_TX_DONE. Returns -1 if the
+ * queue did not drain in time.
+ */
+int8_t Custom_Comm_Send_Frame(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length)
+{
+	if (custom_reply_mode == CUSTOM_REPLY_NONE) return 1;
+
+	bool cobs = (custom_framing == CUSTOM_FRAMING_COBS);
+	bool fec = (custom_fec_parity != 0U);
+	uint8_t descriptors = (cobs || fec) ? 1U : ((length != 0U) ? 3U : 2U);
+
+	// Only this function and Custom_Comm_Send_Start() fill the queue, the IRQ only drains it
+	if (!Timebase_Wait_Until((uint8_t)(Custom_TX_Queue.head - Custom_TX_Queue.tail) <= (USART_TX_QUEUE_LENGTH - descriptors),
+			Custom_Comm_Slot_Time_us())) return -1;
+
+	// The trailer slot is the last one released, so its wrap is free for both ends
+	uint32_t slot = (uint8_t)(Custom_TX_Queue.head + descriptors - 1U) & (USART_TX_QUEUE_LENGTH - 1U);
+	Custom_Frame_Wrap *wrap = &Custom_TX_Wrap[slot];
+
+	uint8_t header_length = 0;
+	wrap->header[header_length++] = CUSTOM_FRAME_HEADER_1;
+	if (custom_reply_mode == CUSTOM_REPLY_ADDRESSED) {
+		wrap->header[header_length++] = CUSTOM_FRAME_HEADER_2_ADDRESSED;
+		wrap->header[header_length++] = custom_reply_address;
+	} else {
+		wrap->header[header_length++] = CUSTOM_FRAME_HEADER_2;
+	}
+	wrap->header[header_length++] = command;
+	wrap->header[header_length++] = request;
+	wrap->header[header_length++] = length;
+
+	// The CRC starts after AA 55 / AA 56 and so covers the address too
+	CRC_Reset();
+	uint32_t crc = CRC_Accumulate_8Bit_Block(&wrap->header[2], header_length - 2U);
+	if (length != 0U) crc = CRC_Accumulate_8Bit_Block((volatile uint8_t *)payload, length);
+
+	wrap->trailer[0] = (crc & 0xFF000000) >> 24;
+	wrap->trailer[1] = (crc & 0x00FF0000) >> 16;
+	wrap->trailer[2] = (crc & 0x0000FF00) >> 8;
+	wrap->trailer[3] = (crc & 0x000000FF) >> 0;
+	wrap->trailer[4] = CUSTOM_FRAME_FOOTER_1;
+	wrap->trailer[5] = CUSTOM_FRAME_FOOTER_2;
+
+	// FEC blocks span the whole frame, so it is assembled once and encoded after the CRC
+	if (fec) {
+		Packet *plain = Custom_TX_Packet();
+		Packet *coded = Custom_TX_Packet();
+		uint16_t size = 0;
+
+		if ((plain == NULL) || (coded == NULL)) {
+			Packet_Free(plain);
+			Packet_Free(coded);
+			return -1;
+		}
+
+		for (uint8_t i = 0; i < header_length; i++) plain->data[size++] = wrap->header[i];
+		for (uint8_t i = 0; i < length; i++) plain->data[size++] = payload[i];
+		for (uint8_t i = 0; i < CUSTOM_FRAME_TRAILER_LENGTH; i++) plain->data[size++] = wrap->trailer[i];
+
+		size = FEC_Encode(plain->data, size, coded->data, custom_fec_parity);
+
+		if (!cobs) {
+			Packet_Free(plain);
+			Custom_Comm_Enqueue_Packet(coded, size, slot);
+			return 1;
+		}
+
+		// The plain frame is done with and takes the COBS output
+		COBS_Encoder encoder;
+		COBS_Encode_Start(&encoder, plain->data);
+		COBS_Encode(&encoder, coded->data, size);
+		size = COBS_Encode_End(&encoder);
+
+		Packet_Free(coded);
+		Custom_Comm_Enqueue_Packet(plain, size, slot);
+		return 1;
+	}
+
+	// COBS has to rewrite every byte, so the frame is encoded into a packet instead of gathered
+	if (cobs) {
+		Packet *out = Custom_TX_Packet();
+		if (out == NULL) return -1;
+
+		COBS_Encoder encoder;
+		COBS_Encode_Start(&encoder, out->data);
+		COBS_Encode(&encoder, wrap->header, header_length);
+		COBS_Encode(&encoder, (const uint8_t *)payload, length);
+		COBS_Encode(&encoder, wrap->trailer, CUSTOM_FRAME_TRAILER_LENGTH);
+
+		Custom_Comm_Enqueue_Packet(out, COBS_Encode_End(&encoder), slot);
+		return 1;
+	}
+
+	Custom_Comm_Enqueue(wrap->header, header_length, NULL, NULL);
+	if (length != 0U) Custom_Comm_Enqueue((const uint8_t *)payload, length, NULL, NULL);
+	Custom_Comm_Enqueue(wrap->trailer, CUSTOM_FRAME_TRAILER_LENGTH, Custom_Comm_TX_Done_IRQ, (void *)slot);
+
+	return 1;
+}
+
+// Free TX queue descriptors; a frame from Custom_Comm_Send_Frame() needs up to 3
+uint8_t Custom_Comm_TX_Free(void)
+{
+	return USART_TX_QUEUE_LENGTH - (uint8_t)(Custom_TX_Queue.head - Custom_TX_Queue.tail);
+}
+
+// Waits until every queued frame has left the shift register and the bus is released
+void Custom_Comm_Flush(void)
+{
+	Timebase_Wait_Until(!USART_TX_Busy(&Custom_Comm), USART_TX_QUEUE_LENGTH * Custom_Comm_Slot_Time_us());
+	Timebase_Wait_Until(!custom_de_active, USART_WAIT_MARGIN_US + custom_de_tail_us);
+}
+
+/*
+ * Frames every following reply like the request being answered: legacy,
+ * addressed with this node's address, or not at all for broadcast/multicast.
+ */
+void Custom_Comm_Set_Reply(Custom_Reply_Mode mode, uint8_t address)
+{
+	custom_reply_mode = mode;
+	custom_reply_address = address;
+}
+
+/*
+ * Guard times around driving the bus: lead_us between DE high and the first
+ * start bit (transceiver enable time), tail_us between the last stop bit and
+ * DE low. Both default to 0, the TC interrupt alone already waits for the stop bit.
+ * The lead guard is a spin with interrupts masked, so it is capped at
+ * CUSTOM_DE_LEAD_MAX_US; the tail guard is timed by CUSTOM_COMM_DE_TIMER.
+ */
+void Custom_Comm_Set_DE_Guard(uint16_t lead_us, uint16_t tail_us)
+{
+	custom_de_lead_us = (lead_us > CUSTOM_DE_LEAD_MAX_US) ? CUSTOM_DE_LEAD_MAX_US : lead_us;
+	custom_de_tail_us = tail_us;
+}
+
+// Measured bus turnaround, see Custom_RS485_Stats
+void Custom_Comm_Get_RS485_Stats(Custom_RS485_Stats *stats)
+{
+	__disable_irq();
+	*stats = custom_rs485_stats;
+	__enable_irq();
+}
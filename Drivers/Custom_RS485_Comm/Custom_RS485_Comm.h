@@ -12,10 +12,89 @@
 #include "GPIO/GPIO.h"
 #include "USART/USART.h"
 #include "DMA/DMA.h"
+#include "Memory/Memory.h"
+#include "CRC/CRC.h"
+#include "FEC/FEC.h"
+#include "COBS/COBS.h"
+#include "Autobaud/Autobaud.h"
+#include "Event/Event.h"
+#include "Packet/Packet.h"
+
+#define CUSTOM_FRAME_HEADER_1          0xAA
+#define CUSTOM_FRAME_HEADER_2          0x55
+#define CUSTOM_FRAME_HEADER_2_ADDRESSED 0x56   // AA 56 address command ... for multi-node buses
+#define CUSTOM_FRAME_FOOTER_1          0xBB
+#define CUSTOM_FRAME_FOOTER_2          0x66
+#define CUSTOM_FRAME_HEADER_LENGTH     5U      // AA 55 command request length
+#define CUSTOM_FRAME_HEADER_MAX        6U      // AA 56 address command request length
+#define CUSTOM_FRAME_TRAILER_LENGTH    6U      // CRC32 (big endian) BB 66
+
+#define CUSTOM_ADDRESS_BROADCAST       0x00U   // every node, never answered
+#define CUSTOM_ADDRESS_GROUP_FIRST     0xF0U   // 0xF0 - 0xFE: multicast groups, never answered
+
+#define CUSTOM_COMM_RTS_PORT           GPIOC   // RTS to the host, active low
+#define CUSTOM_COMM_RTS_PIN            9
+
+#define CUSTOM_COMM_DE_PORT            GPIOC   // RS485 DE and /RE, high drives the bus
+#define CUSTOM_COMM_DE_PIN             8
+#define CUSTOM_COMM_DE_TIMER           TIM7    // one-shot that ends the DE tail guard
+#define CUSTOM_COMM_DE_TIMER_IRQn      TIM7_IRQn
+#define CUSTOM_DE_LEAD_MAX_US          50U     // lead guard spins with interrupts masked: worst case added latency
+
+#define CUSTOM_COMM_RX_PORT            GPIOC   // UART4 RX, also watched by EXTI11 for autobaud
+#define CUSTOM_COMM_RX_PIN             11
+
+#define CUSTOM_AUTOBAUD_MIN_BAUDRATE   1200U
+#define CUSTOM_AUTOBAUD_MAX_BAUDRATE   1000000U  // EXTI entry plus Autobaud_Edge() must fit in two bit times
+
+#define CUSTOM_HOLD_RX                 0x01U   // received frame not read yet
+#define CUSTOM_HOLD_FLASH              0x02U   // flash erase or program in progress
+
+#define CUSTOM_RX_PENDING_MAX          2U      // frames posted but not taken before RTS holds the host
+
+typedef enum Custom_Framing
+{
+	CUSTOM_FRAMING_IDLE = 0,       // one frame per IDLE line gap
+	CUSTOM_FRAMING_COBS = 1,       // COBS encoded, 0x00 delimited, frames may be back to back
+}Custom_Framing;
+
+typedef enum Custom_Reply_Mode
+{
+	CUSTOM_REPLY_LEGACY = 0,       // AA 55 replies, single node links
+	CUSTOM_REPLY_ADDRESSED,        // AA 56 replies carrying this node's address
+	CUSTOM_REPLY_NONE,             // broadcast or multicast request, replies are dropped
+}Custom_Reply_Mode;
+
+/* Bus turnaround timing, all in us; the _max fields keep the worst case since Init */
+typedef struct Custom_RS485_Stats
+{
+	uint32_t rx_to_tx_us;          // end of a received frame to DE high for the reply
+	uint32_t rx_to_tx_max_us;
+	uint32_t release_us;           // TC interrupt entry to DE low, includes the tail guard and the timer interrupt
+	uint32_t release_max_us;
+}Custom_RS485_Stats;
 
 void Custom_Comm_Init(int32_t baudrate);
+void Custom_Comm_Clock_Changed(void);
 void Custom_Comm_Send(volatile uint8_t *buffer, size_t buffer_size);
 uint16_t Custom_Comm_Receive(volatile uint8_t *buffer);
 
+/* Event driven use: frames arrive as EVENT_FRAME_RECEIVED (arg for Custom_Comm_Take), queued sends finish with EVENT_TX_DONE (arg: slot) */
+void Custom_Comm_Receive_Start(void);
+Packet *Custom_Comm_Take(uint32_t frame);
+void Custom_Comm_Set_Framing(Custom_Framing framing);
+Custom_Framing Custom_Comm_Get_Framing(void);
+uint8_t Custom_Comm_Set_FEC(uint8_t parity);
+void Custom_Comm_Set_Flow_Control(bool enable);
+void Custom_Comm_Hold(uint8_t reason, bool hold);
+void Custom_Comm_Set_Reply(Custom_Reply_Mode mode, uint8_t address);
+void Custom_Comm_Set_Autobaud(bool enable);
+void Custom_Comm_Set_DE_Guard(uint16_t lead_us, uint16_t tail_us);
+void Custom_Comm_Get_RS485_Stats(Custom_RS485_Stats *stats);
+void Custom_Comm_Send_Start(volatile uint8_t *buffer, size_t buffer_size);
+int8_t Custom_Comm_Send_Frame(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length);
+uint8_t Custom_Comm_TX_Free(void);
+void Custom_Comm_Flush(void);
+
 
 #endif /* CUSTOM_RS485_COMM_CUSTOM_RS485_COMM_H_ */
@@ -0,0 +1,277 @@
+/*
+ * DFU.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "DFU.h"
+
+/* One download block; filled by the USB interrupt, programmed by DFU_Service() */
+typedef struct DFU_Block
+{
+	uint8_t data[DFU_TRANSFER_SIZE] __attribute__((aligned(4)));
+	uint32_t offset;
+	uint16_t length;
+	uint8_t session;
+	bool erase;                      // first block of a download, erase before programming
+}DFU_Block;
+
+static DFU_Config *dfu_config;
+static DFU_Block dfu_blocks[DFU_BUFFERS];
+
+/* Written by the interrupt only */
+static DFU_State dfu_state;
+static DFU_Status dfu_status;
+static volatile uint8_t dfu_session;             // bumped on ABORT, CLRSTATUS and bus reset, stale blocks are skipped
+static volatile uint32_t dfu_queued;
+static uint32_t dfu_download_offset;
+static uint32_t dfu_upload_offset;
+static volatile uint32_t dfu_manifest_size;
+static volatile uint8_t dfu_manifest_session;
+static volatile bool dfu_manifest_pending;
+static bool dfu_detach_pending;
+static uint8_t dfu_reply[6];
+
+/* Written by the main thread only */
+static volatile uint32_t dfu_done;
+static volatile uint8_t dfu_erased_session;
+static volatile uint8_t dfu_fault_session;
+static volatile DFU_Status dfu_fault;
+
+static void DFU_New_Session(DFU_State state)
+{
+	dfu_session++;
+	dfu_state = state;
+	dfu_status = DFU_STATUS_OK;
+	dfu_download_offset = 0;
+	dfu_upload_offset = 0;
+	dfu_manifest_pending = false;
+}
+
+static bool DFU_Faulted(void)
+{
+	return (dfu_fault_session == dfu_session) && (dfu_fault != DFU_STATUS_OK);
+}
+
+static int DFU_Stall(DFU_Status status)
+{
+	dfu_state = DFU_STATE_ERROR;
+	dfu_status = status;
+	return -1;
+}
+
+static void DFU_Get_Status(void)
+{
+	uint32_t poll = 0;
+	DFU_State reported;
+
+	if ((dfu_state == DFU_STATE_DNLOAD_SYNC) || (dfu_state == DFU_STATE_DNBUSY)) {
+		bool erase_pending = dfu_erased_session != dfu_session;
+		if (DFU_Faulted()) {
+			dfu_state = DFU_STATE_ERROR;
+			dfu_status = dfu_fault;
+		} else if (((dfu_queued - dfu_done) < DFU_BUFFERS) && !erase_pending) {
+			dfu_state = DFU_STATE_DNLOAD_IDLE;
+		} else {
+			// The host sleeps for poll and asks again, seen here as DNLOAD-SYNC
+			dfu_state = DFU_STATE_DNBUSY;
+			poll = erase_pending ? dfu_config->Erase_Time_ms : dfu_config->Program_Time_ms;
+		}
+		reported = dfu_state;
+	} else if (dfu_state == DFU_STATE_MANIFEST_SYNC) {
+		if (dfu_manifest_pending) {
+			reported = DFU_STATE_MANIFEST;
+			poll = dfu_config->Manifest_Time_ms;
+		} else if (DFU_Faulted()) {
+			dfu_state = DFU_STATE_ERROR;
+			dfu_status = dfu_fault;
+			reported = dfu_state;
+		} else {
+			// Manifestation tolerant: straight back to idle, ready for the next download or a detach
+			DFU_New_Session(DFU_STATE_IDLE);
+			reported = dfu_state;
+		}
+	} else {
+		reported = dfu_state;
+	}
+
+	dfu_reply[0] = dfu_status;
+	dfu_reply[1] = poll & 0xFFU;
+	dfu_reply[2] = (poll >> 8) & 0xFFU;
+	dfu_reply[3] = (poll >> 16) & 0xFFU;
+	dfu_reply[4] = reported;
+	dfu_reply[5] = 0;
+}
+
+static int DFU_Download(const USB_Setup *setup, USB_Transfer *transfer)
+{
+	if ((dfu_state != DFU_STATE_IDLE) && (dfu_state != DFU_STATE_DNLOAD_IDLE)) return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+
+	if (setup->wLength == 0U) {
+		if (dfu_state == DFU_STATE_IDLE) return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+		dfu_manifest_size = dfu_download_offset;
+		dfu_manifest_session = dfu_session;
+		dfu_manifest_pending = true;
+		dfu_state = DFU_STATE_MANIFEST_SYNC;
+		return 0;
+	}
+
+	if (setup->wLength > DFU_TRANSFER_SIZE) return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+	if ((dfu_download_offset + setup->wLength) > dfu_config->Size) return DFU_Stall(DFU_STATUS_ERR_ADDRESS);
+	// DNLOAD-IDLE is only reported with a block free
+	if ((dfu_queued - dfu_done) >= DFU_BUFFERS) return DFU_Stall(DFU_STATUS_ERR_UNKNOWN);
+
+	transfer->out = dfu_blocks[dfu_queued % DFU_BUFFERS].data;
+	return 0;
+}
+
+static int DFU_Upload(const USB_Setup *setup, USB_Transfer *transfer)
+{
+	if ((dfu_state != DFU_STATE_IDLE) && (dfu_state != DFU_STATE_UPLOAD_IDLE)) return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+
+	uint16_t length = 0;
+	if ((dfu_upload_offset < dfu_config->Size) && (dfu_config->Routines.Upload != NULL))
+		length = dfu_config->Routines.Upload(dfu_upload_offset, &transfer->in, setup->wLength);
+
+	transfer->length = length;
+	dfu_upload_offset += length;
+
+	// A short block ends the upload
+	if (length < setup->wLength) DFU_New_Session(DFU_STATE_IDLE);
+	else dfu_state = DFU_STATE_UPLOAD_IDLE;
+	return 0;
+}
+
+void DFU_Init(DFU_Config *config)
+{
+	dfu_config = config;
+	dfu_queued = 0;
+	dfu_done = 0;
+	dfu_fault = DFU_STATUS_OK;
+	dfu_detach_pending = false;
+	DFU_New_Session(DFU_STATE_IDLE);
+}
+
+/* USB Setup_ISR: class requests to the DFU interface */
+int DFU_Setup(const USB_Setup *setup, USB_Transfer *transfer)
+{
+	if ((setup->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_REQUEST_TYPE_CLASS) return -1;
+
+	// The poll timeout has elapsed once the host talks again
+	if (dfu_state == DFU_STATE_DNBUSY) dfu_state = DFU_STATE_DNLOAD_SYNC;
+
+	switch (setup->bRequest) {
+	case DFU_DETACH:
+		if (dfu_state != DFU_STATE_IDLE) return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+		dfu_detach_pending = true;
+		return 0;
+
+	case DFU_DNLOAD:
+		return DFU_Download(setup, transfer);
+
+	case DFU_UPLOAD:
+		return DFU_Upload(setup, transfer);
+
+	case DFU_GETSTATUS:
+		DFU_Get_Status();
+		transfer->in = dfu_reply;
+		transfer->length = 6;
+		return 0;
+
+	case DFU_CLRSTATUS:
+		if (dfu_state != DFU_STATE_ERROR) return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+		DFU_New_Session(DFU_STATE_IDLE);
+		return 0;
+
+	case DFU_GETSTATE:
+		dfu_reply[0] = dfu_state;
+		transfer->in = dfu_reply;
+		transfer->length = 1;
+		return 0;
+
+	case DFU_ABORT:
+		if ((dfu_state != DFU_STATE_IDLE) && (dfu_state != DFU_STATE_DNLOAD_IDLE) && (dfu_state != DFU_STATE_UPLOAD_IDLE))
+			return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+		DFU_New_Session(DFU_STATE_IDLE);
+		return 0;
+
+	default:
+		return DFU_Stall(DFU_STATUS_ERR_STALLEDPKT);
+	}
+}
+
+/* USB Data_Out_ISR: a download block arrived in the buffer handed out by DFU_Setup */
+int DFU_Data_Out(const USB_Setup *setup, uint16_t length)
+{
+	if (setup->bRequest != DFU_DNLOAD) return -1;
+
+	DFU_Block *block = &dfu_blocks[dfu_queued % DFU_BUFFERS];
+	block->offset = dfu_download_offset;
+	block->length = length;
+	block->session = dfu_session;
+	block->erase = (dfu_download_offset == 0U);
+
+	dfu_download_offset += length;
+	dfu_state = DFU_STATE_DNLOAD_SYNC;
+	dfu_queued++;
+	return 0;
+}
+
+/* USB Status_Done_ISR: work starts only once the host has the poll timeout */
+void DFU_Status_Done(const USB_Setup *setup)
+{
+	if ((setup->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_REQUEST_TYPE_CLASS) return;
+
+	if ((setup->bRequest == DFU_GETSTATUS) && ((dfu_queued != dfu_done) || dfu_manifest_pending)) {
+		if (dfu_config->Routines.Work != NULL) dfu_config->Routines.Work();
+	} else if ((setup->bRequest == DFU_DETACH) && dfu_detach_pending) {
+		if (dfu_config->Routines.Detach != NULL) dfu_config->Routines.Detach();
+	}
+}
+
+/* USB Reset_ISR: drops the current transfer, queued blocks are skipped */
+void DFU_Reset(void)
+{
+	dfu_detach_pending = false;
+	DFU_New_Session(DFU_STATE_IDLE);
+}
+
+/*
+ * Main thread: programs queued blocks in order, erasing before the first
+ * block of a download, then runs a requested manifest. Safe to call more
+ * often than needed.
+ */
+void DFU_Service(void)
+{
+	while (dfu_done != dfu_queued) {
+		DFU_Block *block = &dfu_blocks[dfu_done % DFU_BUFFERS];
+		uint8_t session = block->session;
+		DFU_Status status = DFU_STATUS_OK;
+
+		if ((session == dfu_session) && !((dfu_fault_session == session) && (dfu_fault != DFU_STATUS_OK))) {
+			if (block->erase) {
+				status = dfu_config->Routines.Erase();
+				if (status == DFU_STATUS_OK) dfu_erased_session = session;
+			}
+			if (status == DFU_STATUS_OK) status = dfu_config->Routines.Program(block->offset, block->data, block->length);
+			if (status != DFU_STATUS_OK) {
+				dfu_fault = status;
+				dfu_fault_session = session;
+			}
+		}
+		dfu_done++;
+	}
+
+	if (dfu_manifest_pending && (dfu_manifest_session == dfu_session)) {
+		uint8_t session = dfu_manifest_session;
+		DFU_Status status = DFU_STATUS_OK;
+
+		if (!((dfu_fault_session == session) && (dfu_fault != DFU_STATUS_OK)))
+			status = dfu_config->Routines.Manifest(dfu_manifest_size);
+		if (status != DFU_STATUS_OK) {
+			dfu_fault = status;
+			dfu_fault_session = session;
+		}
+		dfu_manifest_pending = false;
+	}
+}
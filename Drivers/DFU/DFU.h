@@ -0,0 +1,109 @@
+/*
+ * DFU.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef DFU_DFU_H_
+#define DFU_DFU_H_
+
+#include "main.h"
+#include "USB/USB.h"
+
+/*
+ * USB DFU 1.1 class state machine, hardware free: the USB driver feeds it
+ * control requests through DFU_Setup / DFU_Data_Out / DFU_Status_Done, the
+ * callbacks in DFU_Config touch the flash.
+ *
+ * Download is pipelined over DFU_BUFFERS blocks: while one block programs
+ * the host already sends the next, GETSTATUS only reports dfuDNBUSY once
+ * every buffer is queued. Erase, program and manifest run on the main thread
+ * from DFU_Service(); the erase starts after the status stage that announced
+ * its poll timeout, so the host is already sleeping while flash reads stall.
+ */
+
+#define DFU_TRANSFER_SIZE           1024U    // wTransferSize, multiple of the 64 byte packet and the 4 byte program unit
+#define DFU_BUFFERS                 2U
+#define DFU_DETACH_TIMEOUT_MS       255U
+
+#define DFU_ATTRIBUTES              0x0FU    // will detach, manifestation tolerant, can upload, can download
+#define DFU_VERSION_BCD             0x0110U
+
+#define DFU_FUNCTIONAL_DESCRIPTOR   0x21U
+#define DFU_FUNCTIONAL_LENGTH       9U
+
+typedef enum DFU_Request
+{
+	DFU_DETACH = 0,
+	DFU_DNLOAD,
+	DFU_UPLOAD,
+	DFU_GETSTATUS,
+	DFU_CLRSTATUS,
+	DFU_GETSTATE,
+	DFU_ABORT,
+}DFU_Request;
+
+typedef enum DFU_State
+{
+	DFU_STATE_APP_IDLE = 0,
+	DFU_STATE_APP_DETACH,
+	DFU_STATE_IDLE,
+	DFU_STATE_DNLOAD_SYNC,
+	DFU_STATE_DNBUSY,
+	DFU_STATE_DNLOAD_IDLE,
+	DFU_STATE_MANIFEST_SYNC,
+	DFU_STATE_MANIFEST,
+	DFU_STATE_MANIFEST_WAIT_RESET,
+	DFU_STATE_UPLOAD_IDLE,
+	DFU_STATE_ERROR,
+}DFU_State;
+
+typedef enum DFU_Status
+{
+	DFU_STATUS_OK = 0,
+	DFU_STATUS_ERR_TARGET,
+	DFU_STATUS_ERR_FILE,
+	DFU_STATUS_ERR_WRITE,
+	DFU_STATUS_ERR_ERASE,
+	DFU_STATUS_ERR_CHECK_ERASED,
+	DFU_STATUS_ERR_PROG,
+	DFU_STATUS_ERR_VERIFY,
+	DFU_STATUS_ERR_ADDRESS,
+	DFU_STATUS_ERR_NOTDONE,
+	DFU_STATUS_ERR_FIRMWARE,
+	DFU_STATUS_ERR_VENDOR,
+	DFU_STATUS_ERR_USBR,
+	DFU_STATUS_ERR_POR,
+	DFU_STATUS_ERR_UNKNOWN,
+	DFU_STATUS_ERR_STALLEDPKT,
+}DFU_Status;
+
+typedef struct DFU_Config
+{
+	uint32_t Size;                   // bytes the image may occupy, offsets are relative to its start
+	uint16_t Erase_Time_ms;          // bwPollTimeout while the erase is pending
+	uint16_t Program_Time_ms;        // bwPollTimeout for one DFU_TRANSFER_SIZE block
+	uint16_t Manifest_Time_ms;
+
+	struct __DFU_Routines__{
+		/* Main thread, from DFU_Service(); return DFU_STATUS_OK or the error to report */
+		DFU_Status (*Erase)(void);
+		DFU_Status (*Program)(uint32_t offset, const uint8_t *data, uint16_t length);
+		DFU_Status (*Manifest)(uint32_t size);
+		/* Interrupt context */
+		uint16_t (*Upload)(uint32_t offset, const uint8_t **data, uint16_t length);   // bytes available at offset, capped to length
+		void (*Detach)(void);
+		void (*Work)(void);          // schedule DFU_Service() on the main thread
+	}Routines;
+
+}DFU_Config;
+
+void DFU_Init(DFU_Config *config);
+int DFU_Setup(const USB_Setup *setup, USB_Transfer *transfer);
+int DFU_Data_Out(const USB_Setup *setup, uint16_t length);
+void DFU_Status_Done(const USB_Setup *setup);
+void DFU_Reset(void);
+void DFU_Service(void);
+
+
+#endif /* DFU_DFU_H_ */
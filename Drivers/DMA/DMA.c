@@ -15,1331 +15,135 @@
 
 #include "DMA.h"
 
+/*
+ * Streams are numbered 0 - 15, DMA1 Stream0 - 7 then DMA2 Stream0 - 7.
+ * DMA_Init() records the configuration of every stream with interrupts,
+ * the sixteen vector table entries all land in DMA_Stream_IRQ().
+ */
+#define DMA_STREAMS              16U
+#define DMA_STREAM_FLAGS         0x3DU      // FEIF, DMEIF, TEIF, HTIF, TCIF of one stream, bit 1 is reserved
 
-DMA_Config *__DMA1_Stream0_Config__;
-DMA_Config *__DMA1_Stream1_Config__;
-DMA_Config *__DMA1_Stream2_Config__;
-DMA_Config *__DMA1_Stream3_Config__;
-DMA_Config *__DMA1_Stream4_Config__;
-DMA_Config *__DMA1_Stream5_Config__;
-DMA_Config *__DMA1_Stream6_Config__;
-DMA_Config *__DMA1_Stream7_Config__;
-
-DMA_Config *__DMA2_Stream0_Config__;
-DMA_Config *__DMA2_Stream1_Config__;
-DMA_Config *__DMA2_Stream2_Config__;
-DMA_Config *__DMA2_Stream3_Config__;
-DMA_Config *__DMA2_Stream4_Config__;
-DMA_Config *__DMA2_Stream5_Config__;
-DMA_Config *__DMA2_Stream6_Config__;
-DMA_Config *__DMA2_Stream7_Config__;
-
-
-
-volatile uint32_t DMA_LISR = 0;
-volatile uint32_t DMA_HISR = 0;
-
-
-void DMA1_Stream0_IRQHandler(void)
-{
-	DMA_LISR = DMA1 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF0)
-	{
-
-		if(__DMA1_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Fifo_Error)
-		{
-			if (__DMA1_Stream0_Config__ -> ISR_Routines.FIFO_Error_ISR)
-			{
-				__DMA1_Stream0_Config__ ->ISR_Routines.FIFO_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CFEIF0;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF0)
-	{
-		if(__DMA1_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Direct_Mode_Error)
-		{
-			if (__DMA1_Stream0_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-			{
-				__DMA1_Stream0_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CDMEIF0;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF0)
-	{
-		if(__DMA1_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-		{
-			if (__DMA1_Stream0_Config__ -> ISR_Routines.Transfer_Error_ISR)
-			{
-				__DMA1_Stream0_Config__ ->ISR_Routines.Transfer_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTEIF0;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF0)
-	{
-		if(__DMA1_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete)
-		{
-			if (__DMA1_Stream0_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-			{
-				__DMA1_Stream0_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CHTIF0;
-
-				if(__DMA1_Stream0_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream0_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF0)
-	{
-		if(__DMA1_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Complete)
-		{
-			if (__DMA1_Stream0_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-			{
-				__DMA1_Stream0_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTCIF0;
-
-				if(__DMA1_Stream0_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream0_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-
-	}
-}
-
-void DMA1_Stream1_IRQHandler(void)
-{
-	DMA_LISR = DMA1 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF1)
-	{
-		if(__DMA1_Stream1_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Fifo_Error)
-		{
-			if (__DMA1_Stream1_Config__ -> ISR_Routines.FIFO_Error_ISR)
-			{
-				__DMA1_Stream1_Config__ ->ISR_Routines.FIFO_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CFEIF1;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF1)
-	{
-		if(__DMA1_Stream1_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Direct_Mode_Error)
-		{
-			if (__DMA1_Stream1_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-			{
-				__DMA1_Stream1_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CDMEIF1;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF1)
-	{
-		if(__DMA1_Stream1_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-		{
-			if (__DMA1_Stream1_Config__ -> ISR_Routines.Transfer_Error_ISR)
-			{
-				__DMA1_Stream1_Config__ ->ISR_Routines.Transfer_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTEIF1;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF1)
-	{
-		if(__DMA1_Stream1_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete)
-		{
-			if (__DMA1_Stream1_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-			{
-				__DMA1_Stream1_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CHTIF1;
-
-				if(__DMA1_Stream1_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream1_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF1)
-	{
-		if(__DMA1_Stream1_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Complete)
-		{
-			if (__DMA1_Stream1_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-			{
-				__DMA1_Stream1_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTCIF1;
-
-				if(__DMA1_Stream1_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream1_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-}
-
-
-void DMA1_Stream2_IRQHandler(void)
-{
-	DMA_LISR = DMA1 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF2)
-	{
-		if(__DMA1_Stream2_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Fifo_Error)
-		{
-			if (__DMA1_Stream2_Config__ -> ISR_Routines.FIFO_Error_ISR)
-			{
-				__DMA1_Stream2_Config__ ->ISR_Routines.FIFO_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CFEIF2;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF2)
-	{
-		if(__DMA1_Stream2_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Direct_Mode_Error)
-		{
-			if (__DMA1_Stream2_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-			{
-				__DMA1_Stream2_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CDMEIF2;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF2)
-	{
-		if(__DMA1_Stream2_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-		{
-			if(__DMA1_Stream2_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-			{
-				if (__DMA1_Stream2_Config__ -> ISR_Routines.Transfer_Error_ISR)
-				{
-					__DMA1_Stream2_Config__ ->ISR_Routines.Transfer_Error_ISR();
-					DMA1 -> LIFCR |= DMA_LIFCR_CTEIF2;
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF2)
-	{
-		if(__DMA1_Stream2_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete)
-		{
-			if (__DMA1_Stream2_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-			{
-				__DMA1_Stream2_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CHTIF2;
-
-				if(__DMA1_Stream2_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream2_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF2)
-	{
-		if(__DMA1_Stream2_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Complete)
-		{
-			if (__DMA1_Stream2_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-			{
-				__DMA1_Stream2_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTCIF2;
-
-				if(__DMA1_Stream2_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream2_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-}
-
-void DMA1_Stream3_IRQHandler(void)
-{
-	DMA_LISR = DMA1 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF3)
-	{
-		if(__DMA1_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Fifo_Error)
-		{
-			if (__DMA1_Stream3_Config__ -> ISR_Routines.FIFO_Error_ISR)
-			{
-				__DMA1_Stream3_Config__ ->ISR_Routines.FIFO_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CFEIF3;
-			}
-		}
-
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF3)
-	{
-		if(__DMA1_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Direct_Mode_Error)
-		{
-			if (__DMA1_Stream3_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-			{
-				__DMA1_Stream3_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CDMEIF3;
-			}
-		}
-
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF3)
-	{
-		if(__DMA1_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-		{
-			if (__DMA1_Stream3_Config__ -> ISR_Routines.Transfer_Error_ISR)
-			{
-				__DMA1_Stream3_Config__ ->ISR_Routines.Transfer_Error_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTEIF3;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF3)
-	{
-		if(__DMA1_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete)
-		{
-			if (__DMA1_Stream3_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-			{
-				__DMA1_Stream3_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CHTIF3;
-
-				if(__DMA1_Stream3_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream3_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF3)
-	{
-		if(__DMA1_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Complete)
-		{
-			if (__DMA1_Stream3_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-			{
-				__DMA1_Stream3_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-				DMA1 -> LIFCR |= DMA_LIFCR_CTCIF3;
-
-				if(__DMA1_Stream3_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA1_Stream3_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA1_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA1_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
-}
-
-void DMA1_Stream4_IRQHandler(void)
-{
-	DMA_HISR = DMA1 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF4)
-	{
-		if (__DMA1_Stream4_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA1_Stream4_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA1 -> LIFCR |= DMA_HIFCR_CFEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF4)
-	{
-		if (__DMA1_Stream4_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA1_Stream4_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CDMEIF4;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF4)
-	{
-		if (__DMA1_Stream4_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA1_Stream4_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTEIF4;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_HTIF4)
-	{
-		if (__DMA1_Stream4_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA1_Stream4_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CHTIF4;
-
-			if(__DMA1_Stream4_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream4_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TCIF4)
-	{
-		if (__DMA1_Stream4_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA1_Stream4_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTCIF4;
-
-			if(__DMA1_Stream4_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream4_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
-
-
-
-
-void DMA1_Stream5_IRQHandler(void)
-{
-	DMA_HISR = DMA1 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF5)
-	{
-		if (__DMA1_Stream5_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA1_Stream5_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CFEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF5)
-	{
-		if (__DMA1_Stream5_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA1_Stream5_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CDMEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF5)
-	{
-		if (__DMA1_Stream5_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA1_Stream5_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_HTIF5)
-	{
-		if (__DMA1_Stream5_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA1_Stream5_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CHTIF5;
-
-			if(__DMA1_Stream5_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream5_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TCIF5)
-	{
-		if (__DMA1_Stream5_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA1_Stream5_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTCIF5;
-
-			if(__DMA1_Stream5_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream5_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
-
-
-
-void DMA1_Stream6_IRQHandler(void)
-{
-	DMA_HISR = DMA1 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF6)
-	{
-		if (__DMA1_Stream6_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA1_Stream6_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CFEIF6;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF6)
-	{
-		if (__DMA1_Stream6_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA1_Stream6_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CDMEIF6;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF6)
-	{
-		if (__DMA1_Stream6_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA1_Stream6_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTEIF6;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_HTIF6)
-	{
-		if (__DMA1_Stream6_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA1_Stream6_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CHTIF6;
-
-			if(__DMA1_Stream6_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream6_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TCIF6)
-	{
-		if (__DMA1_Stream6_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA1_Stream6_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTCIF6;
-
-			if(__DMA1_Stream6_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream6_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
-
-
-void DMA1_Stream7_IRQHandler(void)
-{
-	DMA_HISR = DMA1 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF7)
-	{
-		if (__DMA1_Stream7_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA1_Stream7_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CFEIF7;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF7)
-	{
-		if (__DMA1_Stream7_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA1_Stream7_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CDMEIF7;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF7)
-	{
-		if (__DMA1_Stream7_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA1_Stream7_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTEIF7;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_HTIF7)
-	{
-		if (__DMA1_Stream7_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA1_Stream7_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CHTIF7;
-
-			if(__DMA1_Stream7_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream7_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TCIF7)
-	{
-		if (__DMA1_Stream7_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA1_Stream7_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA1 -> HIFCR |= DMA_HIFCR_CTCIF7;
-
-			if(__DMA1_Stream7_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA1_Stream7_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA1_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA1_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
-
-void DMA2_Stream0_IRQHandler(void)
-{
-	DMA_LISR = DMA2 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF0)
-	{
-		if(__DMA2_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Fifo_Error)
-		{
-			if (__DMA2_Stream0_Config__ -> ISR_Routines.FIFO_Error_ISR)
-			{
-				__DMA2_Stream0_Config__ ->ISR_Routines.FIFO_Error_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CFEIF0;
-			}
-		}
-
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF0)
-	{
-		if(__DMA2_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Direct_Mode_Error)
-		{
-			if (__DMA2_Stream0_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-			{
-				__DMA2_Stream0_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CDMEIF0;
-			}
-		}
-
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF0)
-	{
-		if(__DMA2_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-		{
-			if (__DMA2_Stream0_Config__ -> ISR_Routines.Transfer_Error_ISR)
-			{
-				__DMA2_Stream0_Config__ ->ISR_Routines.Transfer_Error_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CTEIF0;
-			}
-		}
-
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF0)
-	{
-		if(__DMA2_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete)
-		{
-			if (__DMA2_Stream0_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-			{
-				__DMA2_Stream0_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CHTIF0;
-
-				if(__DMA2_Stream0_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA2_Stream0_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA2_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA2_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF0)
-	{
-		if(__DMA2_Stream0_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Complete)
-		{
-			if (__DMA2_Stream0_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-			{
-				__DMA2_Stream0_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CTCIF0;
-
-				if(__DMA2_Stream0_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA2_Stream0_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA2_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA2_Stream0_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-
-	}
-}
-
-void DMA2_Stream1_IRQHandler(void)
-{
-	DMA_LISR = DMA2 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF1)
-	{
-		if (__DMA2_Stream1_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA2_Stream1_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CFEIF1;
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF1)
-	{
-		if (__DMA2_Stream1_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA2_Stream1_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CDMEIF1;
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF1)
-	{
-		if (__DMA2_Stream1_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA2_Stream1_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CTEIF1;
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF1)
-	{
-		if (__DMA2_Stream1_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA2_Stream1_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CHTIF1;
-
-			if(__DMA2_Stream1_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream1_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF1)
-	{
-		if (__DMA2_Stream1_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA2_Stream1_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CTCIF1;
-
-			if(__DMA2_Stream1_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream1_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream1_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
-
-
-void DMA2_Stream2_IRQHandler(void)
-{
-	DMA_LISR = DMA2 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF2)
-	{
-		if (__DMA2_Stream2_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA2_Stream2_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CFEIF2;
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF2)
-	{
-		if (__DMA2_Stream2_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA2_Stream2_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CDMEIF2;
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TEIF2)
-	{
-		if (__DMA2_Stream2_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA2_Stream2_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CTEIF2;
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_HTIF2)
-	{
-		if (__DMA2_Stream2_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA2_Stream2_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CHTIF2;
-
-			if(__DMA2_Stream2_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream2_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_TCIF2)
-	{
-		if (__DMA2_Stream2_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA2_Stream2_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA2 -> LIFCR |= DMA_LIFCR_CTCIF2;
-
-			if(__DMA2_Stream2_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream2_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream2_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
-
-void DMA2_Stream3_IRQHandler(void)
-{
-	DMA_LISR = DMA2 -> LISR;
-
-	if(DMA_LISR & DMA_LISR_FEIF3)
-	{
-		if(__DMA2_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Fifo_Error)
-		{
-			if (__DMA2_Stream3_Config__ -> ISR_Routines.FIFO_Error_ISR)
-			{
-				__DMA2_Stream3_Config__ ->ISR_Routines.FIFO_Error_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CFEIF3;
-			}
-		}
-	}
-
-	if(DMA_LISR & DMA_LISR_DMEIF3)
-	{
-		if(__DMA2_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Direct_Mode_Error)
-		{
-			if (__DMA2_Stream3_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-			{
-				__DMA2_Stream3_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CDMEIF3;
-			}
-		}
-	}
+static DMA_Config *dma_stream_config[DMA_STREAMS];
 
-	if(DMA_LISR & DMA_LISR_TEIF3)
-	{
-		if(__DMA2_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Error)
-		{
-			if (__DMA2_Stream3_Config__ -> ISR_Routines.Transfer_Error_ISR)
-			{
-				__DMA2_Stream3_Config__ ->ISR_Routines.Transfer_Error_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CTEIF3;
-			}
-		}
-	}
+// Streams owned by a peripheral (DMA_Init) or by a running copy, bit per stream index
+static volatile uint16_t dma_stream_taken;
 
-	if(DMA_LISR & DMA_LISR_HTIF3)
-	{
-		if(__DMA2_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete)
-		{
-			if (__DMA2_Stream3_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-			{
-				__DMA2_Stream3_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CHTIF3;
-
-				if(__DMA2_Stream3_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA2_Stream3_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA2_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA2_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
+// Position of a stream's flags in LISR/HISR and LIFCR/HIFCR, for streams 0 - 3 and 4 - 7 alike
+static const uint8_t dma_flag_shift[4] = {0, 6, 16, 22};
 
-	}
+static const IRQn_Type dma_stream_irq[DMA_STREAMS] = {
+	DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+	DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn,
+	DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+	DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn,
+};
 
-	if(DMA_LISR & DMA_LISR_TCIF3)
-	{
-		if(__DMA2_Stream3_Config__->interrupts & DMA_Configuration.DMA_Interrupts.Transfer_Complete)
-		{
-			if (__DMA2_Stream3_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-			{
-				__DMA2_Stream3_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-				DMA2 -> LIFCR |= DMA_LIFCR_CTCIF3;
-
-				if(__DMA2_Stream3_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-				{
-					if((__DMA2_Stream3_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-					{
-						__DMA2_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-					}
-					else
-					{
-						__DMA2_Stream3_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-					}
-				}
-			}
-		}
-	}
+// 0 - 15, or -1 if stream does not belong to controller
+static int8_t DMA_Stream_Index(DMA_TypeDef *controller, DMA_Stream_TypeDef *stream)
+{
+	if ((controller == DMA1) && (stream >= DMA1_Stream0) && (stream <= DMA1_Stream7)) return (int8_t)(stream - DMA1_Stream0);
+	if ((controller == DMA2) && (stream >= DMA2_Stream0) && (stream <= DMA2_Stream7)) return (int8_t)(8 + (stream - DMA2_Stream0));
+	return -1;
 }
 
-void DMA2_Stream4_IRQHandler(void)
+// Clears the given flags of one stream; the clear registers are write-one-to-clear, other streams are left alone
+static void DMA_Clear_Flags(DMA_TypeDef *controller, uint8_t index, uint32_t flags)
 {
-	DMA_HISR = DMA2 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF4)
-	{
-		if (__DMA2_Stream4_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA2_Stream4_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA2 -> LIFCR |= DMA_HIFCR_CFEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF4)
-	{
-		if (__DMA2_Stream4_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA2_Stream4_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CDMEIF4;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF4)
-	{
-		if (__DMA2_Stream4_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA2_Stream4_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTEIF4;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_HTIF4)
-	{
-		if (__DMA2_Stream4_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA2_Stream4_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CHTIF4;
-
-			if(__DMA2_Stream4_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream4_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
+	uint32_t clear = (flags & DMA_STREAM_FLAGS) << dma_flag_shift[index & 3U];
 
-	if(DMA_HISR & DMA_HISR_TCIF4)
-	{
-		if (__DMA2_Stream4_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA2_Stream4_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTCIF4;
-
-			if(__DMA2_Stream4_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream4_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream4_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
+	if ((index & 4U) == 0U) controller->LIFCR = clear;
+	else controller->HIFCR = clear;
 }
 
+/*
+ * Memory to memory jobs, one per DMA2 stream (DMA1 cannot do memory to
+ * memory). Lengths over one NDTR load are programmed in chunks from the
+ * transfer complete interrupt.
+ */
+#define DMA_COPY_CHUNK_ITEMS     65532U     // NDTR limit rounded down to whole INCR4 bursts
 
-
-
-void DMA2_Stream5_IRQHandler(void)
+typedef struct DMA_Copy_Job
 {
-	DMA_HISR = DMA2 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF5)
-	{
-		if (__DMA2_Stream5_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA2_Stream5_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CFEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF5)
-	{
-		if (__DMA2_Stream5_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA2_Stream5_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CDMEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF5)
-	{
-		if (__DMA2_Stream5_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA2_Stream5_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTEIF5;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_HTIF5)
-	{
-		if (__DMA2_Stream5_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA2_Stream5_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CHTIF5;
-
-			if(__DMA2_Stream5_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream5_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TCIF5)
-	{
-		if (__DMA2_Stream5_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA2_Stream5_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTCIF5;
-
-			if(__DMA2_Stream5_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream5_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream5_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
+	uint32_t source;
+	uint32_t destination;
+	uint32_t remaining;                     // bytes not yet programmed
+	uint32_t pattern;                       // fill value, read in place by the stream
+	uint32_t cr;                            // CR of every chunk, EN clear
+	uint32_t fcr;
+	uint8_t size_shift;                     // log2 of the item size
+	void (*complete)(void *context);
+	void *context;
+}DMA_Copy_Job;
+
+static DMA_Copy_Job dma_copy_job[8];
+
+static void DMA_Copy_IRQ(uint8_t number, uint32_t flags);
+
+// FEIF, DMEIF, TEIF, HTIF and TCIF of one stream, moved down to bit 0
+static uint32_t DMA_Stream_Flags(DMA_TypeDef *controller, uint8_t index)
+{
+	uint32_t status = ((index & 4U) == 0U) ? controller->LISR : controller->HISR;
+	return (status >> dma_flag_shift[index & 3U]) & DMA_STREAM_FLAGS;
 }
 
-
-
-void DMA2_Stream6_IRQHandler(void)
+/*
+ * One pass per interrupt: read the stream's flags once, clear them before
+ * the callbacks so a callback may restart the stream, then call back for
+ * the flags whose interrupt the stream has enabled. TCIE, HTIE, TEIE and
+ * DMEIE sit one bit below their flags in CR, FEIE is in FCR.
+ */
+static void DMA_Stream_IRQ(uint8_t index)
 {
-	DMA_HISR = DMA2 -> HISR;
-
-	if(DMA_HISR & DMA_HISR_FEIF6)
-	{
-		if (__DMA2_Stream6_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA2_Stream6_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CFEIF6;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_DMEIF6)
-	{
-		if (__DMA2_Stream6_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA2_Stream6_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CDMEIF6;
-		}
-	}
-
-	if(DMA_HISR & DMA_HISR_TEIF6)
-	{
-		if (__DMA2_Stream6_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA2_Stream6_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTEIF6;
-		}
-	}
+	DMA_TypeDef *controller = (index < 8U) ? DMA1 : DMA2;
+	uint32_t flags = DMA_Stream_Flags(controller, index);
 
-	if(DMA_HISR & DMA_HISR_HTIF6)
-	{
-		if (__DMA2_Stream6_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA2_Stream6_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CHTIF6;
-
-			if(__DMA2_Stream6_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream6_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
+	DMA_Clear_Flags(controller, index, flags);
 
-	if(DMA_HISR & DMA_HISR_TCIF6)
-	{
-		if (__DMA2_Stream6_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA2_Stream6_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTCIF6;
-
-			if(__DMA2_Stream6_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream6_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream6_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
+	DMA_Config *config = dma_stream_config[index];
+	if (config == NULL) {
+		if (index >= 8U) DMA_Copy_IRQ(index - 8U, flags);
+		return;
 	}
-}
-
 
-void DMA2_Stream7_IRQHandler(void)
-{
-	DMA_HISR = DMA2 -> HISR;
+	DMA_Stream_TypeDef *stream = config->Request.Stream;
+	uint32_t enabled = ((stream->CR & (DMA_SxCR_TCIE | DMA_SxCR_HTIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE)) << 1);
+	if (stream->FCR & DMA_SxFCR_FEIE) enabled |= DMA_LISR_FEIF0;
+	flags &= enabled;
 
-	if(DMA_HISR & DMA_HISR_FEIF7)
-	{
-		if (__DMA2_Stream7_Config__ -> ISR_Routines.FIFO_Error_ISR)
-		{
-			__DMA2_Stream7_Config__ ->ISR_Routines.FIFO_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CFEIF7;
-		}
-	}
+	if ((flags & DMA_LISR_FEIF0) && config->ISR_Routines.FIFO_Error_ISR) config->ISR_Routines.FIFO_Error_ISR();
+	if ((flags & DMA_LISR_DMEIF0) && config->ISR_Routines.Direct_Mode_Error_ISR) config->ISR_Routines.Direct_Mode_Error_ISR();
+	if ((flags & DMA_LISR_TEIF0) && config->ISR_Routines.Transfer_Error_ISR) config->ISR_Routines.Transfer_Error_ISR();
 
-	if(DMA_HISR & DMA_HISR_DMEIF7)
-	{
-		if (__DMA2_Stream7_Config__ -> ISR_Routines.Direct_Mode_Error_ISR)
-		{
-			__DMA2_Stream7_Config__ ->ISR_Routines.Direct_Mode_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CDMEIF7;
-		}
-	}
+	if ((flags & DMA_LISR_HTIF0) && config->ISR_Routines.Half_Transfer_Complete_ISR) config->ISR_Routines.Half_Transfer_Complete_ISR();
+	if ((flags & DMA_LISR_TCIF0) && config->ISR_Routines.Full_Transfer_Commplete_ISR) config->ISR_Routines.Full_Transfer_Commplete_ISR();
 
-	if(DMA_HISR & DMA_HISR_TEIF7)
-	{
-		if (__DMA2_Stream7_Config__ -> ISR_Routines.Transfer_Error_ISR)
-		{
-			__DMA2_Stream7_Config__ ->ISR_Routines.Transfer_Error_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTEIF7;
+	// In double buffer mode CT names the target now in use, so the other one has just been filled
+	if ((flags & (DMA_LISR_HTIF0 | DMA_LISR_TCIF0)) && (config->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable)) {
+		if (stream->CR & DMA_SxCR_CT) {
+			if (config->ISR_Routines.Double_Buffer_Mode_Target_1_ISR) config->ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
+		} else {
+			if (config->ISR_Routines.Double_Buffer_Mode_Target_2_ISR) config->ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
 		}
 	}
+}
 
-	if(DMA_HISR & DMA_HISR_HTIF7)
-	{
-		if (__DMA2_Stream7_Config__ -> ISR_Routines.Half_Transfer_Complete_ISR)
-		{
-			__DMA2_Stream7_Config__ ->ISR_Routines.Half_Transfer_Complete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CHTIF7;
-
-			if(__DMA2_Stream7_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream7_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
+void DMA1_Stream0_IRQHandler(void) { DMA_Stream_IRQ(0); }
+void DMA1_Stream1_IRQHandler(void) { DMA_Stream_IRQ(1); }
+void DMA1_Stream2_IRQHandler(void) { DMA_Stream_IRQ(2); }
+void DMA1_Stream3_IRQHandler(void) { DMA_Stream_IRQ(3); }
+void DMA1_Stream4_IRQHandler(void) { DMA_Stream_IRQ(4); }
+void DMA1_Stream5_IRQHandler(void) { DMA_Stream_IRQ(5); }
+void DMA1_Stream6_IRQHandler(void) { DMA_Stream_IRQ(6); }
+void DMA1_Stream7_IRQHandler(void) { DMA_Stream_IRQ(7); }
+void DMA2_Stream0_IRQHandler(void) { DMA_Stream_IRQ(8); }
+void DMA2_Stream1_IRQHandler(void) { DMA_Stream_IRQ(9); }
+void DMA2_Stream2_IRQHandler(void) { DMA_Stream_IRQ(10); }
+void DMA2_Stream3_IRQHandler(void) { DMA_Stream_IRQ(11); }
+void DMA2_Stream4_IRQHandler(void) { DMA_Stream_IRQ(12); }
+void DMA2_Stream5_IRQHandler(void) { DMA_Stream_IRQ(13); }
+void DMA2_Stream6_IRQHandler(void) { DMA_Stream_IRQ(14); }
+void DMA2_Stream7_IRQHandler(void) { DMA_Stream_IRQ(15); }
 
-	if(DMA_HISR & DMA_HISR_TCIF7)
-	{
-		if (__DMA2_Stream7_Config__ -> ISR_Routines.Full_Transfer_Commplete_ISR)
-		{
-			__DMA2_Stream7_Config__ ->ISR_Routines.Full_Transfer_Commplete_ISR();
-			DMA2 -> HIFCR |= DMA_HIFCR_CTCIF7;
-
-			if(__DMA2_Stream7_Config__->double_buffer_mode == DMA_Configuration.Double_Buffer_Mode.Enable )
-			{
-				if((__DMA2_Stream7_Config__->Request.Stream->CR & DMA_SxCR_DBM_Msk) != 0)
-				{
-					__DMA2_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_1_ISR();
-				}
-				else
-				{
-					__DMA2_Stream7_Config__ -> ISR_Routines.Double_Buffer_Mode_Target_2_ISR();
-				}
-			}
-		}
-	}
-}
 
 
 
@@ -1413,6 +217,15 @@ void DMA_Reset(DMA_Config *config)
  */
 int8_t DMA_Init(DMA_Config *config)
 {
+	int8_t index = DMA_Stream_Index(config->Request.Controller, config->Request.Stream);
+	if (index < 0) return -1;
+
+	// Keep the copy allocator off this stream
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	dma_stream_taken |= 1U << index;
+	__set_PRIMASK(primask);
+
 	//	DMA_Clock_Disable(config);
 	DMA_Clock_Enable(config);  // Enable the clock for the specified DMA controller
 
@@ -1462,78 +275,8 @@ int8_t DMA_Init(DMA_Config *config)
 		}
 
 		// Enable the corresponding NVIC interrupt for the DMA stream
-		if(config->Request.Controller == DMA1)
-		{
-			if(config->Request.Stream == DMA1_Stream0){
-				__DMA1_Stream0_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream0_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream1){
-				__DMA1_Stream1_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream1_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream2){
-				__DMA1_Stream2_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream2_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream3){
-				__DMA1_Stream3_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream3_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream4){
-				__DMA1_Stream4_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream4_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream5){
-				__DMA1_Stream5_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream5_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream6) {
-				__DMA1_Stream6_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream6_IRQn);
-			}
-			else if(config->Request.Stream == DMA1_Stream7){
-				__DMA1_Stream7_Config__ = config;
-				NVIC_EnableIRQ(DMA1_Stream7_IRQn);
-			}
-		}
-		else if(config->Request.Controller == DMA2)
-		{
-			if(config->Request.Stream == DMA2_Stream0){
-				__DMA2_Stream0_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream0_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream1){
-				__DMA2_Stream1_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream1_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream2){
-				__DMA2_Stream2_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream2_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream3){
-				__DMA2_Stream3_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream3_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream4){
-				__DMA2_Stream4_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream4_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream5){
-				__DMA2_Stream5_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream5_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream6){
-				__DMA2_Stream6_Config__ = config;
-				NVIC_EnableIRQ(DMA2_Stream6_IRQn);
-			}
-			else if(config->Request.Stream == DMA2_Stream7){
-				__DMA2_Stream7_Config__ = config;
-				//            	NVIC_SetPriority(DMA2_Stream7_IRQn,0);
-				NVIC_EnableIRQ(DMA2_Stream7_IRQn);
-
-			}
-		}
+		dma_stream_config[index] = config;
+		NVIC_EnableIRQ(dma_stream_irq[index]);
 	}
 
 	// Configure memory and peripheral pointer increments
@@ -1620,47 +363,191 @@ void DMA_Set_Target(DMA_Config *config)
  */
 void DMA_Set_Trigger(DMA_Config *config)
 {
-	// Bit shift values for streams 0 to 7
-	static const uint8_t LIFCR_Shifts[4] = {0, 6, 16, 22};
-	static const uint8_t HIFCR_Shifts[4] = {0, 6, 16, 22};
+	int8_t index = DMA_Stream_Index(config->Request.Controller, config->Request.Stream);
+	if (index < 0) return;
+
+	DMA_Clear_Flags(config->Request.Controller, (uint8_t)index, DMA_STREAM_FLAGS);  // Clear interrupt flags for the stream
+	config->Request.Stream->CR |= DMA_SxCR_EN;  // Enable the DMA stream
+}
 
+void DMA_Disable_Target(DMA_Config *config)
+{
 	DMA_TypeDef *controller = config->Request.Controller;
 	DMA_Stream_TypeDef *stream = config->Request.Stream;
-	uint32_t shift;
+	stream->CR &= ~DMA_SxCR_EN;  // Disable the DMA stream
+}
 
-	if (controller == DMA1 || controller == DMA2)
-	{
-		// Determine the correct shift value and clear the corresponding flags in LIFCR or HIFCR
-		if (stream >= DMA1_Stream0 && stream <= DMA1_Stream3)
-		{
-			shift = LIFCR_Shifts[stream - DMA1_Stream0];
-			controller->LIFCR |= 0x3F << shift;  // Clear interrupt flags for the stream
-		}
-		else if (stream >= DMA1_Stream4 && stream <= DMA1_Stream7)
-		{
-			shift = HIFCR_Shifts[stream - DMA1_Stream4];
-			controller->HIFCR |= 0x3F << shift;  // Clear interrupt flags for the stream
-		}
-		else if (stream >= DMA2_Stream0 && stream <= DMA2_Stream3)
-		{
-			shift = LIFCR_Shifts[stream - DMA2_Stream0];
-			controller->LIFCR |= 0x3F << shift;  // Clear interrupt flags for the stream
-		}
-		else if (stream >= DMA2_Stream4 && stream <= DMA2_Stream7)
-		{
-			shift = HIFCR_Shifts[stream - DMA2_Stream4];
-			controller->HIFCR |= 0x3F << shift;  // Clear interrupt flags for the stream
+
+/**
+ * @brief Claims a DMA2 stream that no peripheral uses for a memory-to-memory transfer.
+ *
+ * Streams set up by DMA_Init() are never handed out. The DMA2 clock is
+ * enabled. Safe from interrupts.
+ *
+ * @return int8_t DMA2 stream number 0 - 7, or -1 if all are in use.
+ */
+int8_t DMA_Stream_Claim(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for (uint8_t number = 0; number < 8U; number++) {
+		uint16_t bit = 1U << (8U + number);
+		if ((dma_stream_taken & bit) == 0U) {
+			dma_stream_taken |= bit;
+			__set_PRIMASK(primask);
+
+			RCC -> AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+			return (int8_t)number;
 		}
+	}
+
+	__set_PRIMASK(primask);
+	return -1;
+}
+
+/**
+ * @brief Returns a stream from DMA_Stream_Claim(), which must be disabled by then.
+ *
+ * @param[in] number DMA2 stream number 0 - 7.
+ */
+void DMA_Stream_Release(int8_t number)
+{
+	if ((number < 0) || (number > 7)) return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	dma_stream_taken &= ~(1U << (8U + number));
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Tells whether a DMA controller can reach the buffer; they have no path to CCM RAM.
+ *
+ * @param[in] address Start of the buffer.
+ * @param[in] length Number of bytes.
+ *
+ * @return bool true if the buffer lies wholly outside CCM RAM.
+ */
+bool DMA_Reachable(const volatile void *address, uint32_t length)
+{
+	uint32_t start = (uint32_t)address;
+	return !((start <= CCMDATARAM_END) && ((start + length) > CCMDATARAM_BASE));
+}
+
+// Programs the next chunk of a job; the stream is disabled
+static void DMA_Copy_Next(uint8_t number)
+{
+	DMA_Copy_Job *job = &dma_copy_job[number];
+	DMA_Stream_TypeDef *stream = DMA2_Stream0 + number;
+
+	uint32_t items = job->remaining >> job->size_shift;
+	if (items > DMA_COPY_CHUNK_ITEMS) items = DMA_COPY_CHUNK_ITEMS;
+	uint32_t bytes = items << job->size_shift;
 
-		stream->CR |= DMA_SxCR_EN;  // Enable the DMA stream
+	stream->CR = job->cr;
+	stream->FCR = job->fcr;
+	stream->PAR = job->source;
+	stream->M0AR = job->destination;
+	stream->NDTR = items;
+
+	job->remaining -= bytes;
+	job->destination += bytes;
+	if (job->cr & DMA_SxCR_PINC) job->source += bytes;
+
+	DMA_Clear_Flags(DMA2, 8U + number, DMA_STREAM_FLAGS);
+	stream->CR = job->cr | DMA_SxCR_EN;
+}
+
+// Transfer complete or error on a copy stream: next chunk, or release the stream and call back
+static void DMA_Copy_IRQ(uint8_t number, uint32_t flags)
+{
+	DMA_Copy_Job *job = &dma_copy_job[number];
+
+	if ((flags & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0)) == 0U) return;
+
+	if (((flags & DMA_LISR_TEIF0) == 0U) && (job->remaining != 0U)) {
+		DMA_Copy_Next(number);
+		return;
 	}
+
+	// A transfer error ends the job early, the stream has already disabled itself
+	(DMA2_Stream0 + number)->CR = 0;
+
+	void (*complete)(void *context) = job->complete;
+	void *context = job->context;
+	DMA_Stream_Release((int8_t)number);
+
+	if (complete != NULL) complete(context);
 }
 
-void DMA_Disable_Target(DMA_Config *config)
+/*
+ * Item size from the alignment of everything that moves. INCR4 bursts with
+ * a full FIFO only when whole 16-byte blocks of words move, which also
+ * keeps every burst inside a 1 KB boundary. A fill reads its pattern in
+ * place from the job, one word at a time.
+ */
+static int8_t DMA_Job_Start(uint32_t destination, uint32_t source, bool source_increment, uint32_t pattern, uint32_t length,
+		void (*complete)(void *context), void *context)
 {
-	DMA_TypeDef *controller = config->Request.Controller;
-	DMA_Stream_TypeDef *stream = config->Request.Stream;
-	stream->CR &= ~DMA_SxCR_EN;  // Disable the DMA stream
+	if (length == 0U) return -1;
+	if (!DMA_Reachable((const volatile void *)destination, length)) return -1;
+	if (source_increment && !DMA_Reachable((const volatile void *)source, length)) return -1;
+
+	int8_t number = DMA_Stream_Claim();
+	if (number < 0) return -1;
+
+	DMA_Copy_Job *job = &dma_copy_job[number];
+	uint32_t align = destination | length | (source_increment ? source : 0U);
+
+	job->pattern = pattern;
+	job->size_shift = ((align & 3U) == 0U) ? 2U : (((align & 1U) == 0U) ? 1U : 0U);
+	job->source = source_increment ? source : (uint32_t)&job->pattern;
+	job->destination = destination;
+	job->remaining = length;
+	job->complete = complete;
+	job->context = context;
+
+	job->cr = DMA_Configuration.Transfer_Direction.Memory_to_memory | DMA_SxCR_MINC | DMA_SxCR_PL_1
+			| ((uint32_t)job->size_shift << DMA_SxCR_PSIZE_Pos) | ((uint32_t)job->size_shift << DMA_SxCR_MSIZE_Pos)
+			| DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+	if (source_increment) job->cr |= DMA_SxCR_PINC;
+	job->fcr = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_0;
+
+	if ((align & 0xFU) == 0U) {
+		job->cr |= DMA_SxCR_MBURST_0;
+		if (source_increment) job->cr |= DMA_SxCR_PBURST_0;
+		job->fcr = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH;
+	}
+
+	NVIC_EnableIRQ(dma_stream_irq[8U + number]);
+	DMA_Copy_Next((uint8_t)number);
+	return number;
+}
+
+/**
+ * @brief Starts copying length bytes on a free DMA2 stream and returns at once.
+ *
+ * Any length is accepted, over 65532 items the transfer is chained from
+ * the transfer complete interrupt. complete(context) runs in that interrupt
+ * when the last byte has arrived, or early after a bus error. Neither
+ * buffer may be touched until then.
+ *
+ * @return int8_t The DMA2 stream used, or -1 if no stream is free, length is 0 or a buffer is in CCM RAM; copy by CPU then.
+ */
+int8_t DMA_Copy_Start(volatile void *destination, const volatile void *source, uint32_t length,
+		void (*complete)(void *context), void *context)
+{
+	return DMA_Job_Start((uint32_t)destination, (uint32_t)source, true, 0U, length, complete, context);
+}
+
+/**
+ * @brief Starts filling length bytes with value on a free DMA2 stream, like DMA_Copy_Start().
+ */
+int8_t DMA_Fill_Start(volatile void *destination, uint8_t value, uint32_t length,
+		void (*complete)(void *context), void *context)
+{
+	return DMA_Job_Start((uint32_t)destination, 0U, false, value * 0x01010101U, length, complete, context);
 }
 
 
@@ -1672,6 +559,7 @@ void DMA_Disable_Target(DMA_Config *config)
  * location to a destination memory location. It sets up the data size,
  * increment modes, and the length of the transfer. The function enables the
  * DMA stream, waits for the transfer to complete, and then disables the stream.
+ * When every DMA2 stream is claimed the core copies the items instead.
  *
  * @param[in] source Pointer to the source memory location.
  * @param[in] source_data_size Size of the data at the source (8, 16, or 32 bits).
@@ -1686,99 +574,103 @@ void DMA_Disable_Target(DMA_Config *config)
 //		volatile void *destination, bool source_increment,
 //		bool destination_increment, uint16_t length)
 
-void DMA_Memory_To_Memory_Transfer(volatile void *source,
+// Polled transfer on DMA2 stream number; touches no RAM, so it also works from any interrupt priority
+static void DMA_Stream_Transfer(uint8_t number, volatile void *source,
 		uint8_t source_data_size, bool source_increment,
 		volatile void *destination, uint8_t dest_data_size,
 		bool destination_increment, uint16_t length)
 {
-	// Enable DMA2 clock
-	RCC -> AHB1ENR |= RCC_AHB1ENR_DMA2EN;
-
-	// Clear the channel selection and set the transfer direction to memory-to-memory
-	DMA2_Stream0->CR &= (DMA_SxCR_CHSEL);
-	DMA2_Stream0->CR |= DMA_Configuration.Transfer_Direction.Memory_to_memory;
-
-	// Set the transfer complete interrupt and priority level
-	DMA2_Stream0->CR |= (DMA_SxCR_TCIE | DMA_SxCR_PL);
+	DMA_Stream_TypeDef *stream = DMA2_Stream0 + number;
+	uint8_t index = 8U + number;
+
+	// Built once and written once
+	uint32_t cr = DMA_Configuration.Transfer_Direction.Memory_to_memory | DMA_SxCR_PL;
+	cr |= (source_data_size == 32) ? DMA_SxCR_PSIZE_1 : ((source_data_size == 16) ? DMA_SxCR_PSIZE_0 : 0U);
+	cr |= (dest_data_size == 32) ? DMA_SxCR_MSIZE_1 : ((dest_data_size == 16) ? DMA_SxCR_MSIZE_0 : 0U);
+	if (source_increment) cr |= DMA_SxCR_PINC;
+	if (destination_increment) cr |= DMA_SxCR_MINC;
+
+	stream->CR = cr;
+	stream->FCR = DMA_SxFCR_DMDIS;
+	stream->PAR = (uint32_t)(source);
+	stream->M0AR = (uint32_t)(destination);
+	stream->NDTR = length;
+
+	DMA_Clear_Flags(DMA2, index, DMA_STREAM_FLAGS);
+	stream->CR = cr | DMA_SxCR_EN;
+
+	// Wait for the transfer to complete, or to stop on a bus error
+	while ((DMA_Stream_Flags(DMA2, index) & (DMA_LISR_TCIF0 | DMA_LISR_TEIF0)) == 0U) {}
+
+	DMA_Clear_Flags(DMA2, index, DMA_STREAM_FLAGS);
+	stream->CR = 0;
+}
 
-	// Set the peripheral data size based on the source data size
-	if(source_data_size == 32)
-	{
-		DMA2_Stream0->CR |= DMA_SxCR_PSIZE;
-	}
-	else if(source_data_size == 16)
-	{
-		DMA2_Stream0->CR |= DMA_SxCR_PSIZE_0;
-		DMA2_Stream0->CR &= ~DMA_SxCR_PSIZE_1;
-	}
-	else
-	{
-		DMA2_Stream0->CR &= ~DMA_SxCR_PSIZE;
-	}
+// Same items as DMA_Stream_Transfer() moved by the core, for when every stream is busy
+static void DMA_CPU_Transfer(volatile void *source,
+		uint8_t source_data_size, bool source_increment,
+		volatile void *destination, uint8_t dest_data_size,
+		bool destination_increment, uint16_t length)
+{
+	if (source_data_size == dest_data_size) {
+		uint32_t size = source_data_size / 8U;
+		uint32_t src = (uint32_t)source;
+		uint32_t dst = (uint32_t)destination;
 
-	// Set the memory data size based on the destination data size
-	if(dest_data_size == 32)
-	{
-		DMA2_Stream0->CR |= DMA_SxCR_MSIZE;
-	}
-	else if(dest_data_size == 16)
-	{
-		DMA2_Stream0->CR |= DMA_SxCR_MSIZE_0;
-		DMA2_Stream0->CR &= ~DMA_SxCR_MSIZE_1;
-	}
-	else
-	{
-		DMA2_Stream0->CR &= ~DMA_SxCR_MSIZE;
+		for (uint16_t i = 0; i < length; i++) {
+			if (size == 4U) *(volatile uint32_t *)dst = *(volatile uint32_t *)src;
+			else if (size == 2U) *(volatile uint16_t *)dst = *(volatile uint16_t *)src;
+			else *(volatile uint8_t *)dst = *(volatile uint8_t *)src;
+			if (source_increment) src += size;
+			if (destination_increment) dst += size;
+		}
+		return;
 	}
 
-	// Configure source address increment mode
-	if(source_increment)
-	{
-		DMA2_Stream0->CR |= DMA_SxCR_PINC;
-	}
-	else
-	{
-		DMA2_Stream0->CR &= ~DMA_SxCR_PINC;
-	}
+	// Packing between item sizes: byte by byte, a fixed address repeats its one item
+	uint32_t source_size = source_data_size / 8U;
+	uint32_t dest_size = dest_data_size / 8U;
+	volatile uint8_t *src = source;
+	volatile uint8_t *dst = destination;
 
-	// Configure destination address increment mode
-	if(destination_increment)
-	{
-		DMA2_Stream0->CR |= DMA_SxCR_MINC;
+	for (uint32_t i = 0; i < (uint32_t)length * source_size; i++) {
+		dst[destination_increment ? i : (i % dest_size)] = src[source_increment ? i : (i % source_size)];
 	}
-	else
-	{
-		DMA2_Stream0->CR &= ~DMA_SxCR_MINC;
-	}
-
-	DMA2_Stream0->FCR |= DMA_SxFCR_DMDIS;
-
-	// Set the peripheral address (source)
-	DMA2_Stream0->PAR = (uint32_t)(source);
-
-	// Set the memory address (destination)
-	DMA2_Stream0->M0AR = (uint32_t)(destination);
-
-	// Set the number of data items to transfer
-	DMA2_Stream0->NDTR = (uint16_t)length;
-
-	// Enable the DMA stream
-	DMA2_Stream0->CR |= DMA_SxCR_EN;
+}
 
-	// Wait for the transfer to complete
-	while((DMA2->LISR & (DMA_LISR_TCIF0_Msk)) == 0) {}
+void DMA_Memory_To_Memory_Transfer(volatile void *source,
+		uint8_t source_data_size, bool source_increment,
+		volatile void *destination, uint8_t dest_data_size,
+		bool destination_increment, uint16_t length)
+{
+	if (length == 0U) return;
 
-	// Clear the transfer complete flag
-	DMA2->LIFCR |= DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0;
+	// Another caller, an interrupt included, may hold every stream; waiting could be for an interrupt we preempted
+	int8_t number = DMA_Stream_Claim();
+	if (number < 0) {
+		DMA_CPU_Transfer(source, source_data_size, source_increment, destination, dest_data_size, destination_increment, length);
+		return;
+	}
 
-	// Disable the DMA stream
+	DMA_Stream_Transfer((uint8_t)number, source, source_data_size, source_increment,
+			destination, dest_data_size, destination_increment, length);
+	DMA_Stream_Release(number);
+}
 
-	DMA2_Stream0->CR = 0;
-	DMA2_Stream0->FCR = 0;
-	DMA2_Stream0->M0AR = 0;
-	DMA2_Stream0->M1AR = 0;
-	DMA2_Stream0->NDTR= 0;
-	DMA2_Stream0->PAR = 0;
+/**
+ * @brief DMA_Memory_To_Memory_Transfer() on DMA2 Stream0 without claiming it.
+ *
+ * Keeps no state in RAM, for the bootloader service table: the caller's RAM
+ * is not the bootloader's. The caller must not be using DMA2 Stream0.
+ */
+void DMA_Fixed_Stream_Transfer(volatile void *source,
+		uint8_t source_data_size, bool source_increment,
+		volatile void *destination, uint8_t dest_data_size,
+		bool destination_increment, uint16_t length)
+{
+	if (length == 0U) return;
 
-	DMA2_Stream0->CR &= ~DMA_SxCR_EN;
+	RCC -> AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+	DMA_Stream_Transfer(0U, source, source_data_size, source_increment,
+			destination, dest_data_size, destination_increment, length);
 }
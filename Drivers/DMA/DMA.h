@@ -47,6 +47,8 @@
  * - `void DMA_Set_Target(DMA_Config *config)`: Configures the target memory and peripheral for DMA transfers.
  * - `void DMA_Set_Trigger(DMA_Config *config)`: Sets up and enables the DMA stream for data transfer.
  * - `void DMA_Memory_To_Memory_Transfer(uint32_t *source, uint8_t source_data_size, uint8_t dest_data_size, uint32_t *destination, bool source_increment, bool destination_increment, uint16_t length)`: Performs a memory-to-memory data transfer using DMA.
+ * - `int8_t DMA_Stream_Claim(void)` / `void DMA_Stream_Release(int8_t number)`: Hands out DMA2 streams no peripheral uses.
+ * - `int8_t DMA_Copy_Start(...)` / `int8_t DMA_Fill_Start(...)`: Asynchronous memory copy and fill with a completion callback.
  *
  * @section usage_sec Usage
  *
@@ -211,7 +213,64 @@ void DMA_Memory_To_Memory_Transfer(volatile void *source,
 		volatile void *destination, uint8_t dest_data_size,
 		bool destination_increment, uint16_t length);
 
+/**
+ * @brief DMA_Memory_To_Memory_Transfer() on DMA2 Stream0 without claiming it, keeps no state in RAM.
+ */
+void DMA_Fixed_Stream_Transfer(volatile void *source,
+		uint8_t source_data_size, bool source_increment,
+		volatile void *destination, uint8_t dest_data_size,
+		bool destination_increment, uint16_t length);
+
 
 void DMA_Disable_Target(DMA_Config *config);
 
+/**
+ * @brief Claims a DMA2 stream that no peripheral uses for a memory-to-memory transfer.
+ *
+ * @return int8_t DMA2 stream number 0 - 7, or -1 if all are in use.
+ */
+int8_t DMA_Stream_Claim(void);
+
+/**
+ * @brief Returns a stream from DMA_Stream_Claim(), which must be disabled by then.
+ *
+ * @param[in] number DMA2 stream number 0 - 7.
+ */
+void DMA_Stream_Release(int8_t number);
+
+/**
+ * @brief Tells whether a DMA controller can reach the buffer; they have no path to CCM RAM.
+ *
+ * @param[in] address Start of the buffer.
+ * @param[in] length Number of bytes.
+ *
+ * @return bool true if the buffer lies wholly outside CCM RAM.
+ */
+bool DMA_Reachable(const volatile void *address, uint32_t length);
+
+/**
+ * @brief Starts copying length bytes on a free DMA2 stream and returns at once.
+ *
+ * Word, half-word or byte items and INCR4 bursts are chosen from the
+ * alignment; lengths over one NDTR load are chained. complete(context) is
+ * called from the DMA interrupt when done, or early after a bus error.
+ * The DMA cannot reach CCM RAM.
+ *
+ * @param[out] destination Destination buffer, untouched by the caller until complete.
+ * @param[in] source Source buffer, unchanged until complete.
+ * @param[in] length Number of bytes.
+ * @param[in] complete Called when done, may be NULL.
+ * @param[in] context Passed to complete.
+ *
+ * @return int8_t The DMA2 stream used, or -1 if none is free, length is 0 or a buffer is in CCM RAM.
+ */
+int8_t DMA_Copy_Start(volatile void *destination, const volatile void *source, uint32_t length,
+		void (*complete)(void *context), void *context);
+
+/**
+ * @brief Starts filling length bytes with value on a free DMA2 stream, like DMA_Copy_Start().
+ */
+int8_t DMA_Fill_Start(volatile void *destination, uint8_t value, uint32_t length,
+		void (*complete)(void *context), void *context);
+
 #endif /* DMA_H_ */
@@ -0,0 +1,158 @@
+/*
+ * Debug_Comm.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "Debug_Comm.h"
+
+static USART_Config Debug_Comm;
+static USART_TX_Queue Debug_TX_Queue;
+
+// DMA fills a pool packet; at the IDLE gap it is posted and reception moves to a fresh one
+static Packet *debug_rx_packet;
+
+// Header and trailer of a gathered frame, indexed by the queue slot of its trailer
+typedef struct Debug_Frame_Wrap
+{
+	uint8_t header[CUSTOM_FRAME_HEADER_LENGTH];
+	uint8_t trailer[CUSTOM_FRAME_TRAILER_LENGTH];
+}Debug_Frame_Wrap;
+
+__NOINIT static Debug_Frame_Wrap Debug_TX_Wrap[USART_TX_QUEUE_LENGTH];
+
+// IDLE gap: hand over the packet just filled and arm a fresh one; with the pool empty the frame is dropped
+static void Debug_Comm_Idle_IRQ(void)
+{
+	(void)DEBUG_COMM_PORT->SR;
+	(void)DEBUG_COMM_PORT->DR;
+	if (debug_rx_packet == NULL) return;
+
+	uint16_t length = DEBUG_COMM_RX_BUFFER_LENGTH - Debug_Comm.USART_DMA_Instance_RX.Request.Stream->NDTR;
+	Packet *filled = debug_rx_packet;
+	Packet *next = (length != 0U) ? Packet_Alloc(PACKET_RX) : NULL;
+
+	if (next != NULL) debug_rx_packet = next;
+	USART_RX_Buffer_Start(&Debug_Comm, debug_rx_packet->data, DEBUG_COMM_RX_BUFFER_LENGTH, 1);
+
+	if (next == NULL) return;
+	filled->length = length;
+	Packet_Handoff(filled, PACKET_RX, PACKET_PARSER);
+	if (!Event_Post(EVENT_FRAME_RECEIVED, ((uint32_t)EVENT_SOURCE_USART1 << EVENT_SOURCE_Pos) |
+			((uint32_t)filled->index << EVENT_PACKET_Pos) | length)) Packet_Free(filled);
+}
+
+// Queue descriptor callback, context is the slot index
+static void Debug_Comm_TX_Done_IRQ(void *context)
+{
+	Event_Post(EVENT_TX_DONE, (uint32_t)context);
+}
+
+void Debug_Comm_Init(uint32_t baudrate)
+{
+	USART_Config_Reset(&Debug_Comm);
+
+	Debug_Comm.Port = DEBUG_COMM_PORT;
+	Debug_Comm.baudrate = baudrate;
+	Debug_Comm.mode = USART_Configuration.Mode.Asynchronous;
+	Debug_Comm.stop_bits = USART_Configuration.Stop_Bits.Bit_1;
+	Debug_Comm.TX_Pin = DEBUG_COMM_TX_PIN;
+	Debug_Comm.RX_Pin = DEBUG_COMM_RX_PIN;
+	Debug_Comm.interrupt = USART_Configuration.Interrupt_Type.IDLE_Enable;
+	Debug_Comm.dma_enable = USART_Configuration.DMA_Enable.TX_Enable | USART_Configuration.DMA_Enable.RX_Enable;
+	Debug_Comm.ISR_Routines.Idle_Line_ISR = Debug_Comm_Idle_IRQ;
+	Debug_TX_Queue.head = 0;
+	Debug_TX_Queue.tail = 0;
+	Debug_Comm.tx_queue = &Debug_TX_Queue;
+
+	USART_Init(&Debug_Comm);
+}
+
+// Recompute the baud rate divider after SYSCLK/APB2 changed
+void Debug_Comm_Clock_Changed(void)
+{
+	if (Debug_Comm.Port == NULL) return;
+
+	USART_Set_Baudrate(&Debug_Comm);
+}
+
+// Arms reception once, the IDLE interrupt re-arms it after every frame
+void Debug_Comm_Receive_Start(void)
+{
+	if (debug_rx_packet == NULL) debug_rx_packet = Packet_Alloc(PACKET_RX);
+	if (debug_rx_packet == NULL) return;
+
+	USART_RX_Buffer_Start(&Debug_Comm, debug_rx_packet->data, DEBUG_COMM_RX_BUFFER_LENGTH, 1);
+}
+
+// The packet reported by EVENT_FRAME_RECEIVED (pass its arg), owned by the caller until Packet_Free(); NULL if unusable
+Packet *Debug_Comm_Take(uint32_t frame)
+{
+	Packet *packet = Packet_At((frame >> EVENT_PACKET_Pos) & 0xFFU);
+
+	if ((packet == NULL) || (packet->owner != PACKET_PARSER)) return NULL;
+	if (packet->length < 2U) {
+		Packet_Free(packet);
+		return NULL;
+	}
+	return packet;
+}
+
+// Wire time of one full buffer, the longest a queue slot can stay busy
+static uint32_t Debug_Comm_Slot_Time_us(void)
+{
+	return (uint32_t)(((uint64_t)DEBUG_COMM_RX_BUFFER_LENGTH * 10U * 1000000U) / Debug_Comm.baudrate) + USART_WAIT_MARGIN_US;
+}
+
+/*
+ * Sends AA 55 | command | request | length | payload | CRC | BB 66 as three
+ * queued DMA transfers, like Custom_Comm_Send_Frame(). payload is read in
+ * place and must stay unchanged until EVENT_TX_DONE. Returns -1 if the
+ * queue did not drain in time.
+ */
+int8_t Debug_Comm_Send_Frame(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length)
+{
+	uint8_t descriptors = (length != 0U) ? 3U : 2U;
+
+	if (!Timebase_Wait_Until((uint8_t)(Debug_TX_Queue.head - Debug_TX_Queue.tail) <= (USART_TX_QUEUE_LENGTH - descriptors),
+			Debug_Comm_Slot_Time_us())) return -1;
+
+	uint32_t slot = (uint8_t)(Debug_TX_Queue.head + descriptors - 1U) & (USART_TX_QUEUE_LENGTH - 1U);
+	Debug_Frame_Wrap *wrap = &Debug_TX_Wrap[slot];
+
+	wrap->header[0] = CUSTOM_FRAME_HEADER_1;
+	wrap->header[1] = CUSTOM_FRAME_HEADER_2;
+	wrap->header[2] = command;
+	wrap->header[3] = request;
+	wrap->header[4] = length;
+
+	CRC_Reset();
+	uint32_t crc = CRC_Accumulate_8Bit_Block(&wrap->header[2], CUSTOM_FRAME_HEADER_LENGTH - 2U);
+	if (length != 0U) crc = CRC_Accumulate_8Bit_Block((volatile uint8_t *)payload, length);
+
+	wrap->trailer[0] = (crc & 0xFF000000) >> 24;
+	wrap->trailer[1] = (crc & 0x00FF0000) >> 16;
+	wrap->trailer[2] = (crc & 0x0000FF00) >> 8;
+	wrap->trailer[3] = (crc & 0x000000FF) >> 0;
+	wrap->trailer[4] = CUSTOM_FRAME_FOOTER_1;
+	wrap->trailer[5] = CUSTOM_FRAME_FOOTER_2;
+
+	USART_TX_Enqueue(&Debug_Comm, wrap->header, CUSTOM_FRAME_HEADER_LENGTH, NULL, NULL);
+	if (length != 0U) USART_TX_Enqueue(&Debug_Comm, (const uint8_t *)payload, length, NULL, NULL);
+	USART_TX_Enqueue(&Debug_Comm, wrap->trailer, CUSTOM_FRAME_TRAILER_LENGTH, Debug_Comm_TX_Done_IRQ, (void *)slot);
+
+	return 1;
+}
+
+// Free TX queue descriptors; a frame from Debug_Comm_Send_Frame() needs up to 3
+uint8_t Debug_Comm_TX_Free(void)
+{
+	return USART_TX_QUEUE_LENGTH - (uint8_t)(Debug_TX_Queue.head - Debug_TX_Queue.tail);
+}
+
+// Waits until every queued frame has been handed to the USART
+void Debug_Comm_Flush(void)
+{
+	Timebase_Wait_Until(!USART_TX_Busy(&Debug_Comm), USART_TX_QUEUE_LENGTH * Debug_Comm_Slot_Time_us());
+	Timebase_Wait_Until(DEBUG_COMM_PORT->SR & USART_SR_TC, USART_WAIT_MARGIN_US);
+}
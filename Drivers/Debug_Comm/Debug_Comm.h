@@ -0,0 +1,42 @@
+/*
+ * Debug_Comm.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef DEBUG_COMM_DEBUG_COMM_H_
+#define DEBUG_COMM_DEBUG_COMM_H_
+
+#include "main.h"
+#include "USART/USART.h"
+#include "DMA/DMA.h"
+#include "CRC/CRC.h"
+#include "Event/Event.h"
+#include "Packet/Packet.h"
+#include "Custom_RS485_Comm/Custom_RS485_Comm.h"
+
+/*
+ * Bootloader frames (AA 55 ... BB 66, as on UART4) on the USART1 debug
+ * header. Point to point: one frame per IDLE line gap, legacy replies only,
+ * no RS485 direction control, COBS, FEC or RTS. USART1 has its own DMA
+ * streams and TX queue, so this runs alongside Custom_RS485_Comm.
+ */
+
+#define DEBUG_COMM_PORT              USART1
+#define DEBUG_COMM_TX_PIN            USART1_TX_Pin.PB6
+#define DEBUG_COMM_RX_PIN            USART1_RX_Pin.PB7
+
+#define DEBUG_COMM_RX_BUFFER_LENGTH  300U     // longest frame is 267 bytes, at most PACKET_DATA_LENGTH
+
+void Debug_Comm_Init(uint32_t baudrate);
+void Debug_Comm_Clock_Changed(void);
+
+/* Event driven use: frames arrive as EVENT_FRAME_RECEIVED (arg for Debug_Comm_Take), sends finish with EVENT_TX_DONE (arg: slot) */
+void Debug_Comm_Receive_Start(void);
+Packet *Debug_Comm_Take(uint32_t frame);
+int8_t Debug_Comm_Send_Frame(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length);
+uint8_t Debug_Comm_TX_Free(void);
+void Debug_Comm_Flush(void);
+
+
+#endif /* DEBUG_COMM_DEBUG_COMM_H_ */
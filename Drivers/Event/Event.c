@@ -0,0 +1,101 @@
+/*
+ * Event.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+
+#include "Event.h"
+
+typedef struct Event_Slot
+{
+	Event event;
+	volatile uint32_t ready;    // set by the producer once event is written
+}Event_Slot;
+
+static Event_Slot event_queue[EVENT_QUEUE_LENGTH];
+static volatile uint32_t event_head;   // next slot to reserve, shared by producers
+static volatile uint32_t event_tail;   // next slot to dispatch, main thread only
+static volatile uint32_t event_dropped;
+static Event_Handler event_handlers[EVENT_COUNT];
+
+void Event_Init(void)
+{
+	event_head = 0;
+	event_tail = 0;
+	event_dropped = 0;
+	for (uint32_t i = 0; i < EVENT_QUEUE_LENGTH; i++) {
+		event_queue[i].ready = 0;
+	}
+	for (uint32_t i = 0; i < EVENT_COUNT; i++) {
+		event_handlers[i] = NULL;
+	}
+}
+
+void Event_Register(Event_ID id, Event_Handler handler)
+{
+	if (id < EVENT_COUNT) event_handlers[id] = handler;
+}
+
+bool Event_Post(Event_ID id, uint32_t arg)
+{
+	uint32_t head;
+
+	// Reserve a slot: an interrupting producer makes the STREX fail and we retry
+	do {
+		head = __LDREXW(&event_head);
+		if ((head - event_tail) >= EVENT_QUEUE_LENGTH) {
+			__CLREX();
+			event_dropped++;
+			return false;
+		}
+	} while (__STREXW(head + 1U, &event_head) != 0U);
+
+	Event_Slot *slot = &event_queue[head & (EVENT_QUEUE_LENGTH - 1U)];
+	slot->event.id = id;
+	slot->event.arg = arg;
+	__DMB();
+	slot->ready = 1;
+	return true;
+}
+
+// Dispatches the oldest event, returns false if there was nothing to run
+bool Event_Dispatch(void)
+{
+	Event_Slot *slot = &event_queue[event_tail & (EVENT_QUEUE_LENGTH - 1U)];
+
+	// A reserved but not yet written slot blocks later ones to keep order
+	if (event_tail == event_head || slot->ready == 0U) return false;
+
+	__DMB();
+	Event event = slot->event;
+	slot->ready = 0;
+	__DMB();
+	event_tail++;
+
+	if ((event.id < EVENT_COUNT) && event_handlers[event.id]) {
+		event_handlers[event.id](&event);
+	}
+	return true;
+}
+
+void Event_Run(void)
+{
+	while (1) {
+		while (Event_Dispatch()) {}
+
+		// Check and sleep with interrupts masked so a post can't slip in between,
+		// a pending interrupt still wakes the core from WFI
+		__disable_irq();
+		if (event_tail == event_head) {
+			__DSB();
+			__WFI();
+		}
+		__enable_irq();
+	}
+}
+
+uint32_t Event_Dropped_Count(void)
+{
+	return event_dropped;
+}
@@ -0,0 +1,59 @@
+/*
+ * Event.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef EVENT_EVENT_H_
+#define EVENT_EVENT_H_
+
+#include "main.h"
+
+/*
+ * Run-to-completion event loop. ISRs and handlers post events with
+ * Event_Post(), which is lock-free and safe from any priority; the main
+ * thread dispatches them one at a time in posting order and sleeps with
+ * WFI when the queue is empty.
+ */
+
+#define EVENT_QUEUE_LENGTH   16U      // power of two
+
+typedef enum Event_ID
+{
+	EVENT_FRAME_RECEIVED,   // arg: source, packet and length, pass all of it to that link's Take()
+	EVENT_TX_DONE,          // arg: TX queue slot
+	EVENT_FLASH_DONE,       // arg: 0 on success, FLASH->SR error bits otherwise
+	EVENT_CRC_STEP,         // arg: job defined, for chunked CRC work
+	EVENT_CRC_DONE,         // arg: computed CRC
+	EVENT_DFU_SERVICE,      // arg: unused, run DFU_Service()
+	EVENT_COUNT,
+}Event_ID;
+
+/* Link that posted an EVENT_FRAME_RECEIVED, so several can listen at once */
+#define EVENT_SOURCE_Pos     24U
+#define EVENT_PACKET_Pos     16U      // Packet index, the length sits below it
+
+typedef enum Event_Source
+{
+	EVENT_SOURCE_UART4 = 0,  // Custom_RS485_Comm
+	EVENT_SOURCE_CAN1,       // CAN_Comm
+	EVENT_SOURCE_USART1,     // Debug_Comm
+	EVENT_SOURCE_COUNT,
+}Event_Source;
+
+typedef struct Event
+{
+	Event_ID id;
+	uint32_t arg;
+}Event;
+
+typedef void (*Event_Handler)(const Event *event);
+
+void Event_Init(void);
+void Event_Register(Event_ID id, Event_Handler handler);
+bool Event_Post(Event_ID id, uint32_t arg);
+bool Event_Dispatch(void);
+void Event_Run(void);
+uint32_t Event_Dropped_Count(void);
+
+#endif /* EVENT_EVENT_H_ */
@@ -0,0 +1,267 @@
+/*
+ * FEC.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+
+#include "FEC.h"
+
+// GF(256) over x^8 + x^4 + x^3 + x^2 + 1 (0x11D), alpha = 2; exp is doubled so log sums need no modulo
+static const uint8_t gf_exp[512] = {
+	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+	0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+	0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+	0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+	0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+	0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+	0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+	0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+	0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+	0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+	0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+	0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+	0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+	0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+	0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+	0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+	0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+	0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+	0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+	0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+	0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+	0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+	0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+	0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+	0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+	0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+	0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+	0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+	0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+	0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+	0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+	0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02,
+};
+
+// gf_log[0] is unused
+static const uint8_t gf_log[256] = {
+	0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+	0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+	0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+	0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+	0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+	0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+	0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+	0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+	0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+	0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+	0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+	0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+	0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+	0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+	0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+	0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF,
+};
+
+// Generator polynomial (x - a^0)...(x - a^(parity-1)), highest degree first, rebuilt when parity changes
+static uint8_t fec_generator[FEC_MAX_PARITY + 1];
+static uint8_t fec_generator_parity;
+
+static inline uint8_t GF_Mul(uint8_t a, uint8_t b)
+{
+	if ((a == 0U) || (b == 0U)) return 0;
+	return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static inline uint8_t GF_Div(uint8_t a, uint8_t b)
+{
+	if (a == 0U) return 0;
+	return gf_exp[gf_log[a] + 255U - gf_log[b]];
+}
+
+static inline uint8_t GF_Pow(uint8_t exponent)
+{
+	return gf_exp[exponent];
+}
+
+static void FEC_Build_Generator(uint8_t parity)
+{
+	if (fec_generator_parity == parity) return;
+
+	fec_generator[0] = 1;
+	for (uint8_t i = 0; i < parity; i++) {
+		// multiply by (x + a^i)
+		fec_generator[i + 1U] = 0;
+		for (uint8_t j = i + 1U; j > 0U; j--) {
+			fec_generator[j] ^= GF_Mul(fec_generator[j - 1U], GF_Pow(i));
+		}
+	}
+	fec_generator_parity = parity;
+}
+
+// Systematic encode of one block: the parity symbols are data(x) * x^parity mod g(x)
+static void FEC_Encode_Block(const uint8_t *data, uint8_t length, uint8_t *parity_out, uint8_t parity)
+{
+	for (uint8_t i = 0; i < parity; i++) parity_out[i] = 0;
+
+	for (uint8_t i = 0; i < length; i++) {
+		uint8_t feedback = data[i] ^ parity_out[0];
+		for (uint8_t j = 0; j + 1U < parity; j++) {
+			parity_out[j] = parity_out[j + 1U] ^ GF_Mul(feedback, fec_generator[j + 1U]);
+		}
+		parity_out[parity - 1U] = GF_Mul(feedback, fec_generator[parity]);
+	}
+}
+
+/*
+ * Corrects one block of n symbols (data then parity) in place with
+ * Berlekamp-Massey, Chien search and Forney. Returns the number of
+ * symbols corrected, -1 when there are more errors than parity / 2.
+ */
+static int FEC_Decode_Block(uint8_t *block, uint16_t n, uint8_t parity)
+{
+	uint8_t syndrome[FEC_MAX_PARITY];
+	bool clean = true;
+
+	for (uint8_t j = 0; j < parity; j++) {
+		uint8_t s = 0;
+		for (uint16_t i = 0; i < n; i++) s = GF_Mul(s, GF_Pow(j)) ^ block[i];
+		syndrome[j] = s;
+		if (s != 0U) clean = false;
+	}
+	if (clean) return 0;
+
+	// Berlekamp-Massey: error locator lambda, lowest degree first
+	uint8_t lambda[FEC_MAX_PARITY + 1] = {1};
+	uint8_t previous[FEC_MAX_PARITY + 1] = {1};
+	uint8_t errors = 0;
+	uint8_t shift = 1;
+	uint8_t previous_discrepancy = 1;
+
+	for (uint8_t k = 0; k < parity; k++) {
+		uint8_t discrepancy = syndrome[k];
+		for (uint8_t i = 1; i <= errors; i++) discrepancy ^= GF_Mul(lambda[i], syndrome[k - i]);
+
+		if (discrepancy == 0U) {
+			shift++;
+			continue;
+		}
+
+		uint8_t scale = GF_Div(discrepancy, previous_discrepancy);
+		if ((2U * errors) <= k) {
+			uint8_t saved[FEC_MAX_PARITY + 1];
+			for (uint8_t i = 0; i <= parity; i++) saved[i] = lambda[i];
+			for (uint8_t i = shift; i <= parity; i++) lambda[i] ^= GF_Mul(scale, previous[i - shift]);
+			for (uint8_t i = 0; i <= parity; i++) previous[i] = saved[i];
+			errors = k + 1U - errors;
+			previous_discrepancy = discrepancy;
+			shift = 1;
+		} else {
+			for (uint8_t i = shift; i <= parity; i++) lambda[i] ^= GF_Mul(scale, previous[i - shift]);
+			shift++;
+		}
+	}
+
+	if ((2U * errors) > parity) return -1;
+
+	// Error evaluator omega = syndrome * lambda mod x^parity
+	uint8_t omega[FEC_MAX_PARITY];
+	for (uint8_t i = 0; i < parity; i++) {
+		uint8_t v = 0;
+		for (uint8_t j = 0; (j <= i) && (j <= errors); j++) v ^= GF_Mul(lambda[j], syndrome[i - j]);
+		omega[i] = v;
+	}
+
+	// Chien search over the positions of this (possibly shortened) block
+	uint8_t found = 0;
+	for (uint16_t i = 0; i < n; i++) {
+		uint8_t power = (uint8_t)(n - 1U - i);                 // block[i] is the coefficient of x^power
+		uint8_t x_inverse = GF_Pow((uint8_t)((255U - power) % 255U));
+
+		uint8_t value = 0;
+		uint8_t derivative = 0;
+		uint8_t x_term = 1;
+		for (uint8_t j = 0; j <= errors; j++) {
+			value ^= GF_Mul(lambda[j], x_term);
+			if (j & 1U) derivative ^= GF_Mul(lambda[j], GF_Mul(x_term, GF_Div(1, x_inverse)));
+			x_term = GF_Mul(x_term, x_inverse);
+		}
+		if (value != 0U) continue;
+
+		uint8_t evaluator = 0;
+		x_term = 1;
+		for (uint8_t j = 0; j < parity; j++) {
+			evaluator ^= GF_Mul(omega[j], x_term);
+			x_term = GF_Mul(x_term, x_inverse);
+		}
+		if (derivative == 0U) return -1;
+
+		// Forney with first consecutive root a^0: e = X * omega(X^-1) / lambda'(X^-1)
+		block[i] ^= GF_Mul(GF_Pow(power), GF_Div(evaluator, derivative));
+		found++;
+	}
+
+	return (found == errors) ? (int)found : -1;
+}
+
+uint16_t FEC_Encoded_Length(uint16_t length, uint8_t parity)
+{
+	if (parity == 0U) return length;
+
+	uint16_t data_per_block = FEC_BLOCK_LENGTH - parity;
+	uint16_t blocks = (length + data_per_block - 1U) / data_per_block;
+	return length + (blocks * parity);
+}
+
+uint16_t FEC_Encode(const uint8_t *data, uint16_t length, uint8_t *out, uint8_t parity)
+{
+	if (parity == 0U) {
+		for (uint16_t i = 0; i < length; i++) out[i] = data[i];
+		return length;
+	}
+
+	FEC_Build_Generator(parity);
+
+	uint16_t data_per_block = FEC_BLOCK_LENGTH - parity;
+	uint16_t written = 0;
+
+	while (length != 0U) {
+		uint8_t chunk = (length > data_per_block) ? data_per_block : length;
+
+		for (uint8_t i = 0; i < chunk; i++) out[written + i] = data[i];
+		FEC_Encode_Block(data, chunk, &out[written + chunk], parity);
+
+		written += chunk + parity;
+		data += chunk;
+		length -= chunk;
+	}
+	return written;
+}
+
+int FEC_Decode(uint8_t *data, uint16_t length, uint8_t parity, uint16_t *decoded_length)
+{
+	*decoded_length = length;
+	if (parity == 0U) return 0;
+
+	uint16_t read = 0;
+	uint16_t written = 0;
+	int corrected = 0;
+
+	while (read < length) {
+		uint16_t block = length - read;
+		if (block > FEC_BLOCK_LENGTH) block = FEC_BLOCK_LENGTH;
+		if (block <= parity) return -1;
+
+		int result = FEC_Decode_Block(&data[read], block, parity);
+		if (result < 0) return -1;
+		corrected += result;
+
+		// Drop the parity symbols, data moves down over the previous block's parity
+		for (uint16_t i = 0; i < (block - parity); i++) data[written + i] = data[read + i];
+		written += block - parity;
+		read += block;
+	}
+
+	*decoded_length = written;
+	return corrected;
+}
@@ -0,0 +1,26 @@
+/*
+ * FEC.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef FEC_FEC_H_
+#define FEC_FEC_H_
+
+#include "main.h"
+
+/*
+ * Reed-Solomon over GF(256) for the comm link. A frame is cut into blocks
+ * of at most FEC_BLOCK_LENGTH - parity data bytes, each followed by parity
+ * check symbols; every block corrects up to parity / 2 wrong bytes. The last
+ * block is shortened, so the block layout follows from the total length alone.
+ */
+
+#define FEC_BLOCK_LENGTH     255U
+#define FEC_MAX_PARITY       16U      // even, up to 8 corrected bytes per block
+
+uint16_t FEC_Encoded_Length(uint16_t length, uint8_t parity);
+uint16_t FEC_Encode(const uint8_t *data, uint16_t length, uint8_t *out, uint8_t parity);
+int FEC_Decode(uint8_t *data, uint16_t length, uint8_t parity, uint16_t *decoded_length);
+
+#endif /* FEC_FEC_H_ */
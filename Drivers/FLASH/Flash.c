@@ -11,13 +11,33 @@
 #define FLASH_KEY1 0x45670123
 #define FLASH_KEY2 0xCDEF89AB
 
+/*
+ * Returns 1 if the flash is still busy after timeout_us. Counts raw CYCCNT
+ * deltas in a local instead of using the timebase, which keeps its state in
+ * bootloader RAM: the service table exports these routines. Cycles are taken
+ * at FLASH_WAIT_CYCLES_PER_US, the fastest core clock, so at slower clocks
+ * the timeout only gets longer.
+ */
+static int Flash_Wait_Idle(uint32_t timeout_us)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	uint32_t start = DWT->CYCCNT;
+	while (FLASH->SR & FLASH_SR_BSY) {
+		if (((DWT->CYCCNT - start) / FLASH_WAIT_CYCLES_PER_US) >= timeout_us) {
+			return (FLASH->SR & FLASH_SR_BSY) ? 1 : 0;
+		}
+	}
+	return 0;
+}
 
 void Flash_Unlock(void)
 {
 	if (FLASH->CR & FLASH_CR_LOCK) {
 		FLASH->KEYR = FLASH_KEY1;
 		FLASH->KEYR = FLASH_KEY2;
-		while (FLASH->SR & FLASH_SR_BSY) {}
+		Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US);
 	}
 }
 
@@ -41,6 +61,95 @@ void Flash_Write_Disable(void)
 
 
 
+static int Flash_Program_Using(uint32_t Flash_Address, const volatile void *data, uint32_t length,
+		void (*transfer)(volatile void *source, uint8_t source_data_size, bool source_increment,
+				volatile void *destination, uint8_t dest_data_size, bool destination_increment, uint16_t length))
+{
+	const volatile uint8_t *source = data;
+
+	Flash_Unlock();
+	if (Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US)) {
+		Flash_Lock();
+		return 1;
+	}
+	FLASH->SR = FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR;
+	Flash_Write_Enable();
+
+	while (length > 0U) {
+		uint16_t chunk = (length > 0xFFFFU) ? 0xFFFFU : (uint16_t)length;
+		transfer((volatile void *)source, 8, 1, (volatile void *)Flash_Address, 8, 1, chunk);
+		source        += chunk;
+		Flash_Address += chunk;
+		length        -= chunk;
+	}
+
+	int status = Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US);
+
+	if (FLASH->SR & (FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR)) {
+		status = 1;
+	}
+
+	Flash_Write_Disable();
+	Flash_Lock();
+
+	return status;
+}
+
+int Flash_Program(uint32_t Flash_Address, const volatile void *data, uint32_t length)
+{
+	return Flash_Program_Using(Flash_Address, data, length, DMA_Memory_To_Memory_Transfer);
+}
+
+/* Flash_Program() through DMA2 Stream0 without claiming it, for the bootloader service table */
+int Flash_Program_Fixed_Stream(uint32_t Flash_Address, const volatile void *data, uint32_t length)
+{
+	return Flash_Program_Using(Flash_Address, data, length, DMA_Fixed_Stream_Transfer);
+}
+
+/*
+ * Flash_Program() at x32 parallelism: a quarter of the program cycles for the
+ * same data. Needs VDD 2.7 - 3.6 V, a word aligned address and a length that
+ * is a multiple of 4 bytes; returns 1 on any of those or a program error.
+ */
+int Flash_Program_32(uint32_t Flash_Address, const volatile void *data, uint32_t length)
+{
+	const volatile uint32_t *source = data;
+
+	if ((Flash_Address & 3U) || (length & 3U) || ((uint32_t)source & 3U)) return 1;
+
+	Flash_Unlock();
+	if (Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US)) {
+		Flash_Lock();
+		return 1;
+	}
+	FLASH->SR = FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR;
+	FLASH->CR &= ~FLASH_CR_PSIZE;
+	FLASH->CR |= FLASH_CR_PSIZE_1;
+	FLASH->CR |= FLASH_CR_PG;
+
+	uint32_t words = length / 4U;
+	while (words > 0U) {
+		uint16_t chunk = (words > 0xFFFFU) ? 0xFFFFU : (uint16_t)words;
+		DMA_Memory_To_Memory_Transfer((volatile void *)source, 32, 1, (volatile void *)Flash_Address, 32, 1, chunk);
+		source        += chunk;
+		Flash_Address += 4U * chunk;
+		words         -= chunk;
+	}
+
+	int status = Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US);
+
+	if (FLASH->SR & (FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR)) {
+		status = 1;
+	}
+
+	// Erases keep running at x8, as FLASH_ERASE_TIMEOUT_US assumes
+	FLASH->CR &= ~FLASH_CR_PSIZE;
+	Flash_Write_Disable();
+	Flash_Lock();
+
+	return status;
+}
+
 void FLash_Write_Data(volatile void  *desitnation_buffer,uint8_t data_length, uint16_t length, uint32_t Flash_Address)
 {
 	DMA_Memory_To_Memory_Transfer(desitnation_buffer, data_length, 1, Flash_Address, data_length, 1, length);
@@ -61,18 +170,55 @@ uint8_t Flash_Read_Single_Byte(uint32_t Flash_Address)
 	return *(__IO uint32_t *)Flash_Address;
 }
 
-void Flash_Erase_Sector(Flash_Sectors_Typedef sector_number)
+static void (*flash_done_isr)(uint32_t status);
+
+/*
+ * Starts a sector erase and returns. done_isr runs from FLASH_IRQHandler with
+ * 0 or the FLASH->SR error bits. The flash must already be unlocked.
+ */
+int Flash_Erase_Sector_Start(Flash_Sectors_Typedef sector_number, void (*done_isr)(uint32_t status))
+{
+	if (Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US)) return 1;
+
+	flash_done_isr = done_isr;
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR;
+	FLASH->CR &= ~FLASH_CR_SNB;
+	FLASH->CR |= (sector_number << FLASH_CR_SNB_Pos);
+	FLASH->CR |= FLASH_CR_SER | FLASH_CR_EOPIE | FLASH_CR_ERRIE;
+	NVIC_EnableIRQ(FLASH_IRQn);
+	FLASH->CR |= FLASH_CR_STRT;
+
+	return 0;
+}
+
+void FLASH_IRQHandler(void)
 {
-	while (FLASH->SR & FLASH_SR_BSY); // Wait if busy
+	uint32_t status = FLASH->SR & (FLASH_SR_SOP | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR);
+
+	FLASH->SR = FLASH_SR_EOP | status;
+	FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+
+	if (flash_done_isr) {
+		void (*done_isr)(uint32_t status) = flash_done_isr;
+		flash_done_isr = NULL;
+		done_isr(status);
+	}
+}
+
+int Flash_Erase_Sector(Flash_Sectors_Typedef sector_number)
+{
+	if (Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US)) return 1; // Wait if busy
 
 	FLASH->CR &= ~FLASH_CR_SNB;
 	FLASH->CR |= (sector_number << FLASH_CR_SNB_Pos);
 	FLASH->CR |= FLASH_CR_SER;  // Sector erase
 	FLASH->CR |= FLASH_CR_STRT;
 
-	while (FLASH->SR & FLASH_SR_BSY); // Wait for completion
+	int status = Flash_Wait_Idle(FLASH_ERASE_TIMEOUT_US); // Wait for completion
 
 	FLASH->CR &= ~FLASH_CR_SER; // Clear SER
+
+	return status;
 }
 
 void Flash_Write_Sigle_Word(uint32_t Flash_Address, uint32_t data)
@@ -117,7 +263,10 @@ int Flash_Write_Data_32(uint32_t address, uint32_t data)
     }
 
     /* 2) Wait ready */
-    while (FLASH->SR & FLASH_SR_BSY) {}
+    if (Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US)) {
+        FLASH->CR |= FLASH_CR_LOCK;
+        return 1;
+    }
 
     /* 3) Configure for half-word programming */
     FLASH->CR &= ~FLASH_CR_PSIZE;
@@ -130,10 +279,10 @@ int Flash_Write_Data_32(uint32_t address, uint32_t data)
     *(__IO uint32_t *)address = word;
 
     /* 6) Wait completion */
-    while (FLASH->SR & FLASH_SR_BSY) {}
+    int timed_out = Flash_Wait_Idle(FLASH_BUSY_TIMEOUT_US);
 
     /* 7) Check for errors */
-    if (FLASH->SR & (FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_PGSERR)) {
+    if (timed_out || (FLASH->SR & (FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_PGSERR))) {
         FLASH->SR |= FLASH_SR_EOP;  /* clear */
         FLASH->CR &= ~FLASH_CR_PG;
         FLASH->CR |= FLASH_CR_LOCK;
@@ -10,6 +10,11 @@
 
 #include "main.h"
 #include "DMA/DMA.h"
+#include "Timebase/Timebase.h"
+
+#define FLASH_BUSY_TIMEOUT_US     10000U     // unlock, program completion
+#define FLASH_ERASE_TIMEOUT_US    4000000U   // 128 KB sector at x8 parallelism, worst case
+#define FLASH_WAIT_CYCLES_PER_US  168U       // timeouts assume the 168 MHz core clock, CYCCNT wraps after 25 s
 
 typedef enum {
 
@@ -32,7 +37,8 @@ void Flash_Unlock(void);
 void Flash_Lock(void);
 void Flash_Write_Enable(void);
 void Flash_Write_Disable(void);
-void Flash_Erase_Sector(Flash_Sectors_Typedef sector_number);
+int Flash_Erase_Sector(Flash_Sectors_Typedef sector_number);
+int Flash_Erase_Sector_Start(Flash_Sectors_Typedef sector_number, void (*done_isr)(uint32_t status));
 void FLash_Write_Data(volatile void  *desitnation_buffer,uint8_t data_length, uint16_t length, uint32_t Flash_Address);
 uint32_t Flash_Read_Single_Word(uint32_t Flash_Address);
 uint16_t Flash_Read_Single_Half_Word(uint32_t Flash_Address);
@@ -41,6 +47,9 @@ void Flash_Write_Sigle_Word(uint32_t Flash_Address, uint32_t data);
 void Flash_Write_Sigle_Half_Word(uint32_t Flash_Address, uint16_t data);
 void Flash_Write_Sigle_Byte(uint32_t Flash_Address, uint8_t data);
 int Flash_Write_Data_32(uint32_t address, uint32_t data);
+int Flash_Program(uint32_t Flash_Address, const volatile void *data, uint32_t length);
+int Flash_Program_Fixed_Stream(uint32_t Flash_Address, const volatile void *data, uint32_t length);
+int Flash_Program_32(uint32_t Flash_Address, const volatile void *data, uint32_t length);
 
 
 
@@ -0,0 +1,159 @@
+/*
+ * Memory.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "Memory.h"
+
+// Whole words, four per pass; both pointers word aligned
+static void Memory_Copy_Words(uint32_t *destination, const uint32_t *source, uint32_t words)
+{
+	while (words >= 4U) {
+		uint32_t a = source[0], b = source[1], c = source[2], d = source[3];
+		destination[0] = a;
+		destination[1] = b;
+		destination[2] = c;
+		destination[3] = d;
+		destination += 4;
+		source += 4;
+		words -= 4U;
+	}
+
+	while (words-- != 0U) *destination++ = *source++;
+}
+
+static void Memory_Copy_CPU(uint8_t *destination, const uint8_t *source, uint32_t length)
+{
+	// Word path once the destination is aligned, if the source lines up with it
+	if ((((uint32_t)destination ^ (uint32_t)source) & 3U) == 0U) {
+		while ((((uint32_t)destination & 3U) != 0U) && (length != 0U)) {
+			*destination++ = *source++;
+			length--;
+		}
+
+		uint32_t words = length >> 2;
+		Memory_Copy_Words((uint32_t *)destination, (const uint32_t *)source, words);
+		destination += words << 2;
+		source += words << 2;
+		length &= 3U;
+	}
+
+	while (length-- != 0U) *destination++ = *source++;
+}
+
+static void Memory_Fill_CPU(uint8_t *destination, uint8_t value, uint32_t length)
+{
+	uint32_t pattern = value * 0x01010101U;
+
+	while ((((uint32_t)destination & 3U) != 0U) && (length != 0U)) {
+		*destination++ = value;
+		length--;
+	}
+
+	uint32_t *word = (uint32_t *)destination;
+	uint32_t words = length >> 2;
+	while (words >= 4U) {
+		word[0] = pattern;
+		word[1] = pattern;
+		word[2] = pattern;
+		word[3] = pattern;
+		word += 4;
+		words -= 4U;
+	}
+	while (words-- != 0U) *word++ = pattern;
+
+	destination = (uint8_t *)word;
+	length &= 3U;
+	while (length-- != 0U) *destination++ = value;
+}
+
+// Large, word aligned and reachable by DMA2
+static bool Memory_Use_DMA(uint32_t destination, uint32_t source, uint32_t length)
+{
+	if (length < MEMORY_DMA_MIN_LENGTH) return false;
+	if (((destination | source | length) & 3U) != 0U) return false;
+	return DMA_Reachable((const volatile void *)destination, length) && DMA_Reachable((const volatile void *)source, length);
+}
+
+// Polled stream, so it works from any interrupt priority; one NDTR load per 65535 words
+static void Memory_Copy_DMA(uint32_t destination, uint32_t source, bool source_increment, uint32_t length)
+{
+	uint32_t words = length >> 2;
+
+	while (words != 0U) {
+		uint16_t chunk = (words > 0xFFFFU) ? 0xFFFFU : (uint16_t)words;
+
+		DMA_Memory_To_Memory_Transfer((volatile void *)source, 32, source_increment, (volatile void *)destination, 32, 1, chunk);
+		destination += (uint32_t)chunk << 2;
+		if (source_increment) source += (uint32_t)chunk << 2;
+		words -= chunk;
+	}
+}
+
+void Memory_Copy(volatile void *destination, const volatile void *source, uint32_t length)
+{
+	if (Memory_Use_DMA((uint32_t)destination, (uint32_t)source, length)) {
+		Memory_Copy_DMA((uint32_t)destination, (uint32_t)source, true, length);
+		return;
+	}
+
+	Memory_Copy_CPU((uint8_t *)destination, (const uint8_t *)source, length);
+}
+
+void Memory_Fill(volatile void *destination, uint8_t value, uint32_t length)
+{
+	// Read in place by the stream; the DMA path is skipped if the stack sits in CCM RAM
+	uint32_t pattern = value * 0x01010101U;
+
+	if (Memory_Use_DMA((uint32_t)destination, (uint32_t)&pattern, length)) {
+		Memory_Copy_DMA((uint32_t)destination, (uint32_t)&pattern, false, length);
+		return;
+	}
+
+	Memory_Fill_CPU((uint8_t *)destination, value, length);
+}
+
+/*
+ * Moves the same block once per engine, timed with the cycle counter.
+ * MEMORY_DMA_MIN_LENGTH belongs where dma_cycles drops below cpu_cycles.
+ */
+void Memory_Benchmark(volatile void *destination, const volatile void *source, uint32_t length, Memory_Benchmark_Result *result)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	uint32_t start = DWT->CYCCNT;
+	Memory_Copy_CPU((uint8_t *)destination, (const uint8_t *)source, length);
+	result->cpu_cycles = DWT->CYCCNT - start;
+
+	start = DWT->CYCCNT;
+	Memory_Copy_DMA((uint32_t)destination, (uint32_t)source, true, length);
+	result->dma_cycles = DWT->CYCCNT - start;
+}
+
+/*
+ * Smallest power of two from 64 bytes up to max_length at which the DMA copy
+ * beats the CPU, each length timed MEMORY_CROSSOVER_RUNS times and the best
+ * run kept so an interrupt in between does not count; 0 if the DMA never wins.
+ * Buffers as for Memory_Benchmark(), max_length bytes each.
+ */
+uint32_t Memory_DMA_Crossover(volatile void *destination, const volatile void *source, uint32_t max_length)
+{
+	Memory_Benchmark_Result result;
+
+	for (uint32_t length = 64U; length <= max_length; length <<= 1) {
+		uint32_t cpu = UINT32_MAX;
+		uint32_t dma = UINT32_MAX;
+
+		for (uint8_t run = 0; run < MEMORY_CROSSOVER_RUNS; run++) {
+			Memory_Benchmark(destination, source, length, &result);
+			if (result.cpu_cycles < cpu) cpu = result.cpu_cycles;
+			if (result.dma_cycles < dma) dma = result.dma_cycles;
+		}
+
+		if (dma < cpu) return length;
+	}
+
+	return 0;
+}
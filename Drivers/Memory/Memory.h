@@ -0,0 +1,46 @@
+/*
+ * Memory.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef MEMORY_MEMORY_H_
+#define MEMORY_MEMORY_H_
+
+#include "main.h"
+#include "DMA/DMA.h"
+
+/*
+ * Blocking copy and fill that pick the cheaper engine per call. Frames and
+ * scratch buffers are a few hundred bytes at most, where programming and
+ * polling a DMA stream costs more than moving the bytes with the CPU; the
+ * DMA only takes word aligned blocks from MEMORY_DMA_MIN_LENGTH up.
+ */
+
+/*
+ * Not a measured crossover: no target was available when this was written.
+ * 2048 keeps every frame-sized call (PACKET_DATA_LENGTH, 320 bytes at most)
+ * on the CPU with margin, so the DMA only serves bulk blocks. A blocking DMA
+ * copy keeps the core waiting, so it wins only where the stream moves a word
+ * in fewer cycles than the CPU loop, after paying for the claim, register
+ * setup and flag polling. Run Memory_DMA_Crossover() on the target at the
+ * final clock and put its result here.
+ */
+#define MEMORY_DMA_MIN_LENGTH     2048U
+#define MEMORY_CROSSOVER_RUNS     4U       // timings per length in Memory_DMA_Crossover(), the best is kept
+
+typedef struct Memory_Benchmark_Result
+{
+	uint32_t cpu_cycles;
+	uint32_t dma_cycles;
+}Memory_Benchmark_Result;
+
+void Memory_Copy(volatile void *destination, const volatile void *source, uint32_t length);
+void Memory_Fill(volatile void *destination, uint8_t value, uint32_t length);
+
+/* Core cycles for one copy of length bytes by each engine, both buffers word aligned and outside CCM RAM */
+void Memory_Benchmark(volatile void *destination, const volatile void *source, uint32_t length, Memory_Benchmark_Result *result);
+uint32_t Memory_DMA_Crossover(volatile void *destination, const volatile void *source, uint32_t max_length);
+
+
+#endif /* MEMORY_MEMORY_H_ */
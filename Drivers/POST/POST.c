@@ -18,48 +18,20 @@
 #define SRAM_SIZE  ((uint32_t)0x00020000)  // 128 KB
 #define SRAM_END   ((uint32_t)0x2001FFC0)
 
-volatile uint8_t systick_flag = 0;
-
-void SysTick_Handler(void) {
-	systick_flag = 1;
-	SysTick->CTRL = 0;  // disable SysTick
-}
 
 POST_Result POST_ClockCheck(void)
 {
-	uint32_t timeout;
-
-	RCC -> CR |= RCC_CR_HSEON;
-	timeout = TIMEOUT_COUNT;
-	while (!(RCC->CR & RCC_CR_HSERDY)) {
-		if (--timeout == 0) {
-			return POST_FAIL;
-		}
+	// Verify the bring-up started by MCU_Clock_Setup_Start(), don't redo it
+	if (!Timebase_Wait_Until(MCU_Clock_Setup_Poll(), POST_CLOCK_TIMEOUT_US)) {
+		return POST_FAIL;
 	}
 
-	RCC->PLLCFGR = (8U       << RCC_PLLCFGR_PLLM_Pos)   |
-			(336U     << RCC_PLLCFGR_PLLN_Pos)   |
-			(0U       << RCC_PLLCFGR_PLLP_Pos)   | // PLLP = 2
-			(RCC_PLLCFGR_PLLSRC_HSE)             |
-			(7U       << RCC_PLLCFGR_PLLQ_Pos);
-
-	RCC->CR |= RCC_CR_PLLON;
-	// 5. Wait for PLL ready
-	timeout = TIMEOUT_COUNT;
-	while (!(RCC->CR & RCC_CR_PLLRDY)) {
-		if (--timeout == 0){
-			return POST_FAIL;
-		}
+	if ((RCC->PLLCFGR & RCC_PLLCFGR_PLLSRC) != RCC_PLLCFGR_PLLSRC_HSE) {
+		return POST_FAIL;
 	}
 
-	RCC->CFGR &= ~RCC_CFGR_SW;          // clear SW
-	RCC->CFGR |= RCC_CFGR_SW_PLL;       // select PLL
-	// 7. Wait for switch
-	timeout = TIMEOUT_COUNT;
-	while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL) {
-		if (--timeout == 0){
-			return POST_FAIL;
-		}
+	if (!(RCC->CR & RCC_CR_HSERDY) || !(RCC->CR & RCC_CR_PLLRDY)) {
+		return POST_FAIL;
 	}
 
 	return POST_OK;
@@ -135,18 +107,11 @@ POST_Result POST_FlashCRC(void)
 
 POST_Result POST_InterruptTest(void)
 {
-	uint32_t timeout = TIMEOUT_COUNT;
-
-	// 1. Configure SysTick for a short interval (~1 ms @168 MHz/8)
-	SysTick->LOAD = (168000000U/8/1000U) - 1U;
-	SysTick->VAL = 0;
-	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | // processor clock / 8
-			SysTick_CTRL_TICKINT_Msk   | // enable interrupt
-			SysTick_CTRL_ENABLE_Msk;     // start
-
-	// 2. Wait for flag
-	while (!systick_flag) {
-		if (--timeout == 0) return POST_FAIL;
+	// The Timebase SysTick interrupt must advance the tick count
+	uint32_t ticks = Timebase_Tick_Count();
+
+	if (!Timebase_Wait_Until(Timebase_Tick_Count() != ticks, POST_TICK_TIMEOUT_US)) {
+		return POST_FAIL;
 	}
 	return POST_OK;
 }
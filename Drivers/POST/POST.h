@@ -9,8 +9,10 @@
 #define POST_POST_H_
 
 #include "main.h"
+#include "Timebase/Timebase.h"
 
-#define TIMEOUT_COUNT 0x5000U
+#define POST_CLOCK_TIMEOUT_US   10000U   // HSE start-up (2 ms typ.) plus PLL lock
+#define POST_TICK_TIMEOUT_US    5000U    // several SysTick periods
 extern uint32_t __StackTop;
 typedef enum {
 	POST_FAIL=0,
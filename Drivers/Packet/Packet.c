@@ -0,0 +1,88 @@
+/*
+ * Packet.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "Packet.h"
+
+// In .bss, not .noinit: every owner starts out PACKET_FREE
+static Packet packet_pool[PACKET_POOL_COUNT];
+static uint8_t packet_next;        // where the next search starts, so packets are used round robin
+static Packet_Stats packet_stats;
+
+Packet *Packet_Alloc(Packet_Owner owner)
+{
+	Packet *packet = NULL;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for (uint8_t i = 0; i < PACKET_POOL_COUNT; i++) {
+		uint8_t index = (packet_next + i) % PACKET_POOL_COUNT;
+
+		if (packet_pool[index].owner == PACKET_FREE) {
+			packet = &packet_pool[index];
+			packet->owner = owner;
+			packet->index = index;
+			packet->length = 0;
+			packet_next = (index + 1U) % PACKET_POOL_COUNT;
+			if (++packet_stats.in_use > packet_stats.in_use_max) packet_stats.in_use_max = packet_stats.in_use;
+			break;
+		}
+	}
+	if (packet == NULL) packet_stats.exhausted++;
+
+	__set_PRIMASK(primask);
+	return packet;
+}
+
+// Passes packet on only if from still holds it; false leaves it untouched
+bool Packet_Handoff(Packet *packet, Packet_Owner from, Packet_Owner to)
+{
+	bool moved = false;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if ((packet != NULL) && (packet->owner == from) && (from != PACKET_FREE)) {
+		packet->owner = to;
+		moved = true;
+	}
+
+	__set_PRIMASK(primask);
+	return moved;
+}
+
+// Whoever holds packet gives it back; freeing twice is harmless
+void Packet_Free(Packet *packet)
+{
+	if (packet == NULL) return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (packet->owner != PACKET_FREE) {
+		packet->owner = PACKET_FREE;
+		packet_stats.in_use--;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+// The packet an event arg refers to, NULL for an index outside the pool
+Packet *Packet_At(uint8_t index)
+{
+	return (index < PACKET_POOL_COUNT) ? &packet_pool[index] : NULL;
+}
+
+uint8_t Packet_Available(void)
+{
+	return PACKET_POOL_COUNT - packet_stats.in_use;
+}
+
+void Packet_Get_Stats(Packet_Stats *stats)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*stats = packet_stats;
+	__set_PRIMASK(primask);
+}
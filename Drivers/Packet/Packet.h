@@ -0,0 +1,57 @@
+/*
+ * Packet.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef PACKET_PACKET_H_
+#define PACKET_PACKET_H_
+
+#include "main.h"
+
+/*
+ * Fixed pool of frame buffers shared by every link. A packet has exactly one
+ * owner at a time and is passed on, never copied: the receive interrupt fills
+ * it, the parser validates it, the command handler reads it, and frames that
+ * have to be re-encoded for sending are freed by their TX done callback.
+ * Packets are handed out as they were left; length says how much is valid.
+ */
+
+#define PACKET_POOL_COUNT     10U
+#define PACKET_DATA_LENGTH    320U    // longest encoded UART4 frame: 267 + FEC parity 32 + COBS 3
+
+typedef enum Packet_Owner
+{
+	PACKET_FREE = 0,
+	PACKET_RX,                     // being filled by a receive interrupt
+	PACKET_PARSER,                 // complete frame posted, waiting for the link's Take()
+	PACKET_HANDLER,                // validated frame, read by the command handler
+	PACKET_TX,                     // queued for sending or scratch while encoding
+}Packet_Owner;
+
+typedef struct Packet
+{
+	uint8_t data[PACKET_DATA_LENGTH] __attribute__((aligned(4)));
+	uint16_t length;               // valid bytes in data
+	uint8_t index;                 // position in the pool, travels in event args
+	volatile uint8_t owner;        // Packet_Owner
+}Packet;
+
+/* in_use_max is the high-water mark of the pool (most packets in use at once), exhausted counts failed allocations */
+typedef struct Packet_Stats
+{
+	uint8_t in_use;
+	uint8_t in_use_max;
+	uint32_t exhausted;
+}Packet_Stats;
+
+/* All of these may be called from interrupts */
+Packet *Packet_Alloc(Packet_Owner owner);
+bool Packet_Handoff(Packet *packet, Packet_Owner from, Packet_Owner to);
+void Packet_Free(Packet *packet);
+Packet *Packet_At(uint8_t index);
+uint8_t Packet_Available(void);
+void Packet_Get_Stats(Packet_Stats *stats);
+
+
+#endif /* PACKET_PACKET_H_ */
@@ -0,0 +1,118 @@
+/*
+ * Timebase.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+
+#include "Timebase.h"
+
+static uint32_t timebase_last_cycles;     // CYCCNT at the last fold
+static uint32_t timebase_cycle_remainder; // cycles not yet worth a whole microsecond
+static uint32_t timebase_cycles_per_us;   // 0 until first use
+static uint64_t timebase_now_us;
+static volatile uint32_t timebase_ticks;
+static void (*timebase_tick_hook)(void);
+
+static uint32_t Timebase_Cycles_Per_us(void)
+{
+	uint32_t cycles = SystemCoreClock / 1000000U;
+	return (cycles == 0U) ? 1U : cycles;
+}
+
+// Caller masks interrupts
+static void Timebase_Fold(void)
+{
+	if (timebase_cycles_per_us == 0U) {
+		// First use: CYCCNT was started from 0 by Reset_Handler on HSI
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+		timebase_cycles_per_us = Timebase_Cycles_Per_us();
+		timebase_last_cycles = 0U;
+	}
+
+	uint32_t cycles = DWT->CYCCNT;
+	timebase_cycle_remainder += cycles - timebase_last_cycles;
+	timebase_last_cycles = cycles;
+
+	timebase_now_us += timebase_cycle_remainder / timebase_cycles_per_us;
+	timebase_cycle_remainder %= timebase_cycles_per_us;
+}
+
+void SysTick_Handler(void)
+{
+	timebase_ticks++;
+
+	// Higher priority interrupts call Timebase_Now_us, which folds too
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	Timebase_Fold();
+	__set_PRIMASK(primask);
+
+	if (timebase_tick_hook != NULL) timebase_tick_hook();
+}
+
+/* Calls hook from SysTick (lowest priority) on every tick; NULL removes it */
+void Timebase_Set_Tick_Hook(void (*hook)(void))
+{
+	timebase_tick_hook = hook;
+}
+
+void Timebase_Init(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	Timebase_Fold();
+	__set_PRIMASK(primask);
+
+	SysTick_Config(SystemCoreClock / TIMEBASE_TICK_HZ);
+}
+
+void Timebase_Clock_Changed(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	Timebase_Fold();    // cycles so far were at the old clock
+	timebase_cycles_per_us = Timebase_Cycles_Per_us();
+	timebase_cycle_remainder = 0U;
+	__set_PRIMASK(primask);
+
+	if (SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) {
+		SysTick_Config(SystemCoreClock / TIMEBASE_TICK_HZ);
+	}
+}
+
+uint64_t Timebase_Now_us(void)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	Timebase_Fold();
+	uint64_t now = timebase_now_us;
+	__set_PRIMASK(primask);
+
+	return now;
+}
+
+uint32_t Timebase_Tick_Count(void)
+{
+	return timebase_ticks;
+}
+
+void Timebase_Deadline_Set(Timebase_Deadline *deadline, uint32_t timeout_us)
+{
+	deadline->forever = (timeout_us == TIMEBASE_WAIT_FOREVER);
+	deadline->expiry_us = Timebase_Now_us() + timeout_us;
+}
+
+bool Timebase_Deadline_Expired(Timebase_Deadline *deadline)
+{
+	if (deadline->forever) return false;
+	return Timebase_Now_us() >= deadline->expiry_us;
+}
+
+void Timebase_Delay_us(uint32_t us)
+{
+	Timebase_Deadline deadline;
+	Timebase_Deadline_Set(&deadline, us);
+	while (!Timebase_Deadline_Expired(&deadline)) {}
+}
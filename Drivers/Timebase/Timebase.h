@@ -0,0 +1,49 @@
+/*
+ * Timebase.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef TIMEBASE_TIMEBASE_H_
+#define TIMEBASE_TIMEBASE_H_
+
+#include "main.h"
+
+/*
+ * Monotonic microsecond time built on DWT->CYCCNT. Elapsed cycles are folded
+ * into a 64-bit count at the core clock they ran at, so the time stays
+ * correct across MCU_Clock_Setup_Poll() switching from HSI to the PLL.
+ * SysTick runs at TIMEBASE_TICK_HZ only to fold the counter before CYCCNT
+ * wraps (about 25 s at 168 MHz), nothing busy-waits on it.
+ *
+ * Timebase_Init(), Timebase_Clock_Changed(), Timebase_Now_us() and
+ * Timebase_Delay_us() are declared in main.h for the Delay_* helpers.
+ */
+
+#define TIMEBASE_TICK_HZ        1000U
+#define TIMEBASE_WAIT_FOREVER   0xFFFFFFFFU
+
+typedef struct Timebase_Deadline
+{
+	uint64_t expiry_us;
+	bool     forever;
+}Timebase_Deadline;
+
+uint32_t Timebase_Tick_Count(void);
+void Timebase_Set_Tick_Hook(void (*hook)(void));
+void Timebase_Deadline_Set(Timebase_Deadline *deadline, uint32_t timeout_us);
+bool Timebase_Deadline_Expired(Timebase_Deadline *deadline);
+
+/*
+ * Spins until condition is true or timeout_us passes. Evaluates to true when
+ * the condition was met, the condition is re-checked once after the timeout.
+ */
+#define Timebase_Wait_Until(condition, timeout_us)                          \
+	({                                                                      \
+		Timebase_Deadline _tb_deadline;                                     \
+		Timebase_Deadline_Set(&_tb_deadline, (timeout_us));                 \
+		while (!(condition) && !Timebase_Deadline_Expired(&_tb_deadline)) {} \
+		(bool)(condition);                                                  \
+	})
+
+#endif /* TIMEBASE_TIMEBASE_H_ */
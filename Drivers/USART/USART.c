@@ -27,10 +27,8 @@
 // volatile  DMA_Flags_Typedef USART8_TX_DMA_Flag;
 
 
-DMA_Config xUSART_RX[6];
-DMA_Config xUSART_TX[6];
-
-int8_t usart_dma_instance_number;
+__NOINIT DMA_Config xUSART_RX[6];
+__NOINIT DMA_Config xUSART_TX[6];
 
 
 USART_Config *__usart_1_config__;
@@ -40,8 +38,6 @@ USART_Config *__usart_4_config__;
 USART_Config *__usart_5_config__;
 USART_Config *__usart_6_config__;
 
-volatile uint16_t USART_SR = 0;
-
 volatile bool U1TX_Complete = 0;
 volatile bool U1RX_Complete = 0;
 
@@ -60,52 +56,113 @@ volatile bool U5RX_Complete = 0;
 volatile bool U6TX_Complete = 0;
 volatile bool U6RX_Complete = 0;
 
+static volatile bool *const usart_tx_complete[6] = {
+	&U1TX_Complete, &U2TX_Complete, &U3TX_Complete,
+	&U4TX_Complete, &U5TX_Complete, &U6TX_Complete,
+};
+
+static void USART_TX_Queue_Service(USART_Config *config);
+
 void USART1_TX_ISR() {
 	U1TX_Complete = 1;
+	if (__usart_1_config__ && __usart_1_config__->ISR_Routines.TX_DMA_Complete_ISR) {
+		__usart_1_config__->ISR_Routines.TX_DMA_Complete_ISR();
+	}
+	if (__usart_1_config__ && __usart_1_config__->tx_queue) {
+		USART_TX_Queue_Service(__usart_1_config__);
+	}
 }
 
 void USART1_RX_ISR() {
 	U1RX_Complete = 1;
+	if (__usart_1_config__ && __usart_1_config__->ISR_Routines.RX_DMA_ISR) {
+		__usart_1_config__->ISR_Routines.RX_DMA_ISR();
+	}
 }
 
 void USART2_TX_ISR() {
 	U2TX_Complete = 1;
+	if (__usart_2_config__ && __usart_2_config__->ISR_Routines.TX_DMA_Complete_ISR) {
+		__usart_2_config__->ISR_Routines.TX_DMA_Complete_ISR();
+	}
+	if (__usart_2_config__ && __usart_2_config__->tx_queue) {
+		USART_TX_Queue_Service(__usart_2_config__);
+	}
 }
 
 void USART2_RX_ISR() {
 	U2RX_Complete = 1;
+	if (__usart_2_config__ && __usart_2_config__->ISR_Routines.RX_DMA_ISR) {
+		__usart_2_config__->ISR_Routines.RX_DMA_ISR();
+	}
 }
 
 void USART3_TX_ISR() {
 	U3TX_Complete = 1;
+	if (__usart_3_config__ && __usart_3_config__->ISR_Routines.TX_DMA_Complete_ISR) {
+		__usart_3_config__->ISR_Routines.TX_DMA_Complete_ISR();
+	}
+	if (__usart_3_config__ && __usart_3_config__->tx_queue) {
+		USART_TX_Queue_Service(__usart_3_config__);
+	}
 }
 
 void USART3_RX_ISR() {
 	U3RX_Complete = 1;
+	if (__usart_3_config__ && __usart_3_config__->ISR_Routines.RX_DMA_ISR) {
+		__usart_3_config__->ISR_Routines.RX_DMA_ISR();
+	}
 }
 
 void USART4_TX_ISR() {
 	U4TX_Complete = 1;
+	if (__usart_4_config__ && __usart_4_config__->ISR_Routines.TX_DMA_Complete_ISR) {
+		__usart_4_config__->ISR_Routines.TX_DMA_Complete_ISR();
+	}
+	if (__usart_4_config__ && __usart_4_config__->tx_queue) {
+		USART_TX_Queue_Service(__usart_4_config__);
+	}
 }
 
 void USART4_RX_ISR() {
 	U4RX_Complete = 1;
+	if (__usart_4_config__ && __usart_4_config__->ISR_Routines.RX_DMA_ISR) {
+		__usart_4_config__->ISR_Routines.RX_DMA_ISR();
+	}
 }
 
 void USART5_TX_ISR() {
 	U5TX_Complete = 1;
+	if (__usart_5_config__ && __usart_5_config__->ISR_Routines.TX_DMA_Complete_ISR) {
+		__usart_5_config__->ISR_Routines.TX_DMA_Complete_ISR();
+	}
+	if (__usart_5_config__ && __usart_5_config__->tx_queue) {
+		USART_TX_Queue_Service(__usart_5_config__);
+	}
 }
 
 void USART5_RX_ISR() {
 	U5RX_Complete = 1;
+	if (__usart_5_config__ && __usart_5_config__->ISR_Routines.RX_DMA_ISR) {
+		__usart_5_config__->ISR_Routines.RX_DMA_ISR();
+	}
 }
 
 void USART6_TX_ISR() {
 	U6TX_Complete = 1;
+	if (__usart_6_config__ && __usart_6_config__->ISR_Routines.TX_DMA_Complete_ISR) {
+		__usart_6_config__->ISR_Routines.TX_DMA_Complete_ISR();
+	}
+	if (__usart_6_config__ && __usart_6_config__->tx_queue) {
+		USART_TX_Queue_Service(__usart_6_config__);
+	}
 }
 
 void USART6_RX_ISR() {
 	U6RX_Complete = 1;
+	if (__usart_6_config__ && __usart_6_config__->ISR_Routines.RX_DMA_ISR) {
+		__usart_6_config__->ISR_Routines.RX_DMA_ISR();
+	}
 }
 
 
@@ -113,7 +170,7 @@ void USART6_RX_ISR() {
 
 void UART4_IRQHandler(void)
 {
-	USART_SR = UART4 -> SR;
+	uint16_t USART_SR = UART4 -> SR;   // per call, the handlers may nest
 	if(USART_SR & USART_SR_CTS)
 	{
 		if (__usart_4_config__ ->ISR_Routines.CTS_ISR) {
@@ -177,7 +234,7 @@ void UART4_IRQHandler(void)
 
 void USART1_IRQHandler(void)
 {
-	USART_SR = USART1 -> SR;
+	uint16_t USART_SR = USART1 -> SR;   // per call, the handlers may nest
 	if(USART_SR & USART_SR_CTS)
 	{
 		if (__usart_1_config__ ->ISR_Routines.CTS_ISR) {
@@ -519,6 +576,7 @@ static void PIN_Setup(USART_Config *config)
 	}
 	else if(config->Port == USART6)
 	{
+		__usart_6_config__ = config;
 		if((config->mode == USART_Configuration.Mode.Asynchronous) ||
 				(config->mode == USART_Configuration.Mode.Synchronous) ||
 				(config->mode == USART_Configuration.Mode.IrDA) ||
@@ -542,17 +600,9 @@ static void PIN_Setup(USART_Config *config)
 }
 
 
-int8_t USART_Init(USART_Config *config)
+/* Recomputes BRR from config->baudrate and the current APB clock, call again after a clock switch */
+void USART_Set_Baudrate(USART_Config *config)
 {
-	USART_Clock_Enable(config);
-	PIN_Setup(config);
-
-	usart_dma_instance_number = USART_Get_Instance_Number(config);
-	if(usart_dma_instance_number == -1) return -1;
-
-	//	USART1 -> CR1 |= USART_CR1_UE;
-
-
 	double brr;
 	double div_frac, mantissa;
 	int div_frac_1;
@@ -577,6 +627,24 @@ int8_t USART_Init(USART_Config *config)
 	}
 
 	config->Port->BRR = (mantissa_1<<4)|(div_frac_1);
+}
+
+int8_t USART_Init(USART_Config *config)
+{
+	USART_Clock_Enable(config);
+	PIN_Setup(config);
+
+	int8_t instance = USART_Get_Instance_Number(config);
+	if(instance == -1) return -1;
+
+	/* The DMA slots live in .noinit, start from a clean configuration */
+	memset(&xUSART_RX[instance], 0, sizeof(DMA_Config));
+	memset(&xUSART_TX[instance], 0, sizeof(DMA_Config));
+
+	//	USART1 -> CR1 |= USART_CR1_UE;
+
+
+	USART_Set_Baudrate(config);
 	config->Port->CR1 |= config->parity ;
 
 	if(config -> interrupt == USART_Configuration.Interrupt_Type.Disable)
@@ -694,17 +762,24 @@ int8_t USART_Init(USART_Config *config)
 			xUSART_RX[5].ISR_Routines.Full_Transfer_Commplete_ISR = USART6_RX_ISR;
 		}
 
-		xUSART_RX[usart_dma_instance_number].circular_mode = DMA_Configuration.Circular_Mode.Disable;
-		xUSART_RX[usart_dma_instance_number].flow_control = DMA_Configuration.Flow_Control.DMA_Control;
+		// Circular reception drained by the caller: report every half of the buffer
+		if(config->ISR_Routines.RX_DMA_ISR)
+		{
+			xUSART_RX[instance].interrupts |= DMA_Configuration.DMA_Interrupts.Half_Transfer_Complete;
+			xUSART_RX[instance].ISR_Routines.Half_Transfer_Complete_ISR = xUSART_RX[instance].ISR_Routines.Full_Transfer_Commplete_ISR;
+		}
 
-		xUSART_RX[usart_dma_instance_number].memory_data_size = DMA_Configuration.Memory_Data_Size.byte;
-		xUSART_RX[usart_dma_instance_number].peripheral_data_size = DMA_Configuration.Peripheral_Data_Size.byte;
-		xUSART_RX[usart_dma_instance_number].peripheral_pointer_increment = DMA_Configuration.Peripheral_Pointer_Increment.Disable;
-		xUSART_RX[usart_dma_instance_number].memory_pointer_increment = DMA_Configuration.Memory_Pointer_Increment.Enable;
-		xUSART_RX[usart_dma_instance_number].priority_level = DMA_Configuration.Priority_Level.High;
-		xUSART_RX[usart_dma_instance_number].transfer_direction = DMA_Configuration.Transfer_Direction.Peripheral_to_memory;
-		config ->USART_DMA_Instance_RX = xUSART_RX[usart_dma_instance_number];
-		DMA_Init(&xUSART_RX[usart_dma_instance_number]);
+		xUSART_RX[instance].circular_mode = DMA_Configuration.Circular_Mode.Disable;
+		xUSART_RX[instance].flow_control = DMA_Configuration.Flow_Control.DMA_Control;
+
+		xUSART_RX[instance].memory_data_size = DMA_Configuration.Memory_Data_Size.byte;
+		xUSART_RX[instance].peripheral_data_size = DMA_Configuration.Peripheral_Data_Size.byte;
+		xUSART_RX[instance].peripheral_pointer_increment = DMA_Configuration.Peripheral_Pointer_Increment.Disable;
+		xUSART_RX[instance].memory_pointer_increment = DMA_Configuration.Memory_Pointer_Increment.Enable;
+		xUSART_RX[instance].priority_level = DMA_Configuration.Priority_Level.High;
+		xUSART_RX[instance].transfer_direction = DMA_Configuration.Transfer_Direction.Peripheral_to_memory;
+		config ->USART_DMA_Instance_RX = xUSART_RX[instance];
+		DMA_Init(&xUSART_RX[instance]);
 	}
 	else
 	{
@@ -753,17 +828,17 @@ int8_t USART_Init(USART_Config *config)
 			xUSART_TX[5].ISR_Routines.Full_Transfer_Commplete_ISR = USART6_TX_ISR;
 		}
 
-		xUSART_TX[usart_dma_instance_number].circular_mode = DMA_Configuration.Circular_Mode.Disable;
-		xUSART_TX[usart_dma_instance_number].flow_control = DMA_Configuration.Flow_Control.DMA_Control;
-		xUSART_TX[usart_dma_instance_number].interrupts = DMA_Configuration.DMA_Interrupts.Transfer_Complete;
-		xUSART_TX[usart_dma_instance_number].memory_data_size = DMA_Configuration.Memory_Data_Size.byte;
-		xUSART_TX[usart_dma_instance_number].peripheral_data_size = DMA_Configuration.Peripheral_Data_Size.byte;
-		xUSART_TX[usart_dma_instance_number].peripheral_pointer_increment = DMA_Configuration.Peripheral_Pointer_Increment.Disable;
-		xUSART_TX[usart_dma_instance_number].memory_pointer_increment = DMA_Configuration.Memory_Pointer_Increment.Enable;
-		xUSART_TX[usart_dma_instance_number].priority_level = DMA_Configuration.Priority_Level.Very_high;
-		xUSART_TX[usart_dma_instance_number].transfer_direction = DMA_Configuration.Transfer_Direction.Memory_to_peripheral;
-		config ->USART_DMA_Instance_TX = xUSART_TX[usart_dma_instance_number];
-		DMA_Init(&xUSART_TX[usart_dma_instance_number]);
+		xUSART_TX[instance].circular_mode = DMA_Configuration.Circular_Mode.Disable;
+		xUSART_TX[instance].flow_control = DMA_Configuration.Flow_Control.DMA_Control;
+		xUSART_TX[instance].interrupts = DMA_Configuration.DMA_Interrupts.Transfer_Complete;
+		xUSART_TX[instance].memory_data_size = DMA_Configuration.Memory_Data_Size.byte;
+		xUSART_TX[instance].peripheral_data_size = DMA_Configuration.Peripheral_Data_Size.byte;
+		xUSART_TX[instance].peripheral_pointer_increment = DMA_Configuration.Peripheral_Pointer_Increment.Disable;
+		xUSART_TX[instance].memory_pointer_increment = DMA_Configuration.Memory_Pointer_Increment.Enable;
+		xUSART_TX[instance].priority_level = DMA_Configuration.Priority_Level.Very_high;
+		xUSART_TX[instance].transfer_direction = DMA_Configuration.Transfer_Direction.Memory_to_peripheral;
+		config ->USART_DMA_Instance_TX = xUSART_TX[instance];
+		DMA_Init(&xUSART_TX[instance]);
 	}
 	else
 	{
@@ -780,48 +855,63 @@ int8_t USART_Init(USART_Config *config)
 	return 1;
 }
 
+// Twice the wire time of length 10-bit frames plus USART_WAIT_MARGIN_US
+static uint32_t USART_Transfer_Timeout_us(USART_Config *config, uint32_t length)
+{
+	uint32_t baudrate = (config->baudrate == 0U) ? 1U : config->baudrate;
+	uint64_t wire_us = ((uint64_t)length * 10U * 1000000U) / baudrate;
+	return (uint32_t)(wire_us * 2U) + USART_WAIT_MARGIN_US;
+}
+
+// Waits for a DMA complete flag set by the USARTx_TX/RX_ISR, returns -1 on timeout
+static int8_t USART_Wait_Complete(volatile bool *complete, uint32_t timeout_us)
+{
+	bool done = Timebase_Wait_Until(*complete, timeout_us);
+	*complete = 0;
+	return done ? 1 : -1;
+}
+
 int8_t USART_TX_Buffer(USART_Config *config, uint8_t *tx_buffer, uint16_t length)
 {
-	usart_dma_instance_number = USART_Get_Instance_Number(config);
+	int8_t status = 1;
+	uint32_t timeout_us = USART_Transfer_Timeout_us(config, length);
+
+	int8_t instance = USART_Get_Instance_Number(config);
+	if(instance == -1) return -1;
 	if(config->dma_enable |= USART_Configuration.DMA_Enable.TX_Enable){
 		config -> Port -> SR &= ~USART_SR_TC;
-		xUSART_TX[usart_dma_instance_number].memory_address = (uint32_t)tx_buffer;
-		xUSART_TX[usart_dma_instance_number].peripheral_address = (uint32_t)&config->Port->DR;
-		xUSART_TX[usart_dma_instance_number].buffer_length = length;
-		DMA_Set_Target(&xUSART_TX[usart_dma_instance_number]);
-		DMA_Set_Trigger(&xUSART_TX[usart_dma_instance_number]);
+		xUSART_TX[instance].memory_address = (uint32_t)tx_buffer;
+		xUSART_TX[instance].peripheral_address = (uint32_t)&config->Port->DR;
+		xUSART_TX[instance].buffer_length = length;
+		*usart_tx_complete[instance] = 0;
+		DMA_Set_Target(&xUSART_TX[instance]);
+		DMA_Set_Trigger(&xUSART_TX[instance]);
 		config -> Port  -> CR3 |= USART_CR3_DMAT;
 
 		if(config->Port == USART1)
 		{
-			while(!U1TX_Complete){}
-			U1TX_Complete = 0;
+			status = USART_Wait_Complete(&U1TX_Complete, timeout_us);
 
 		}
 		else if(config->Port == USART2)
 		{
-			while(!U2TX_Complete){}
-			U2TX_Complete = 0;
+			status = USART_Wait_Complete(&U2TX_Complete, timeout_us);
 		}
 		else if(config->Port == USART3)
 		{
-			while(!U3TX_Complete){}
-			U3TX_Complete = 0;
+			status = USART_Wait_Complete(&U3TX_Complete, timeout_us);
 		}
 		else if(config->Port == UART4)
 		{
-			while(!U4TX_Complete){}
-			U4TX_Complete = 0;
+			status = USART_Wait_Complete(&U4TX_Complete, timeout_us);
 		}
 		else if(config->Port == UART5)
 		{
-			while(!U5TX_Complete){}
-			U5TX_Complete = 0;
+			status = USART_Wait_Complete(&U5TX_Complete, timeout_us);
 		}
 		else if(config->Port == USART6)
 		{
-			while(!U6TX_Complete){}
-			U6TX_Complete = 0;
+			status = USART_Wait_Complete(&U6TX_Complete, timeout_us);
 		}
 
 
@@ -831,68 +921,189 @@ int8_t USART_TX_Buffer(USART_Config *config, uint8_t *tx_buffer, uint16_t length
 		for(int i = 0; i <= length; i++)
 		{
 			config->Port->DR = tx_buffer[i];
-			while(!(config->Port->SR & USART_SR_TXE));
+			if(!Timebase_Wait_Until(config->Port->SR & USART_SR_TXE, USART_Transfer_Timeout_us(config, 1))) return -1;
 		}
 	}
 
+	return status;
+
+}
+
+/*
+ * Starts a DMA transmit and returns straight away. Completion is reported by
+ * ISR_Routines.TX_DMA_Complete_ISR and USART_TX_Busy(); tx_buffer must stay
+ * untouched until then.
+ */
+// Also called from the TX DMA interrupt; everything it touches belongs to instance
+static void USART_TX_DMA_Start(USART_Config *config, int8_t instance, const uint8_t *tx_buffer, uint16_t length)
+{
+	config -> Port -> SR &= ~USART_SR_TC;
+	xUSART_TX[instance].memory_address = (uint32_t)tx_buffer;
+	xUSART_TX[instance].peripheral_address = (uint32_t)&config->Port->DR;
+	xUSART_TX[instance].buffer_length = length;
+	*usart_tx_complete[instance] = 0;
+	DMA_Set_Target(&xUSART_TX[instance]);
+	DMA_Set_Trigger(&xUSART_TX[instance]);
+	config -> Port  -> CR3 |= USART_CR3_DMAT;
+}
+
+int8_t USART_TX_Buffer_Start(USART_Config *config, uint8_t *tx_buffer, uint16_t length)
+{
+	int8_t instance = USART_Get_Instance_Number(config);
+	if(instance == -1) return -1;
+	if((config->dma_enable & USART_Configuration.DMA_Enable.TX_Enable) != USART_Configuration.DMA_Enable.TX_Enable) return -1;
+
+	USART_TX_DMA_Start(config, instance, tx_buffer, length);
+
+	return 1;
+}
+
+// True while a transmit started by USART_TX_Buffer_Start() is running or queued frames are pending
+bool USART_TX_Busy(USART_Config *config)
+{
+	int8_t instance = USART_Get_Instance_Number(config);
+	if(instance == -1) return false;
+
+	if(config->tx_queue && (config->tx_queue->head != config->tx_queue->tail)) return true;
+
+	return (*usart_tx_complete[instance] == 0) && (xUSART_TX[instance].Request.Stream->CR & DMA_SxCR_EN);
+}
+
+/*
+ * Queues a DMA transmit and returns, -1 when the queue is full. The first
+ * frame starts immediately, the rest start from the TX DMA interrupt.
+ * data must stay valid until complete has been called.
+ */
+int8_t USART_TX_Enqueue(USART_Config *config, const uint8_t *data, uint16_t length, void (*complete)(void *context), void *context)
+{
+	USART_TX_Queue *queue = config->tx_queue;
+	int8_t instance = USART_Get_Instance_Number(config);
+	if((queue == NULL) || (instance == -1)) return -1;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint8_t head = queue->head;
+	if((uint8_t)(head - queue->tail) >= USART_TX_QUEUE_LENGTH)
+	{
+		__set_PRIMASK(primask);
+		return -1;
+	}
+
+	USART_TX_Descriptor *slot = &queue->slots[head & (USART_TX_QUEUE_LENGTH - 1U)];
+	slot->data = data;
+	slot->length = length;
+	slot->complete = complete;
+	slot->context = context;
+	queue->head = head + 1U;
+
+	// Queue was idle: this frame goes out now
+	if(head == queue->tail)
+	{
+		USART_TX_DMA_Start(config, instance, data, length);
+	}
+
+	__set_PRIMASK(primask);
 	return 1;
+}
+
+// TX DMA complete: retire the frame just sent and start the next one
+static void USART_TX_Queue_Service(USART_Config *config)
+{
+	USART_TX_Queue *queue = config->tx_queue;
+	if(queue->head == queue->tail) return;  // transfer was not started by the queue
+
+	USART_TX_Descriptor done = queue->slots[queue->tail & (USART_TX_QUEUE_LENGTH - 1U)];
+	queue->tail++;
+
+	if(queue->head != queue->tail)
+	{
+		USART_TX_Descriptor *next = &queue->slots[queue->tail & (USART_TX_QUEUE_LENGTH - 1U)];
+		USART_TX_DMA_Start(config, USART_Get_Instance_Number(config), next->data, next->length);
+	}
+
+	if(done.complete) done.complete(done.context);
+}
+
+// Arms a DMA receive into rx_buffer and returns straight away, same circular_buffer_enable meaning as USART_RX_Buffer()
+int8_t USART_RX_Buffer_Start(USART_Config *config, uint8_t *rx_buffer, uint16_t length, bool circular_buffer_enable)
+{
+	int8_t instance = USART_Get_Instance_Number(config);
+	if(instance == -1) return -1;
+	if((config->dma_enable & USART_Configuration.DMA_Enable.RX_Enable) != USART_Configuration.DMA_Enable.RX_Enable) return -1;
 
+	if(circular_buffer_enable == 1)
+	{
+		xUSART_RX[instance].circular_mode = DMA_Configuration.Circular_Mode.Disable;
+	}
+	else
+	{
+		xUSART_RX[instance].circular_mode = DMA_Configuration.Circular_Mode.Enable;
+	}
+
+	xUSART_RX[instance].memory_address = (uint32_t)rx_buffer;
+	xUSART_RX[instance].peripheral_address = (uint32_t)&config->Port->DR;
+	xUSART_RX[instance].buffer_length = length;
+	DMA_Set_Target(&xUSART_RX[instance]);
+	DMA_Set_Trigger(&xUSART_RX[instance]);
+	config -> Port -> CR3 |= USART_CR3_DMAR;
+
+	return 1;
 }
 
 int8_t USART_RX_Buffer(USART_Config *config, uint8_t *rx_buffer, uint16_t length, bool circular_buffer_enable)
 {
+	int8_t status = 1;
+	uint32_t timeout_us = USART_Transfer_Timeout_us(config, length);
+	int8_t instance = USART_Get_Instance_Number(config);
+	if(instance == -1) return -1;
+
 	if(config->dma_enable |= USART_Configuration.DMA_Enable.RX_Enable)
 	{
 		if(circular_buffer_enable == 1)
 		{
-			xUSART_RX[usart_dma_instance_number].circular_mode = DMA_Configuration.Circular_Mode.Disable;
+			xUSART_RX[instance].circular_mode = DMA_Configuration.Circular_Mode.Disable;
 		}
 		else
 		{
-			xUSART_RX[usart_dma_instance_number].circular_mode = DMA_Configuration.Circular_Mode.Enable;
+			xUSART_RX[instance].circular_mode = DMA_Configuration.Circular_Mode.Enable;
 		}
 
-		xUSART_RX[usart_dma_instance_number].memory_address = (uint32_t)rx_buffer;
-		xUSART_RX[usart_dma_instance_number].peripheral_address = (uint32_t)&config->Port->DR;
-		xUSART_RX[usart_dma_instance_number].buffer_length = length;
-		DMA_Set_Target(&xUSART_RX[usart_dma_instance_number]);
-		DMA_Set_Trigger(&xUSART_RX[usart_dma_instance_number]);
+		xUSART_RX[instance].memory_address = (uint32_t)rx_buffer;
+		xUSART_RX[instance].peripheral_address = (uint32_t)&config->Port->DR;
+		xUSART_RX[instance].buffer_length = length;
+		DMA_Set_Target(&xUSART_RX[instance]);
+		DMA_Set_Trigger(&xUSART_RX[instance]);
 		config -> Port -> CR3 |= USART_CR3_DMAR;
 
 		if(config->Port == USART1)
 		{
-			while(!U1RX_Complete){}
-			U1RX_Complete = 0;
+			status = USART_Wait_Complete(&U1RX_Complete, timeout_us);
 
 		}
 		else if(config->Port == USART2)
 		{
-			while(!U2RX_Complete){}
-			U2RX_Complete = 0;
+			status = USART_Wait_Complete(&U2RX_Complete, timeout_us);
 		}
 		else if(config->Port == USART3)
 		{
-			while(!U3RX_Complete){}
-			U3RX_Complete = 0;
+			status = USART_Wait_Complete(&U3RX_Complete, timeout_us);
 		}
 		else if(config->Port == UART4)
 		{
-			while(!U4RX_Complete){}
-			U4RX_Complete = 0;
+			status = USART_Wait_Complete(&U4RX_Complete, timeout_us);
 		}
 		else if(config->Port == UART5)
 		{
-			while(!U5RX_Complete){}
-			U5RX_Complete = 0;
+			status = USART_Wait_Complete(&U5RX_Complete, timeout_us);
 		}
 		else if(config->Port == USART6)
 		{
-			while(!U6RX_Complete){}
-			U6RX_Complete = 0;
+			status = USART_Wait_Complete(&U6RX_Complete, timeout_us);
 		}
 
 //		config -> Port -> CR3 &= ~USART_CR3_DMAR;
-//		DMA_Disable_Target(&xUSART_RX[usart_dma_instance_number]);
+//		DMA_Disable_Target(&xUSART_RX[instance]);
 
 	}
 	else
@@ -900,25 +1111,25 @@ int8_t USART_RX_Buffer(USART_Config *config, uint8_t *rx_buffer, uint16_t length
 		for(int i = 0; i <= length; i++)
 		{
 			rx_buffer[i] = config->Port->DR ;
-			while(!(config->Port->SR & USART_SR_RXNE));
+			if(!Timebase_Wait_Until(config->Port->SR & USART_SR_RXNE, USART_Transfer_Timeout_us(config, 1))) return -1;
 		}
 	}
 
-	return 1;
+	return status;
 
 }
 
 void USART_TX_Single_Byte(USART_Config *config, uint8_t data)
 {
 	config->Port->DR = data;
-	while(!(config->Port->SR & USART_SR_TXE));
+	Timebase_Wait_Until(config->Port->SR & USART_SR_TXE, USART_Transfer_Timeout_us(config, 1));
 }
 
 uint16_t USART_RX_Single_Byte(USART_Config *config)
 {
 	uint8_t data;
 	data = config->Port->DR ;
-	while(!(config->Port->SR & USART_SR_RXNE));
+	Timebase_Wait_Until(config->Port->SR & USART_SR_RXNE, USART_Transfer_Timeout_us(config, 1));
 	return data;
 }
 
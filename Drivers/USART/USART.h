@@ -13,6 +13,27 @@
 #include "GPIO/GPIO.h"
 #include "USART_Defs.h"
 #include "DMA/DMA.h"
+#include "Timebase/Timebase.h"
+
+#define USART_WAIT_MARGIN_US     2000U   // added to the wire time of every bounded wait
+#define USART_TX_QUEUE_LENGTH    8U      // power of two, a gathered frame takes up to 3
+
+/* One pending DMA transmit; complete runs from the DMA TC interrupt once data has been sent */
+typedef struct USART_TX_Descriptor
+{
+	const uint8_t *data;
+	uint16_t length;
+	void (*complete)(void *context);
+	void *context;
+}USART_TX_Descriptor;
+
+/* Caller-owned storage for USART_TX_Enqueue(), attach with config->tx_queue */
+typedef struct USART_TX_Queue
+{
+	USART_TX_Descriptor slots[USART_TX_QUEUE_LENGTH];
+	volatile uint8_t head;      // next free slot
+	volatile uint8_t tail;      // slot being sent while head != tail
+}USART_TX_Queue;
 
 
 
@@ -33,6 +54,7 @@ typedef struct USART_Config
 	uint8_t parity;
 	DMA_Config USART_DMA_Instance_TX;
 	DMA_Config USART_DMA_Instance_RX;
+	USART_TX_Queue *tx_queue;
 
 	struct __USART_Interrupts__{
 		void (*Parity_ISR)(void);
@@ -43,6 +65,8 @@ typedef struct USART_Config
 		void (*CTS_ISR)(void);
 		void (*Error_ISR)(void);
 		void (*LIN_Break_Detection_ISR)(void);
+		void (*TX_DMA_Complete_ISR)(void);  // after a DMA TX buffer has been handed to the USART
+		void (*RX_DMA_ISR)(void);           // DMA RX half and full transfer, for draining a circular buffer
 	}ISR_Routines;
 }USART_Config;
 
@@ -52,10 +76,15 @@ int8_t USART_Clock_Disable(USART_Config *config);
 void USART_Config_Reset(USART_Config *config);
 int8_t USART_Get_Instance_Number(USART_Config *config);
 int8_t USART_Init(USART_Config *config);
+void USART_Set_Baudrate(USART_Config *config);
 
 void USART_TX_Single_Byte(USART_Config *config, uint8_t data);
 uint16_t USART_RX_Byte(USART_Config *config);
 int8_t USART_TX_Buffer(USART_Config *config, uint8_t *tx_buffer, uint16_t length);
+int8_t USART_TX_Buffer_Start(USART_Config *config, uint8_t *tx_buffer, uint16_t length);
+bool USART_TX_Busy(USART_Config *config);
+int8_t USART_TX_Enqueue(USART_Config *config, const uint8_t *data, uint16_t length, void (*complete)(void *context), void *context);
+int8_t USART_RX_Buffer_Start(USART_Config *config, uint8_t *rx_buffer, uint16_t length, bool circular_buffer_enable);
 int8_t USART_RX_Buffer(USART_Config *config, uint8_t *rx_buffer, uint16_t length, bool circular_buffer_enable);
 void USART_Clear_Status_Regs(USART_Config *config);
 
@@ -0,0 +1,409 @@
+/*
+ * USB.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "USB.h"
+
+#define USB_OTG                     USB_OTG_FS
+#define USB_DEVICE                  ((USB_OTG_DeviceTypeDef *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_DEVICE_BASE))
+#define USB_IN_EP0                  ((USB_OTG_INEndpointTypeDef *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_IN_ENDPOINT_BASE))
+#define USB_OUT_EP0                 ((USB_OTG_OUTEndpointTypeDef *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_OUT_ENDPOINT_BASE))
+#define USB_FIFO0                   (*(volatile uint32_t *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_FIFO_BASE))
+#define USB_PCGCCTL                 (*(volatile uint32_t *)(USB_OTG_FS_PERIPH_BASE + USB_OTG_PCGCCTL_BASE))
+
+#define USB_PKTSTS_OUT_DATA         2U
+#define USB_PKTSTS_SETUP_DATA       6U
+
+#define USB_GET_STATUS              0x00U
+#define USB_CLEAR_FEATURE           0x01U
+#define USB_SET_FEATURE             0x03U
+#define USB_SET_ADDRESS             0x05U
+#define USB_GET_DESCRIPTOR          0x06U
+#define USB_GET_CONFIGURATION       0x08U
+#define USB_SET_CONFIGURATION       0x09U
+#define USB_GET_INTERFACE           0x0AU
+#define USB_SET_INTERFACE           0x0BU
+
+#define USB_DESCRIPTOR_DEVICE       0x01U
+#define USB_DESCRIPTOR_CONFIGURATION 0x02U
+#define USB_DESCRIPTOR_STRING       0x03U
+
+typedef enum USB_EP0_State
+{
+	USB_EP0_IDLE = 0,              // waiting for SETUP
+	USB_EP0_DATA_IN,
+	USB_EP0_DATA_OUT,
+	USB_EP0_STATUS_IN,             // zero length IN after a no-data or OUT request
+	USB_EP0_STATUS_OUT,            // zero length OUT after an IN request
+}USB_EP0_State;
+
+static USB_Config *usb_config;
+static USB_Setup usb_setup;
+static uint32_t usb_setup_packet[2];
+static USB_EP0_State usb_ep0_state;
+
+static const uint8_t *usb_in_data;
+static uint16_t usb_in_left;
+static bool usb_in_zlp;            // data stage shorter than wLength ends on a full packet
+
+static uint8_t *usb_out_data;
+static uint16_t usb_out_length;
+static uint16_t usb_out_count;
+
+static uint8_t usb_configuration;
+static uint8_t usb_reply[2];
+static uint8_t usb_string[2 + 2 * USB_STRING_MAX];
+
+static void USB_Flush_FIFOs(void)
+{
+	USB_OTG->GRSTCTL = USB_OTG_GRSTCTL_TXFFLSH | (0x10U << USB_OTG_GRSTCTL_TXFNUM_Pos);
+	Timebase_Wait_Until((USB_OTG->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH) == 0U, USB_RESET_TIMEOUT_US);
+	USB_OTG->GRSTCTL = USB_OTG_GRSTCTL_RXFFLSH;
+	Timebase_Wait_Until((USB_OTG->GRSTCTL & USB_OTG_GRSTCTL_RXFFLSH) == 0U, USB_RESET_TIMEOUT_US);
+}
+
+// One packet into endpoint 0; SETUP packets are taken regardless
+static void USB_EP0_Out_Arm(void)
+{
+	USB_OUT_EP0->DOEPTSIZ = (3U << USB_OTG_DOEPTSIZ_STUPCNT_Pos) | (1U << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | USB_EP0_SIZE;
+	USB_OUT_EP0->DOEPCTL |= USB_OTG_DOEPCTL_CNAK | USB_OTG_DOEPCTL_EPENA;
+}
+
+static void USB_EP0_Send_Next(void)
+{
+	uint16_t packet = (usb_in_left > USB_EP0_SIZE) ? USB_EP0_SIZE : usb_in_left;
+
+	USB_IN_EP0->DIEPTSIZ = (1U << USB_OTG_DIEPTSIZ_PKTCNT_Pos) | packet;
+	USB_IN_EP0->DIEPCTL |= USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA;
+
+	// Byte wise, the data may be unaligned or in flash
+	for (uint16_t i = 0; i < packet; i += 4U) {
+		uint32_t word = 0;
+		for (uint8_t b = 0; (b < 4U) && ((i + b) < packet); b++) word |= (uint32_t)usb_in_data[i + b] << (8U * b);
+		USB_FIFO0 = word;
+	}
+
+	usb_in_data += packet;
+	usb_in_left -= packet;
+}
+
+static void USB_EP0_Status_In(void)
+{
+	usb_ep0_state = USB_EP0_STATUS_IN;
+	USB_IN_EP0->DIEPTSIZ = (1U << USB_OTG_DIEPTSIZ_PKTCNT_Pos);
+	USB_IN_EP0->DIEPCTL |= USB_OTG_DIEPCTL_CNAK | USB_OTG_DIEPCTL_EPENA;
+}
+
+// Cleared by the core on the next SETUP
+static void USB_EP0_Stall(void)
+{
+	usb_ep0_state = USB_EP0_IDLE;
+	USB_IN_EP0->DIEPCTL |= USB_OTG_DIEPCTL_STALL;
+	USB_OUT_EP0->DOEPCTL |= USB_OTG_DOEPCTL_STALL;
+	USB_EP0_Out_Arm();
+}
+
+static int USB_Get_Descriptor(USB_Transfer *transfer)
+{
+	uint8_t type = usb_setup.wValue >> 8;
+	uint8_t index = usb_setup.wValue & 0xFFU;
+
+	switch (type) {
+	case USB_DESCRIPTOR_DEVICE:
+		transfer->in = usb_config->Device_Descriptor;
+		transfer->length = usb_config->Device_Descriptor[0];
+		return 0;
+
+	case USB_DESCRIPTOR_CONFIGURATION:
+		transfer->in = usb_config->Configuration_Descriptor;
+		transfer->length = usb_config->Configuration_Descriptor[2] | ((uint16_t)usb_config->Configuration_Descriptor[3] << 8);
+		return 0;
+
+	case USB_DESCRIPTOR_STRING:
+		if (index == 0U) {
+			usb_string[2] = 0x09;          // LANGID 0x0409, English (US)
+			usb_string[3] = 0x04;
+			usb_string[0] = 4;
+		} else if ((index <= usb_config->String_Count) && (usb_config->Strings[index - 1U] != NULL)) {
+			const char *text = usb_config->Strings[index - 1U];
+			uint8_t length = 0;
+			while ((length < USB_STRING_MAX) && (text[length] != '\0')) {
+				usb_string[2U + 2U * length] = (uint8_t)text[length];
+				usb_string[3U + 2U * length] = 0;
+				length++;
+			}
+			usb_string[0] = 2U + 2U * length;
+		} else {
+			return -1;
+		}
+		usb_string[1] = USB_DESCRIPTOR_STRING;
+		transfer->in = usb_string;
+		transfer->length = usb_string[0];
+		return 0;
+
+	default:
+		// Device qualifier and the like: full speed only
+		return -1;
+	}
+}
+
+static int USB_Standard_Request(USB_Transfer *transfer)
+{
+	switch (usb_setup.bRequest) {
+	case USB_GET_STATUS:
+		usb_reply[0] = 0;
+		usb_reply[1] = 0;
+		transfer->in = usb_reply;
+		transfer->length = 2;
+		return 0;
+
+	case USB_CLEAR_FEATURE:
+	case USB_SET_FEATURE:
+		return 0;
+
+	case USB_SET_ADDRESS:
+		// This core takes the new address before the status stage
+		USB_DEVICE->DCFG = (USB_DEVICE->DCFG & ~USB_OTG_DCFG_DAD) | ((usb_setup.wValue & 0x7FU) << USB_OTG_DCFG_DAD_Pos);
+		return 0;
+
+	case USB_GET_DESCRIPTOR:
+		return USB_Get_Descriptor(transfer);
+
+	case USB_GET_CONFIGURATION:
+		usb_reply[0] = usb_configuration;
+		transfer->in = usb_reply;
+		transfer->length = 1;
+		return 0;
+
+	case USB_SET_CONFIGURATION:
+		if (usb_setup.wValue > 1U) return -1;
+		usb_configuration = usb_setup.wValue;
+		return 0;
+
+	case USB_GET_INTERFACE:
+		usb_reply[0] = 0;
+		transfer->in = usb_reply;
+		transfer->length = 1;
+		return 0;
+
+	case USB_SET_INTERFACE:
+		return (usb_setup.wValue == 0U) ? 0 : -1;
+
+	default:
+		return -1;
+	}
+}
+
+static void USB_Setup_Stage(void)
+{
+	USB_Transfer transfer = {NULL, NULL, 0};
+	int status;
+
+	usb_setup.bmRequestType = usb_setup_packet[0] & 0xFFU;
+	usb_setup.bRequest = (usb_setup_packet[0] >> 8) & 0xFFU;
+	usb_setup.wValue = usb_setup_packet[0] >> 16;
+	usb_setup.wIndex = usb_setup_packet[1] & 0xFFFFU;
+	usb_setup.wLength = usb_setup_packet[1] >> 16;
+
+	if ((usb_setup.bmRequestType & USB_REQUEST_TYPE_MASK) == USB_REQUEST_TYPE_STANDARD)
+		status = USB_Standard_Request(&transfer);
+	else if (usb_config->ISR_Routines.Setup_ISR != NULL)
+		status = usb_config->ISR_Routines.Setup_ISR(&usb_setup, &transfer);
+	else
+		status = -1;
+
+	if (status < 0) {
+		USB_EP0_Stall();
+		return;
+	}
+
+	if (usb_setup.wLength == 0U) {
+		USB_EP0_Status_In();
+		return;
+	}
+
+	if (usb_setup.bmRequestType & USB_REQUEST_DIRECTION_IN) {
+		if (transfer.length > usb_setup.wLength) transfer.length = usb_setup.wLength;
+		usb_in_data = transfer.in;
+		usb_in_left = transfer.length;
+		usb_in_zlp = (transfer.length != 0U) && (transfer.length < usb_setup.wLength) && ((transfer.length % USB_EP0_SIZE) == 0U);
+		usb_ep0_state = USB_EP0_DATA_IN;
+		USB_EP0_Send_Next();
+		return;
+	}
+
+	if (transfer.out == NULL) {
+		USB_EP0_Stall();
+		return;
+	}
+
+	usb_out_data = transfer.out;
+	usb_out_length = usb_setup.wLength;
+	usb_out_count = 0;
+	usb_ep0_state = USB_EP0_DATA_OUT;
+	USB_EP0_Out_Arm();
+}
+
+static void USB_RX_Level_ISR(void)
+{
+	uint32_t status = USB_OTG->GRXSTSP;
+	uint16_t count = (status & USB_OTG_GRXSTSP_BCNT) >> USB_OTG_GRXSTSP_BCNT_Pos;
+	uint8_t packet_status = (status & USB_OTG_GRXSTSP_PKTSTS) >> USB_OTG_GRXSTSP_PKTSTS_Pos;
+
+	if ((status & USB_OTG_GRXSTSP_EPNUM) != 0U) packet_status = 0;   // no other endpoint is enabled
+
+	if (packet_status == USB_PKTSTS_SETUP_DATA) {
+		usb_setup_packet[0] = USB_FIFO0;
+		usb_setup_packet[1] = USB_FIFO0;
+		return;
+	}
+
+	// Popped whole words; bytes beyond the expected data stage are dropped
+	for (uint16_t i = 0; i < count; i += 4U) {
+		uint32_t word = USB_FIFO0;
+		if (packet_status != USB_PKTSTS_OUT_DATA) continue;
+		for (uint8_t b = 0; (b < 4U) && ((i + b) < count); b++) {
+			if ((usb_ep0_state == USB_EP0_DATA_OUT) && (usb_out_count < usb_out_length))
+				usb_out_data[usb_out_count++] = word >> (8U * b);
+		}
+	}
+}
+
+static void USB_EP0_Out_ISR(void)
+{
+	uint32_t flags = USB_OUT_EP0->DOEPINT;
+	USB_OUT_EP0->DOEPINT = flags;
+
+	if (flags & USB_OTG_DOEPINT_XFRC) {
+		if (usb_ep0_state == USB_EP0_DATA_OUT) {
+			if (usb_out_count < usb_out_length) {
+				USB_EP0_Out_Arm();
+			} else if ((usb_config->ISR_Routines.Data_Out_ISR != NULL) &&
+					(usb_config->ISR_Routines.Data_Out_ISR(&usb_setup, usb_out_count) < 0)) {
+				USB_EP0_Stall();
+			} else {
+				USB_EP0_Status_In();
+			}
+		} else if (usb_ep0_state == USB_EP0_STATUS_OUT) {
+			usb_ep0_state = USB_EP0_IDLE;
+			USB_EP0_Out_Arm();
+			if (usb_config->ISR_Routines.Status_Done_ISR != NULL) usb_config->ISR_Routines.Status_Done_ISR(&usb_setup);
+		}
+	}
+
+	if (flags & USB_OTG_DOEPINT_STUP) USB_Setup_Stage();
+}
+
+static void USB_EP0_In_ISR(void)
+{
+	uint32_t flags = USB_IN_EP0->DIEPINT;
+	USB_IN_EP0->DIEPINT = flags;
+
+	if ((flags & USB_OTG_DIEPINT_XFRC) == 0U) return;
+
+	if (usb_ep0_state == USB_EP0_DATA_IN) {
+		if (usb_in_left != 0U) {
+			USB_EP0_Send_Next();
+		} else if (usb_in_zlp) {
+			usb_in_zlp = false;
+			USB_EP0_Send_Next();
+		} else {
+			usb_ep0_state = USB_EP0_STATUS_OUT;
+			USB_EP0_Out_Arm();
+		}
+	} else if (usb_ep0_state == USB_EP0_STATUS_IN) {
+		usb_ep0_state = USB_EP0_IDLE;
+		USB_EP0_Out_Arm();
+		if (usb_config->ISR_Routines.Status_Done_ISR != NULL) usb_config->ISR_Routines.Status_Done_ISR(&usb_setup);
+	}
+}
+
+static void USB_Bus_Reset_ISR(void)
+{
+	USB_DEVICE->DCTL &= ~USB_OTG_DCTL_RWUSIG;
+	USB_Flush_FIFOs();
+
+	USB_IN_EP0->DIEPINT = 0xFFFFFFFFU;
+	USB_OUT_EP0->DOEPINT = 0xFFFFFFFFU;
+	USB_DEVICE->DAINTMSK = (1U << 0) | (1U << 16);     // IN0, OUT0
+	USB_DEVICE->DOEPMSK = USB_OTG_DOEPMSK_STUPM | USB_OTG_DOEPMSK_XFRCM;
+	USB_DEVICE->DIEPMSK = USB_OTG_DIEPMSK_XFRCM;
+	USB_DEVICE->DCFG &= ~USB_OTG_DCFG_DAD;
+
+	usb_configuration = 0;
+	usb_ep0_state = USB_EP0_IDLE;
+	USB_EP0_Out_Arm();
+
+	if (usb_config->ISR_Routines.Reset_ISR != NULL) usb_config->ISR_Routines.Reset_ISR();
+}
+
+/*
+ * Resets the core into device mode, sizes the FIFOs and connects the D+
+ * pull-up. Returns -1 if the core does not come out of reset.
+ */
+int8_t USB_Init(USB_Config *config)
+{
+	usb_config = config;
+
+	RCC -> AHB2ENR |= RCC_AHB2ENR_OTGFSEN;
+	GPIO_Pin_Init(GPIOA, 11, GPIO_Configuration.Mode.Alternate_Function, GPIO_Configuration.Output_Type.Push_Pull, GPIO_Configuration.Speed.Very_High_Speed, GPIO_Configuration.Pull.No_Pull_Up_Down, GPIO_Configuration.Alternate_Functions.OTG_FS_1);
+	GPIO_Pin_Init(GPIOA, 12, GPIO_Configuration.Mode.Alternate_Function, GPIO_Configuration.Output_Type.Push_Pull, GPIO_Configuration.Speed.Very_High_Speed, GPIO_Configuration.Pull.No_Pull_Up_Down, GPIO_Configuration.Alternate_Functions.OTG_FS_1);
+
+	if (!Timebase_Wait_Until((USB_OTG->GRSTCTL & USB_OTG_GRSTCTL_AHBIDL) != 0U, USB_RESET_TIMEOUT_US)) return -1;
+	USB_OTG->GRSTCTL |= USB_OTG_GRSTCTL_CSRST;
+	if (!Timebase_Wait_Until((USB_OTG->GRSTCTL & USB_OTG_GRSTCTL_CSRST) == 0U, USB_RESET_TIMEOUT_US)) return -1;
+
+	// Turnaround 6 for an AHB clock well above 32 MHz; the forced mode takes 25 ms
+	USB_OTG->GUSBCFG = (USB_OTG->GUSBCFG & ~USB_OTG_GUSBCFG_TRDT) | USB_OTG_GUSBCFG_FDMOD |
+			USB_OTG_GUSBCFG_PHYSEL | (6U << USB_OTG_GUSBCFG_TRDT_Pos);
+	Timebase_Delay_us(25000U);
+
+	USB_DEVICE->DCTL |= USB_OTG_DCTL_SDIS;
+	USB_OTG->GCCFG = USB_OTG_GCCFG_PWRDWN | USB_OTG_GCCFG_NOVBUSSENS;
+	USB_PCGCCTL = 0;
+	USB_DEVICE->DCFG |= USB_OTG_DCFG_DSPD;
+
+	USB_OTG->GRXFSIZ = USB_RX_FIFO_WORDS;
+	USB_OTG->DIEPTXF0_HNPTXFSIZ = (USB_TX0_FIFO_WORDS << 16) | USB_RX_FIFO_WORDS;
+	USB_Flush_FIFOs();
+
+	USB_OTG->GINTSTS = 0xFFFFFFFFU;
+	USB_OTG->GINTMSK = USB_OTG_GINTMSK_USBRST | USB_OTG_GINTMSK_ENUMDNEM | USB_OTG_GINTMSK_RXFLVLM |
+			USB_OTG_GINTMSK_IEPINT | USB_OTG_GINTMSK_OEPINT;
+	USB_OTG->GAHBCFG |= USB_OTG_GAHBCFG_GINT;
+
+	NVIC_SetPriority(OTG_FS_IRQn, 2);
+	NVIC_EnableIRQ(OTG_FS_IRQn);
+
+	USB_DEVICE->DCTL &= ~USB_OTG_DCTL_SDIS;
+	return 1;
+}
+
+// Drops the D+ pull-up, the host sees the device unplugged
+void USB_Disconnect(void)
+{
+	USB_DEVICE->DCTL |= USB_OTG_DCTL_SDIS;
+}
+
+void OTG_FS_IRQHandler(void)
+{
+	uint32_t status = USB_OTG->GINTSTS & USB_OTG->GINTMSK;
+
+	if (status & USB_OTG_GINTSTS_USBRST) {
+		USB_OTG->GINTSTS = USB_OTG_GINTSTS_USBRST;
+		USB_Bus_Reset_ISR();
+	}
+
+	if (status & USB_OTG_GINTSTS_ENUMDNE) {
+		USB_OTG->GINTSTS = USB_OTG_GINTSTS_ENUMDNE;
+		USB_IN_EP0->DIEPCTL &= ~USB_OTG_DIEPCTL_MPSIZ;    // 64 bytes
+		USB_DEVICE->DCTL |= USB_OTG_DCTL_CGINAK;
+	}
+
+	while (USB_OTG->GINTSTS & USB_OTG_GINTSTS_RXFLVL) USB_RX_Level_ISR();
+
+	if (status & USB_OTG_GINTSTS_OEPINT) USB_EP0_Out_ISR();
+	if (status & USB_OTG_GINTSTS_IEPINT) USB_EP0_In_ISR();
+}
@@ -0,0 +1,71 @@
+/*
+ * USB.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef USB_USB_H_
+#define USB_USB_H_
+
+#include "main.h"
+#include "GPIO/GPIO.h"
+#include "Timebase/Timebase.h"
+
+/*
+ * OTG FS as a full speed device on PA11/PA12 with the internal PHY, no VBUS
+ * sensing. Control endpoint 0 only: standard requests are answered here,
+ * class and vendor requests go to ISR_Routines. Needs the 48 MHz PLLQ clock.
+ */
+
+#define USB_EP0_SIZE                64U
+#define USB_RX_FIFO_WORDS           128U     // shared receive FIFO, SETUP and OUT packets
+#define USB_TX0_FIFO_WORDS          64U      // endpoint 0 transmit FIFO
+#define USB_STRING_MAX              32U      // characters per string descriptor
+#define USB_RESET_TIMEOUT_US        10000U
+
+#define USB_REQUEST_DIRECTION_IN    0x80U
+#define USB_REQUEST_TYPE_MASK       0x60U
+#define USB_REQUEST_TYPE_STANDARD   0x00U
+#define USB_REQUEST_TYPE_CLASS      0x20U
+
+typedef struct USB_Setup
+{
+	uint8_t bmRequestType;
+	uint8_t bRequest;
+	uint16_t wValue;
+	uint16_t wIndex;
+	uint16_t wLength;
+}USB_Setup;
+
+/* Data stage of a control request: in for device to host, out (wLength bytes) for host to device */
+typedef struct USB_Transfer
+{
+	const uint8_t *in;
+	uint8_t *out;
+	uint16_t length;
+}USB_Transfer;
+
+typedef struct USB_Config
+{
+	const uint8_t *Device_Descriptor;
+	const uint8_t *Configuration_Descriptor;     // wTotalLength is taken from bytes 2 and 3
+	const char * const *Strings;                 // ASCII, string index 1 onwards; LANGID 0x0409 is built in
+	uint8_t String_Count;
+
+	struct __USB_Interrupts__{
+		/* Class and vendor requests; < 0 stalls. Fill transfer for a data stage, it is capped to wLength */
+		int (*Setup_ISR)(const USB_Setup *setup, USB_Transfer *transfer);
+		/* OUT data stage received into transfer.out; < 0 stalls the status stage */
+		int (*Data_Out_ISR)(const USB_Setup *setup, uint16_t length);
+		/* Status stage of any request went through */
+		void (*Status_Done_ISR)(const USB_Setup *setup);
+		void (*Reset_ISR)(void);
+	}ISR_Routines;
+
+}USB_Config;
+
+int8_t USB_Init(USB_Config *config);
+void USB_Disconnect(void);
+
+
+#endif /* USB_USB_H_ */
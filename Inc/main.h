@@ -19,6 +19,9 @@
 #include "stdbool.h"
 #include "stdint.h"
 #include "system_stm32f4xx.h"
+
+/* Placed in .noinit: skipped by the startup .bss clear, contents are undefined until written */
+#define __NOINIT __attribute__((section(".noinit")))
 //#include "Drivers/GPIO.h"
 
 
@@ -38,6 +41,12 @@ extern uint32_t APB2CLK_SPEED;
 
 void BSP_Init(void);
 
+/* Drivers/Timebase: monotonic microsecond time used by the Delay_* helpers */
+void Timebase_Init(void);
+void Timebase_Clock_Changed(void);
+uint64_t Timebase_Now_us(void);
+void Timebase_Delay_us(uint32_t us);
+
 __STATIC_INLINE int32_t SystemAPB1_Clock_Speed(void)
 {
 	return (SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE1)>> RCC_CFGR_PPRE1_Pos]);
@@ -48,7 +57,13 @@ __STATIC_INLINE int32_t SystemAPB2_Clock_Speed(void)
 	return (SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2)>> RCC_CFGR_PPRE2_Pos]);
 }
 
-__STATIC_INLINE void MCU_Clock_Setup(void)
+/*
+ * Progressive clock bring-up: MCU_Clock_Setup_Start() leaves the core on HSI
+ * and starts the HSE, MCU_Clock_Setup_Poll() advances HSE -> PLL -> SYSCLK
+ * from the RCC state and returns true once the core runs from the PLL.
+ * Work done between the two hides the oscillator start-up time.
+ */
+__STATIC_INLINE void MCU_Clock_Setup_Start(void)
 {
 //	uint8_t pll_m = 4;
 //	uint8_t pll_n = 168; //192
@@ -64,7 +79,6 @@ __STATIC_INLINE void MCU_Clock_Setup(void)
 
 	RCC->PLLCFGR = 0x00000000;
 	RCC -> CR |= RCC_CR_HSEON;
-	while(!(RCC -> CR & RCC_CR_HSERDY)){}
 	RCC -> APB1ENR |= RCC_APB1ENR_PWREN;
 	PWR ->CR |= PWR_CR_VOS;
 	FLASH -> ACR |= FLASH_ACR_ICEN | FLASH_ACR_PRFTEN | FLASH_ACR_DCEN | FLASH_ACR_LATENCY_5WS;
@@ -73,20 +87,33 @@ __STATIC_INLINE void MCU_Clock_Setup(void)
 	RCC -> CFGR |= RCC_CFGR_HPRE_DIV1;
 	RCC -> CFGR |= RCC_CFGR_PPRE1_DIV4;
 	RCC -> CFGR |= RCC_CFGR_PPRE2_DIV2;
+	SystemCoreClockUpdate();
+}
 
+__STATIC_INLINE bool MCU_Clock_Setup_Poll(void)
+{
+	if((RCC -> CFGR & RCC_CFGR_SWS) == RCC_CFGR_SWS_PLL) return true;
+	if(!(RCC -> CR & RCC_CR_HSERDY)) return false;
 
+	if(!(RCC -> CR & RCC_CR_PLLON))
+	{
+		RCC -> CR |= RCC_CR_PLLON;
+		return false;
+	}
+	if(!(RCC->CR & RCC_CR_PLLRDY)) return false;
 
-
-	RCC -> CR |= RCC_CR_PLLON;
-
-
-
-	while(!(RCC->CR & RCC_CR_PLLRDY)){}
 	RCC -> CFGR |= RCC_CFGR_SW_PLL;
 	while((RCC -> CFGR & RCC_CFGR_SWS_PLL) != RCC_CFGR_SWS_PLL);
 	SystemCoreClockUpdate();
-	SysTick_Config(SystemCoreClock/168);
+	Timebase_Clock_Changed();
 	RCC -> APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+	return true;
+}
+
+__STATIC_INLINE void MCU_Clock_Setup(void)
+{
+	MCU_Clock_Setup_Start();
+	while(!MCU_Clock_Setup_Poll()){}
 }
 
 __STATIC_INLINE void MCU_Clock_DeInit(void)
@@ -137,11 +164,7 @@ __STATIC_INLINE int I2S_Clock_Init()
 
 __STATIC_INLINE uint32_t Delay_Config(void)
 {
-
-	SysTick->CTRL = 0;
-	SysTick->LOAD = 0x00FFFFFF;
-	SysTick->VAL = 0;
-	SysTick->CTRL = 5;
+	Timebase_Init();
 	return (0UL);                                                     /* Function successful */
 }
 
@@ -149,20 +172,16 @@ __STATIC_INLINE uint32_t Delay_Config(void)
 
 __STATIC_INLINE uint32_t Delay_us(volatile uint32_t us)
 {
-
-	SysTick->LOAD = 168 * us;
-	SysTick->VAL = 0;
-	while((SysTick->CTRL & 0x00010000) == 0);
+	Timebase_Delay_us(us);
 	return (0UL);                                                     /* Function successful */
 }
 
 __STATIC_INLINE uint32_t Delay_ms(volatile uint32_t ms)
 {
-	unsigned long x =0x29040 * (ms);
-	SysTick->LOAD =  x ;
-	SysTick->VAL = 0;
-	SysTick->CTRL |= 1;
-	while((SysTick->CTRL & 0x00010000) == 0);
+	for (; ms>0; ms--)
+	{
+		Timebase_Delay_us(1000U);
+	}
 	return (0UL);                                                     /* Function successful */
 }
 
@@ -188,23 +207,15 @@ __STATIC_INLINE uint32_t Delay_s(unsigned long s)
 }
 
 
+/* Both return the monotonic time in seconds, subtract to get the elapsed time */
 __STATIC_INLINE float Time_Stamp_Start(void)
 {
-	float temp = 0;
-	SysTick->CTRL = 0;
-	SysTick->LOAD = 0xFFFFFFFF;
-	SysTick->VAL = 0;
-	SysTick->CTRL = 0x5;
-	while(SysTick->VAL != 0);
-	temp = (float)(SysTick->VAL / (SystemCoreClock));
-	return temp;
+	return (float)Timebase_Now_us() / 1000000.0f;
 }
 
 __STATIC_INLINE float Time_Stamp_End(void)
 {
-	float temp = 0;
-	temp = (float)(SysTick->VAL / (SystemCoreClock));
-	return temp;
+	return (float)Timebase_Now_us() / 1000000.0f;
 }
 
 __STATIC_INLINE	void separateFractionAndIntegral(double number, double *fractionalPart, double *integralPart) {
@@ -9,7 +9,7 @@
 #define APP_DATA_CRC_ADDRESS				0x0801FFF4U
 
 
-#define APP_MAX_SIZE           65535U
+#define APP_MAX_SIZE           BL_APP_REGION_SIZE   /* sector 4, a full 64 KB image included */
 #define APP_CRC_VALUE      0xD41F4487
 #define APP_CRC_ADDRESS    0x08018000
 
@@ -20,20 +20,24 @@
 #include "Bootloader.h"
 #include "CRC/CRC.h"
 #include "Custom_RS485_Comm/Custom_RS485_Comm.h"
+#include "CAN_Comm/CAN_Comm.h"
+#include "Debug_Comm/Debug_Comm.h"
+#include "USB/USB.h"
+#include "DFU/DFU.h"
 #if DEBUG_PRINTF
 #include "Console/Console.h"
 #endif
 #include "POST/POST.h"
 #include "Flash/Flash.h"
+#include "Event/Event.h"
 
 #define LOCATE_APP_FUNC    __attribute__((section(".app_section")))
 
-#define HEADER_1           0xAA
-#define HEADER_2           0x55
-#define FOOTER_1           0xBB
-#define FOOTER_2           0x66
 #define PACKET_LENGTH_MIN  10U
-#define PACKET_LENGTH_MAX  (256 + PACKET_LENGTH_MIN)
+#define PACKET_LENGTH_MAX  (256 + PACKET_LENGTH_MIN + 1U)   /* + address byte */
+#define BLOCK_SIZE         248U                              /* Write_Block data bytes per sequence number */
+#define BLOCK_COUNT        ((BL_APP_REGION_SIZE + BLOCK_SIZE - 1U) / BLOCK_SIZE)
+#define BOOT_CRC_CHUNK     1024U   /* image bytes hashed between clock polls */
 
 volatile uint32_t flash_write_address_counter = APP_START_ADDRESS;
 volatile uint32_t flash_read_address_counter = APP_START_ADDRESS;
@@ -53,11 +57,15 @@ typedef enum {
 	Erase_Firmware      = 0xA5,
 	Reboot_MCU          = 0xA6,
 	Write_Complete      = 0xA7,
+	Write_Block         = 0xA8,
+	Missing_Query       = 0xA9,
+	Compound_Command    = 0xAB,
 } Commands_t;
 
 Commands_t command_rec ;
 
-typedef void (*CommandHandler_t)(void);
+/* frame is the validated request in AA 55 layout, valid until the handler returns */
+typedef void (*CommandHandler_t)(const uint8_t *frame);
 
 typedef struct {
 	uint8_t opcode;
@@ -65,14 +73,17 @@ typedef struct {
 } CommandEntry_t;
 
 /* =========================== Command Handlers =========================== */
-void Connect_Device_Func(void);
-void Disconnect_Device_Func(void);
-void Write_Firmware_Func(void);
-void Read_Firmware_Func(void);
-void Erase_Firmware_Func(void);
-void Reboot_MCU_Func(void);
-void Fetch_Info_Func(void);
-void Write_Complete_Func(void);
+void Connect_Device_Func(const uint8_t *frame);
+void Disconnect_Device_Func(const uint8_t *frame);
+void Write_Firmware_Func(const uint8_t *frame);
+void Read_Firmware_Func(const uint8_t *frame);
+void Erase_Firmware_Func(const uint8_t *frame);
+void Reboot_MCU_Func(const uint8_t *frame);
+void Fetch_Info_Func(const uint8_t *frame);
+void Write_Complete_Func(const uint8_t *frame);
+void Write_Block_Func(const uint8_t *frame);
+void Missing_Query_Func(const uint8_t *frame);
+void Compound_Command_Func(const uint8_t *frame);
 
 const CommandEntry_t command_table[] = {
 		{Connect_Device,      Connect_Device_Func},
@@ -83,21 +94,64 @@ const CommandEntry_t command_table[] = {
 		{Erase_Firmware,      Erase_Firmware_Func},
 		{Reboot_MCU,          Reboot_MCU_Func},
 		{Write_Complete,      Write_Complete_Func},
+		{Write_Block,         Write_Block_Func},
+		{Missing_Query,       Missing_Query_Func},
+		{Compound_Command,    Compound_Command_Func},
 };
 
-/* =========================== Global Buffers =========================== */
-uint8_t  buffer1[3] = {0,0,0};
-volatile uint8_t buffer[PACKET_LENGTH_MAX];
-uint16_t len = 0;
-uint32_t CRC_Rec1 = 0, CRC_Rec2 = 0;
+/* =========================== Transport =========================== */
+/* Frame level operations of the link the session runs on; replies go back the way the request came */
+typedef struct {
+	Packet *(*Take)(uint32_t frame);
+	int8_t (*Send_Frame)(uint8_t command, uint8_t request, const volatile uint8_t *payload, uint8_t length);
+	uint8_t (*TX_Free)(void);
+	void (*Flush)(void);
+} Link_t;
+
+static const Link_t uart_link = {Custom_Comm_Take, Custom_Comm_Send_Frame, Custom_Comm_TX_Free, Custom_Comm_Flush};
+static const Link_t can_link  = {CAN_Comm_Take, CAN_Comm_Send_Frame, CAN_Comm_TX_Free, CAN_Comm_Flush};
+static const Link_t debug_link = {Debug_Comm_Take, Debug_Comm_Send_Frame, Debug_Comm_TX_Free, Debug_Comm_Flush};
+static const Link_t *session_link = &uart_link;
+
+/* Indexed by the Event_Source of EVENT_FRAME_RECEIVED */
+static const Link_t *const source_link[EVENT_SOURCE_COUNT] = {
+		[EVENT_SOURCE_UART4]  = &uart_link,
+		[EVENT_SOURCE_CAN1]   = &can_link,
+		[EVENT_SOURCE_USART1] = &debug_link,
+};
 
 /* =========================== Packet Validation =========================== */
-bool Validate_And_Execute_Command(uint8_t *buf, uint16_t len)
+/* Frames for this node get addressed replies, broadcast and this node's group none; false: not for us */
+static bool Accept_Address(uint8_t address)
 {
+	uint8_t node = Bootloader_Node_Address();
+
+	if ((address == CUSTOM_ADDRESS_BROADCAST) ||
+			((address >= CUSTOM_ADDRESS_GROUP_FIRST) && (address == Bootloader_Node_Group()))) {
+		Custom_Comm_Set_Reply(CUSTOM_REPLY_NONE, node);
+		return true;
+	}
+
+	if ((node != BL_NODE_UNASSIGNED) && (address == node)) {
+		Custom_Comm_Set_Reply(CUSTOM_REPLY_ADDRESSED, node);
+		return true;
+	}
+
+	return false;
+}
+
+/* Runs the handler with packet handed over to it; the caller still frees packet */
+bool Validate_And_Execute_Command(Packet *packet)
+{
+	uint8_t *buf = packet->data;
+	uint16_t len = packet->length;
+
 	if (len < PACKET_LENGTH_MIN || len > PACKET_LENGTH_MAX) return false;
 
-	if (buf[0] != HEADER_1 || buf[1] != HEADER_2 ||
-			buf[len-2] != FOOTER_1 || buf[len-1] != FOOTER_2)
+	bool addressed = (buf[1] == CUSTOM_FRAME_HEADER_2_ADDRESSED);
+
+	if (buf[0] != CUSTOM_FRAME_HEADER_1 || (buf[1] != CUSTOM_FRAME_HEADER_2 && !addressed) ||
+			buf[len-2] != CUSTOM_FRAME_FOOTER_1 || buf[len-1] != CUSTOM_FRAME_FOOTER_2)
 		return false;
 
 	uint32_t received_crc = ((uint32_t)buf[len-6] << 24) | ((uint32_t)buf[len-5] << 16) |
@@ -107,11 +161,26 @@ bool Validate_And_Execute_Command(uint8_t *buf, uint16_t len)
 
 	if (received_crc != computed_crc) return false;
 
+	if (addressed) {
+		if (!Accept_Address(buf[2])) return false;
+
+		/* Handlers see the AA 55 layout */
+		for (uint16_t i = 2; i < (len - 1U); i++) buf[i] = buf[i + 1U];
+		len--;
+	} else {
+		Custom_Comm_Set_Reply(CUSTOM_REPLY_LEGACY, 0);
+	}
+
+	/* Nothing is zeroed behind the frame, so handlers may trust the length byte */
+	if (buf[4] != (len - CUSTOM_FRAME_HEADER_LENGTH - CUSTOM_FRAME_TRAILER_LENGTH)) return false;
+	packet->length = len;
+
 	uint8_t opcode = buf[2];
 	command_rec = buf[2];
 	for (int i = 0; i < sizeof(command_table)/sizeof(command_table[0]); i++) {
 		if (command_table[i].opcode == opcode) {
-			command_table[i].handler();
+			if (!Packet_Handoff(packet, PACKET_PARSER, PACKET_HANDLER)) return false;
+			command_table[i].handler(buf);
 			return true;
 		}
 	}
@@ -132,47 +201,188 @@ typedef enum _Request_List_{
 	Req_ACK  	= 0x02,
 }Request_List;
 
-void Bootloader(void)
+/* =========================== Bootloader Events =========================== */
+/* Replies are sent with Send_Frame() from flash or static data, never from the request packet */
+/*
+ * Core cycles (DWT->CYCCNT) from taking a frame to freeing its packet: link
+ * Take(), validation, the command handler and queueing its reply. Global so
+ * a debugger can watch it; flash waits in a handler count too, so compare
+ * the min and the average of a stream of frames of one command.
+ */
+typedef struct {
+	uint32_t last;
+	uint32_t min;
+	uint32_t max;
+	uint32_t frames;
+	uint64_t total;
+} Frame_Cycles;
+Frame_Cycles frame_cycles = { .min = UINT32_MAX };
+
+/*
+ * Every listening link posts here. Until a Connect goes through, each frame
+ * is answered on the link it came from; the Connect locks the session to
+ * that link and frames from the others are taken and dropped until Disconnect.
+ * The packet goes back to the pool once its handler has returned.
+ */
+static void Frame_Received_Handler(const Event *event)
+{
+	uint32_t source = event->arg >> EVENT_SOURCE_Pos;
+	if (source >= EVENT_SOURCE_COUNT) return;
+	const Link_t *link = source_link[source];
+
+	uint32_t start = DWT->CYCCNT;
+
+	Packet *packet = link->Take(event->arg);
+	if (packet == NULL) return;
+
+	switch (state) {
+	case STATE_WAIT_CONNECT:
+		session_link = link;
+		if (Validate_And_Execute_Command(packet) && (command_rec == Connect_Device))
+			state = STATE_CONNECTED;
+		break;
+
+	case STATE_CONNECTED:
+		if (link == session_link) Validate_And_Execute_Command(packet);
+		break;
+	}
+
+	Packet_Free(packet);
+
+	uint32_t cycles = DWT->CYCCNT - start;
+	frame_cycles.last = cycles;
+	if (cycles < frame_cycles.min) frame_cycles.min = cycles;
+	if (cycles > frame_cycles.max) frame_cycles.max = cycles;
+	frame_cycles.frames++;
+	frame_cycles.total += cycles;
+}
+
+static void Flash_Done_Handler(const Event *event);
+static void CRC_Step_Handler(const Event *event);
+static void CRC_Done_Handler(const Event *event);
+static void TX_Done_Handler(const Event *event);
+static void Read_Stream_Abort(void);
+static void DFU_Service_Handler(const Event *event);
+static int8_t USB_DFU_Start(void);
+
+/*
+ * Listens on every transport in BL_LISTEN_TRANSPORTS at once, transport at
+ * the given rate and the others at their defaults; see Frame_Received_Handler
+ * for how one of them becomes the session. USB DFU is a class of its own and
+ * runs alone; if its core does not reset, or nothing else came up, UART4 listens.
+ */
+void Bootloader(uint32_t baudrate, bl_transport_t transport)
 {
-	DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, PACKET_LENGTH_MAX);
+	if (transport == BL_TRANSPORT_USB_DFU) {
+		Event_Init();
+		Event_Register(EVENT_DFU_SERVICE, DFU_Service_Handler);
+		if (USB_DFU_Start() > 0) Event_Run();
+		transport = BL_TRANSPORT_UART4;
+		baudrate = BL_DEFAULT_BAUDRATE;
+	}
 
-	Custom_Comm_Init(256000);
+	uint32_t listen = BL_LISTEN_TRANSPORTS | (1U << transport);
+	bool listening = false;
 
+	Event_Init();
+	Event_Register(EVENT_FRAME_RECEIVED, Frame_Received_Handler);
+	Event_Register(EVENT_FLASH_DONE, Flash_Done_Handler);
+	Event_Register(EVENT_CRC_STEP, CRC_Step_Handler);
+	Event_Register(EVENT_CRC_DONE, CRC_Done_Handler);
+	Event_Register(EVENT_TX_DONE, TX_Done_Handler);
 
-	while (1) {
-		switch (state) {
-		case STATE_WAIT_CONNECT:
-			DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, PACKET_LENGTH_MAX);
-			len = 0;
-			len = Custom_Comm_Receive((uint8_t *)buffer);
-			if (Validate_And_Execute_Command((uint8_t *)buffer, len))
-				state = STATE_CONNECTED;
-			break;
+	if (listen & (1U << BL_TRANSPORT_CAN1)) {
+		uint8_t node = Bootloader_Node_Address();
+		if (node == BL_NODE_UNASSIGNED) node = 0;
 
-		case STATE_CONNECTED:
-			DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, PACKET_LENGTH_MAX);
-			len = 0;
-			len = Custom_Comm_Receive((uint8_t *)buffer);
-			Validate_And_Execute_Command((uint8_t *)buffer, len);
-			break;
+		uint32_t bitrate = (transport == BL_TRANSPORT_CAN1) ? baudrate : BL_DEFAULT_CAN_BITRATE;
+		if (CAN_Comm_Init(bitrate, BL_CAN_REQUEST_ID_BASE + 2U * node, BL_CAN_RESPONSE_ID_BASE + node) > 0) {
+			CAN_Comm_Receive_Start();
+			listening = true;
 		}
 	}
+
+	if (listen & (1U << BL_TRANSPORT_USART1)) {
+		Debug_Comm_Init((transport == BL_TRANSPORT_USART1) ? baudrate : BL_DEBUG_BAUDRATE);
+		Debug_Comm_Receive_Start();
+		listening = true;
+	}
+
+	if ((listen & (1U << BL_TRANSPORT_UART4)) || !listening) {
+		Custom_Comm_Init((transport == BL_TRANSPORT_UART4) ? baudrate : BL_DEFAULT_BAUDRATE);
+		Custom_Comm_Receive_Start();
+		Custom_Comm_Set_Autobaud(BL_UART_AUTOBAUD != 0U);
+	}
+
+	Event_Run();
 }
 
 bool Check_Firmware_Presence(void);
 
 POST_Result result;
 
+/* Advances the clock bring-up; on the switch to PLL fixes the UART divider */
+static bool Boot_Clock_Service(void)
+{
+	static bool clock_ready = false;
+
+	if (clock_ready) return true;
+	if (!MCU_Clock_Setup_Poll()) return false;
+
+	clock_ready = true;
+	bl_handoff.timestamps.clock_ready = BL_HANDOFF_TIMESTAMP();
+	Custom_Comm_Clock_Changed();
+	Debug_Comm_Clock_Changed();
+	return true;
+}
+
 
 /* =========================== Application CRC Boot Decision =========================== */
 int main(void)
 {
 
 
-	MCU_Clock_Setup();
+	Bootloader_Handoff_Begin();
+
+	bl_warm_request_t warm_request;
+	bool warm_entry = Bootloader_Take_Warm_Request(&warm_request);
+
+	/* Runs from HSI until Boot_Clock_Service() sees the PLL locked */
+	MCU_Clock_Setup_Start();
 	Delay_Config();
 	CRC_Init();
 
+	/* Application asked for update mode: no LED delay, listen at its rate */
+	if (warm_entry) {
+		while (!Boot_Clock_Service()) {}
+		Bootloader(warm_request.baudrate, warm_request.transport);
+	}
+
+	/* Validate the image while HSE and PLL lock, polling the clock between chunks */
+	volatile bool firmware_check = false;
+
+	firmware_check = Check_Firmware_Presence();
+
+	uint32_t APP_SIZE_Temp = __REV(Flash_Read_Single_Word(0x08020000));
+
+	uint32_t APP_CRC_Temp = __REV(Flash_Read_Single_Word(0x08020004));
+
+	uint32_t Calculated_CRC = 0;
+
+	if (firmware_check) {
+		CRC_Reset();
+		Calculated_CRC = CRC->DR;
+		for (uint32_t offset = 0; offset < APP_SIZE_Temp; offset += BOOT_CRC_CHUNK) {
+			uint32_t chunk = APP_SIZE_Temp - offset;
+			if (chunk > BOOT_CRC_CHUNK) chunk = BOOT_CRC_CHUNK;
+			Calculated_CRC = CRC_Accumulate_8Bit_Block((volatile uint8_t *)(APP_START_ADDRESS + offset), chunk);
+			Boot_Clock_Service();
+		}
+		Bootloader_Handoff_Set_Image(APP_SIZE_Temp, APP_CRC_Temp, Calculated_CRC == APP_CRC_Temp);
+	}
+
+	while (!Boot_Clock_Service()) {}
+
 
 	GPIO_Pin_Init(GPIOD, 12, GPIO_Configuration.Mode.General_Purpose_Output,
 			GPIO_Configuration.Output_Type.Push_Pull,
@@ -211,22 +421,12 @@ int main(void)
 
 	volatile uint16_t jumper_read = GPIOC->IDR & GPIO_IDR_ID0;
 
-	volatile bool firmware_check = false;
-
-	firmware_check = Check_Firmware_Presence();
-
-	uint32_t APP_SIZE_Temp = __REV(Flash_Read_Single_Word(0x08020000));
-
-	uint32_t APP_CRC_Temp = __REV(Flash_Read_Single_Word(0x08020004));
-
 
 	if ((jumper_read == 1) || (firmware_check == false)) {
-		Bootloader();
+		Bootloader((BL_DEFAULT_TRANSPORT == BL_TRANSPORT_CAN1) ? BL_DEFAULT_CAN_BITRATE :
+				(BL_DEFAULT_TRANSPORT == BL_TRANSPORT_USART1) ? BL_DEBUG_BAUDRATE : BL_DEFAULT_BAUDRATE, BL_DEFAULT_TRANSPORT);
 	} else {
 
-		CRC_Reset();
-		uint32_t Calculated_CRC = CRC_Compute_8Bit_Block(APP_START_ADDRESS, APP_SIZE_Temp);
-
 		if (Calculated_CRC == APP_CRC_Temp) {
 			// Jump to App
 
@@ -237,208 +437,386 @@ int main(void)
 #endif
 
 #if DEBUG_PRINTF
-			printConsole("Application CRC = 0x%x \r\n",CRC_Rec1);
+			printConsole("Application CRC = 0x%x \r\n",Calculated_CRC);
 			Delay_milli(20);
 #endif
 
 
 			Bootloader_Jump();
 
-
-
-
+			/* Only reached when the image's section table failed to load */
 		}
-		else{
-			while(1)
-			{
-				GPIO_Pin_Toggle(GPIOD, 14);
-				Delay_s(1);
-			}
 
+		while(1)
+		{
+			GPIO_Pin_Toggle(GPIOD, 14);
+			Delay_s(1);
 		}
 	}
 
 	while (1);
 }
 
-void Connect_Device_Func(void)
+/* Connect and Fetch_Info payload, sent straight from flash */
+static const uint8_t bootloader_info[5] = {BOOTLOADER_VERSION, 0x19, 0x01, 0x01, 0x01};
+
+/* Single byte status payloads */
+static const uint8_t status_ack[1]  = {Req_ACK};
+static const uint8_t status_nack[1] = {0x00};
+
+/* Connect request payload bits */
+#define CONNECT_FLAG_COBS  0x01U   // switch the link to COBS framing after the reply
+#define CONNECT_FLAG_RTS   0x02U   // drive RTS so the host can stream without waiting for ACKs
+
+/* bootloader_info followed by the accepted connect flags and FEC parity */
+static uint8_t connect_reply[sizeof(bootloader_info) + 2];
+
+void Connect_Device_Func(const uint8_t *frame)
 {
 
 	GPIO_Pin_High(GPIOD, 12);
 	GPIO_Pin_Low(GPIOD, 13);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, len);
-
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Connect_Device;
-	buffer[3] = Req_ACK;
-	buffer[4] = 5;
-	buffer[5] = 0x01;
-	buffer[6] = 0x19;
-	buffer[7] = 0x01;
-	buffer[8] = 0x01;
-	buffer[9] = 0x01;
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2], 8);
-	buffer[10]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[11]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[12]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[13] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[14] = 0xBB;
-	buffer[15] = 0x66;
-	Custom_Comm_Send(buffer, 16);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, 16);
-
-}
-
-void Fetch_Info_Func(void)
-{
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Fetch_Info;
-	buffer[3] = Req_ACK;
-	buffer[4] = 5;
-	buffer[5] = 0x01;
-	buffer[6] = 0x19;
-	buffer[7] = 0x01;
-	buffer[8] = 0x01;
-	buffer[9] = 0x01;
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2], 8);
-	buffer[10]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[11]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[12]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[13] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[14] = 0xBB;
-	buffer[15] = 0x66;
-	Custom_Comm_Send(buffer, 16);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, 16);
-
-}
-
-void Disconnect_Device_Func(void)
+
+	uint8_t flags = (frame[4] >= 1U) ? (frame[5] & (CONNECT_FLAG_COBS | CONNECT_FLAG_RTS)) : 0U;
+	uint8_t parity = (frame[4] >= 2U) ? frame[6] : 0U;
+
+	/* Framing, FEC and RTS are UART4 features, the other links have none */
+	if (session_link != &uart_link) flags = parity = 0U;
+
+	for (int i = 0; i < sizeof(bootloader_info); i++) connect_reply[i] = bootloader_info[i];
+	connect_reply[sizeof(bootloader_info)] = flags;
+
+	/* Refused parity values fall back to no FEC */
+	if ((parity & 1U) || (parity > FEC_MAX_PARITY)) parity = 0U;
+	connect_reply[sizeof(bootloader_info) + 1] = parity;
+
+	/* The reply still goes out in the framing and FEC mode the host used to ask */
+	session_link->Send_Frame(Connect_Device, Req_ACK, connect_reply, sizeof(connect_reply));
+	if (session_link != &uart_link) return;
+
+	/* The rate the Connect frame came at holds for the session */
+	Custom_Comm_Set_Autobaud(false);
+	Custom_Comm_Set_Framing((flags & CONNECT_FLAG_COBS) ? CUSTOM_FRAMING_COBS : CUSTOM_FRAMING_IDLE);
+	Custom_Comm_Set_FEC(parity);
+	Custom_Comm_Set_Flow_Control((flags & CONNECT_FLAG_RTS) != 0U);
+
+}
+
+void Fetch_Info_Func(const uint8_t *frame)
+{
+	session_link->Send_Frame(Fetch_Info, Req_ACK, bootloader_info, sizeof(bootloader_info));
+
+}
+
+void Disconnect_Device_Func(const uint8_t *frame)
 {
 
 	GPIO_Pin_High(GPIOD, 13);
 	GPIO_Pin_Low(GPIOD, 12);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, len);
-
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Disconnect_Device;
-	buffer[3] = Req_ACK;
-	buffer[4] = 0;
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2], 7);
-	buffer[5]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[6]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[7]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[8] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[9] = 0xBB;
-	buffer[10] = 0x66;
-	Custom_Comm_Send(buffer, 11);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8, 0, (uint8_t *)buffer, 8, 1, 11);
 
+	session_link->Send_Frame(Disconnect_Device, Req_ACK, NULL, 0);
+	if (session_link == &uart_link) {
+		Custom_Comm_Set_Framing(CUSTOM_FRAMING_IDLE);
+		Custom_Comm_Set_FEC(0);
+		Custom_Comm_Set_Flow_Control(false);
+		Custom_Comm_Set_Autobaud(BL_UART_AUTOBAUD != 0U);
+	}
+
+	Read_Stream_Abort();
+
+	/* Any link may connect again */
 	state = STATE_WAIT_CONNECT;
 
 }
 
 
-void Write_Firmware_Func(void)
+/* Programs data at the running write address, which moves on either way */
+static bool Write_Firmware_Data(const uint8_t *data, uint8_t length)
 {
+	Custom_Comm_Hold(CUSTOM_HOLD_FLASH, true);
+	int status = Flash_Program(flash_write_address_counter, data, length);
+	flash_write_address_counter += length;
+	Custom_Comm_Hold(CUSTOM_HOLD_FLASH, false);
 
-	Flash_Unlock();
-	//	Flash_Write_Enable();
-	FLASH->CR &= ~FLASH_CR_PSIZE;
-	FLASH->CR |= (0 << FLASH_CR_PSIZE_Pos);
-	FLASH->CR |= FLASH_CR_PG;
-	DMA_Memory_To_Memory_Transfer(&buffer[5], 8, 1, flash_write_address_counter, 8, 1, buffer[4]);
-	Flash_Write_Disable();
-	Flash_Lock();
-	flash_write_address_counter += (buffer[4]);
-
-	// Write Flash Memory
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, PACKET_LENGTH_MAX);
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Write_Firmware;
-	buffer[3] = Req_ACK;
-	buffer[4] = Req_ACK;
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2], 7);
-	buffer[5]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[6]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[7]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[8] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[9] = 0xBB;
-	buffer[10] = 0x66;
-	Custom_Comm_Send(buffer, 11);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, 11);
-
-}
-
-void Read_Firmware_Func(void)
-{
-	//flash_read_address_counter
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Read_Firmware;
-	buffer[3] = Req_ACK;
-	buffer[4] = 255;
-
-	DMA_Memory_To_Memory_Transfer(&buffer[5], 8, 1, flash_write_address_counter, 8, 1, buffer[4]);
-
-	//Read Flash Memory
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2],3);
-	buffer[9]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[10]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[11]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[12] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[13] = 0xBB;
-	buffer[14] = 0x66;
-	Custom_Comm_Send(buffer, 14);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, 256);
-}
-
-void Erase_Firmware_Func(void)
+	return status == 0;
+}
+
+void Write_Firmware_Func(const uint8_t *frame)
+{
+	const uint8_t *status = Write_Firmware_Data(&frame[5], frame[4]) ? status_ack : status_nack;
+
+	session_link->Send_Frame(Write_Firmware, Req_ACK, status, 1);
+}
+
+/* Flash windows a Read_Firmware (address, length) request may cover */
+static const struct {
+	uint32_t start;
+	uint32_t length;
+} read_regions[] = {
+		{APP_START_ADDRESS,        BL_APP_REGION_SIZE},
+		{APP_SIZE_ADDRESS,         8U},
+		{BL_STAGING_START_ADDRESS, BL_FLASH_END_ADDRESS - BL_STAGING_START_ADDRESS},
+};
+
+typedef enum {
+	READ_STREAM_IDLE,
+	READ_STREAM_DATA,      // chunks still to be queued
+	READ_STREAM_CRC_WAIT,  // all chunks queued, the CRC job is still busy with a Write_Complete
+	READ_STREAM_CRC,       // all chunks queued, CRC job running
+} Read_Stream_Phase;
+
+static struct {
+	Read_Stream_Phase phase;
+	uint32_t start;
+	uint32_t end;          // one past the last byte
+	uint8_t  window;       // chunks per host credit, 0 = no flow control
+	uint8_t  credit;
+} read_stream;
+
+static uint8_t read_complete[8];   // size + CRC, big endian
+
+static bool CRC_Job_Start(uint32_t address, uint32_t length, void (*complete)(uint32_t crc));
+static void Read_Stream_Complete(uint32_t crc);
+
+static bool Read_Region_Permitted(uint32_t address, uint32_t length)
 {
+	for (int i = 0; i < sizeof(read_regions)/sizeof(read_regions[0]); i++) {
+		if ((address >= read_regions[i].start) &&
+				(length <= read_regions[i].length) &&
+				((address - read_regions[i].start) <= (read_regions[i].length - length)))
+			return true;
+	}
+	return false;
+}
+
+/* Queues chunks while the TX queue has room for a whole frame; EVENT_TX_DONE and EVENT_CRC_DONE call back in */
+static void Read_Stream_Service(void)
+{
+	while (read_stream.phase == READ_STREAM_DATA) {
+		if (flash_read_address_counter >= read_stream.end) {
+			read_stream.phase = READ_STREAM_CRC_WAIT;
+			break;
+		}
+
+		if ((read_stream.window != 0U) && (read_stream.credit == 0U)) return;
+		if (session_link->TX_Free() < 3U) return;
+
+		uint32_t remaining = read_stream.end - flash_read_address_counter;
+		uint8_t chunk = (remaining > 255U) ? 255U : (uint8_t)remaining;
+
+		session_link->Send_Frame(Read_Firmware, Req_ACK, (const volatile uint8_t *)flash_read_address_counter, chunk);
+		flash_read_address_counter += chunk;
+		if (read_stream.window != 0U) read_stream.credit--;
+	}
+
+	if ((read_stream.phase == READ_STREAM_CRC_WAIT) &&
+			CRC_Job_Start(read_stream.start, read_stream.end - read_stream.start, Read_Stream_Complete))
+		read_stream.phase = READ_STREAM_CRC;
+}
+
+/* Drops the stream; a CRC job it still has running finishes unheard */
+static void Read_Stream_Abort(void)
+{
+	read_stream.phase = READ_STREAM_IDLE;
+}
+
+/* Empty end marker, then the completion ACK the host checks its readback against */
+static void Read_Stream_Complete(uint32_t crc)
+{
+	uint32_t size = read_stream.end - read_stream.start;
+
+	if (read_stream.phase != READ_STREAM_CRC) return;
+
+	read_complete[0] = (size & 0xFF000000) >> 24;
+	read_complete[1] = (size & 0x00FF0000) >> 16;
+	read_complete[2] = (size & 0x0000FF00) >> 8;
+	read_complete[3] = (size & 0x000000FF) >> 0;
+	read_complete[4] = (crc & 0xFF000000) >> 24;
+	read_complete[5] = (crc & 0x00FF0000) >> 16;
+	read_complete[6] = (crc & 0x0000FF00) >> 8;
+	read_complete[7] = (crc & 0x000000FF) >> 0;
+
+	read_stream.phase = READ_STREAM_IDLE;
+	session_link->Send_Frame(Read_Firmware, Req_ACK, NULL, 0);
+	session_link->Send_Frame(Read_Firmware, Req_ACK, read_complete, sizeof(read_complete));
+}
+
+static void TX_Done_Handler(const Event *event)
+{
+	Read_Stream_Service();
+}
+
+/*
+ * Streams flash back in back-to-back 255 byte frames without further host requests.
+ * No payload: the installed image, sized from the metadata sector.
+ * Payload address(4) length(4) [window(1)]: any range inside read_regions; with a
+ * window the stream pauses every window chunks until the host sends a Read_Firmware
+ * frame with request Req_ACK. A rejected range gets only the end marker.
+ */
+void Read_Firmware_Func(const uint8_t *frame)
+{
+	if (frame[3] == Req_ACK) {
+		if (read_stream.phase == READ_STREAM_DATA) {
+			read_stream.credit = read_stream.window;
+			Read_Stream_Service();
+		}
+		return;
+	}
+
+	uint32_t address = APP_START_ADDRESS;
+	uint32_t length = Check_Firmware_Presence() ? __REV(Flash_Read_Single_Word(APP_SIZE_ADDRESS)) : 0U;
+	uint8_t window = 0;
+
+	if (frame[4] >= 8U) {
+		address = ((uint32_t)frame[5] << 24) | ((uint32_t)frame[6] << 16) | ((uint32_t)frame[7] << 8) | frame[8];
+		length = ((uint32_t)frame[9] << 24) | ((uint32_t)frame[10] << 16) | ((uint32_t)frame[11] << 8) | frame[12];
+	}
+	if (frame[4] >= 9U) window = frame[13];
+
+	/* A new request replaces the stream, whatever phase it is in */
+	Read_Stream_Abort();
+
+	if (!Read_Region_Permitted(address, length)) {
+		session_link->Send_Frame(Read_Firmware, Req_ACK, NULL, 0);
+		return;
+	}
+
+	read_stream.start = address;
+	read_stream.end = address + length;
+	read_stream.window = window;
+	read_stream.credit = window;
+	flash_read_address_counter = address;
+	read_stream.phase = READ_STREAM_DATA;
+
+	Read_Stream_Service();
+}
+
+/* Write_Block sequence numbers programmed since the last erase */
+static uint8_t block_received[(BLOCK_COUNT + 7U) / 8U];
+static uint8_t block_missing[(BLOCK_COUNT + 7U) / 8U];
+
+static void Block_Map_Clear(void)
+{
+	for (int i = 0; i < sizeof(block_received); i++) block_received[i] = 0;
+}
+
+/* Programs one Write_Block payload; -1: outside the image, 0: failed to program, 1: block present */
+static int8_t Write_Block_Data(const uint8_t *payload, uint8_t length)
+{
+	if (length < 3U) return -1;
+
+	uint16_t sequence = ((uint16_t)payload[0] << 8) | payload[1];
+	uint8_t size = length - 2U;
+	uint32_t offset = (uint32_t)sequence * BLOCK_SIZE;
+
+	if ((sequence >= BLOCK_COUNT) || (size > BLOCK_SIZE) || ((offset + size) > BL_APP_REGION_SIZE)) return -1;
+
+	if ((block_received[sequence >> 3] & (1U << (sequence & 7U))) == 0U) {
+		Custom_Comm_Hold(CUSTOM_HOLD_FLASH, true);
+		if (Flash_Program(APP_START_ADDRESS + offset, &payload[2], size) == 0)
+			block_received[sequence >> 3] |= (1U << (sequence & 7U));
+		Custom_Comm_Hold(CUSTOM_HOLD_FLASH, false);
+	}
+
+	return ((block_received[sequence >> 3] & (1U << (sequence & 7U))) != 0U) ? 1 : 0;
+}
+
+/*
+ * Payload sequence(2) data(1..BLOCK_SIZE), programmed at APP_START_ADDRESS +
+ * sequence * BLOCK_SIZE. Meant for broadcast: every node programs the same
+ * frames, blocks already present are skipped so repeats are harmless, and a
+ * block that fails to program stays missing for Missing_Query. NACKed when
+ * the payload holds no data, or the block is outside the image or failed to
+ * program.
+ */
+void Write_Block_Func(const uint8_t *frame)
+{
+	if ((frame[4] < 3U) || (Write_Block_Data(&frame[5], frame[4]) <= 0)) {
+		session_link->Send_Frame(Write_Block, Req_ACK, status_nack, sizeof(status_nack));
+		return;
+	}
+
+	session_link->Send_Frame(Write_Block, Req_ACK, status_ack, sizeof(status_ack));
+}
+
+/* Payload count(2): replies with a bitmap, LSB first, of the blocks below count still missing */
+void Missing_Query_Func(const uint8_t *frame)
+{
+	uint16_t count = (frame[4] >= 2U) ? (((uint16_t)frame[5] << 8) | frame[6]) : BLOCK_COUNT;
+	if (count > BLOCK_COUNT) count = BLOCK_COUNT;
+
+	uint8_t bytes = (count + 7U) / 8U;
+	for (uint8_t i = 0; i < bytes; i++) block_missing[i] = ~block_received[i];
+	if (count & 7U) block_missing[bytes - 1U] &= (1U << (count & 7U)) - 1U;
+
+	session_link->Send_Frame(Missing_Query, Req_ACK, block_missing, bytes);
+}
+
+static Flash_Sectors_Typedef erase_sector;
+
+static void Flash_Done_ISR(uint32_t status)
+{
+	Event_Post(EVENT_FLASH_DONE, status);
+}
+
+static void (*erase_complete)(bool erased);    // set while an erase runs
+
+/* Erases the application and metadata sectors one EVENT_FLASH_DONE at a time, then calls complete; false while one already runs */
+static bool Erase_Start(void (*complete)(bool erased))
+{
+	if (erase_complete != NULL) return false;
+
+	Block_Map_Clear();
+	Custom_Comm_Hold(CUSTOM_HOLD_FLASH, true);
 	Flash_Unlock();
-	Flash_Write_Enable();
-	Flash_Erase_Sector(Sector_4_0x08010000);
-	Flash_Erase_Sector(Sector_5);
-	Flash_Write_Disable();
+	erase_complete = complete;
+	erase_sector = Sector_4_0x08010000;
+	if (Flash_Erase_Sector_Start(erase_sector, Flash_Done_ISR) != 0) {
+		Flash_Lock();
+		Custom_Comm_Hold(CUSTOM_HOLD_FLASH, false);
+		erase_complete = NULL;
+		complete(false);
+	}
+	return true;
+}
+
+static void Flash_Done_Handler(const Event *event)
+{
+	bool erased = (event->arg == 0);
+
+	if (erased && (erase_sector == Sector_4_0x08010000)) {
+		erase_sector = Sector_5;
+		if (Flash_Erase_Sector_Start(erase_sector, Flash_Done_ISR) == 0) return;
+		erased = false;
+	}
+
 	Flash_Lock();
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Erase_Firmware;
-	buffer[3] = Req_ACK;
-	buffer[4] = 0x00;
-	//Read Flash Memory
-	CRC_Rec1   = CRC_Compute_8Bit_Block(&buffer[2], 3);
-	buffer[5]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[6] = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[7] = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[8] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[9] = 0xBB;
-	buffer[10] = 0x66;
-	Custom_Comm_Send(buffer, 11);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, 11);
-}
-
-void Reboot_MCU_Func(void)
-{
-
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Reboot_MCU;
-	buffer[3] = Req_ACK;
-	buffer[4] = 0x00;
-	//Read Flash Memory
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2], 3);
-	buffer[5]  =  (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[6]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[7]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[8] =  (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[9] = 0xBB;
-	buffer[10] = 0x66;
-	Custom_Comm_Send(buffer, 11);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, 11);
+	Custom_Comm_Hold(CUSTOM_HOLD_FLASH, false);
+
+	// Free the slot first, complete may start the next erase
+	void (*complete)(bool erased) = erase_complete;
+	erase_complete = NULL;
+	if (complete) complete(erased);
+}
+
+static void Erase_Firmware_Reply(bool erased)
+{
+	const uint8_t *status = erased ? status_ack : status_nack;
+
+	session_link->Send_Frame(Erase_Firmware, Req_ACK, status, 1);
+}
+
+/* NACKed while an erase, standalone or batched, is still running */
+void Erase_Firmware_Func(const uint8_t *frame)
+{
+	if (!Erase_Start(Erase_Firmware_Reply)) Erase_Firmware_Reply(false);
+}
+
+void Reboot_MCU_Func(const uint8_t *frame)
+{
+
+	session_link->Send_Frame(Reboot_MCU, Req_ACK, NULL, 0);
+	session_link->Flush();
 
 	NVIC_SystemReset();
 }
@@ -449,34 +827,363 @@ bool Check_Firmware_Presence(void)
 	return ((APP_SIZE_BYTES != 0xFFFFFFFFU) && (APP_SIZE_BYTES <= APP_MAX_SIZE));
 }
 
-void Write_Complete_Func(void)
+/* CRC over a flash range, BOOT_CRC_CHUNK bytes per EVENT_CRC_STEP, result handed to complete */
+static struct {
+	uint32_t address;
+	uint32_t remaining;
+	uint32_t crc;
+	void (*complete)(uint32_t crc);    // set while a job runs
+} crc_job;
+
+static uint32_t write_expected_crc;
+
+/*
+ * Computed in software: frames keep arriving and going out between steps,
+ * and each of them resets the CRC unit for its own check. One job at a time:
+ * false while another is still running.
+ */
+static bool CRC_Job_Start(uint32_t address, uint32_t length, void (*complete)(uint32_t crc))
+{
+	if (crc_job.complete != NULL) return false;
+
+	crc_job.address = address;
+	crc_job.remaining = length;
+	crc_job.crc = CRC_INITIAL_VALUE;
+	crc_job.complete = complete;
+
+	Event_Post(EVENT_CRC_STEP, 0);
+	return true;
+}
+
+/* ACK payload is Req_ACK when the programmed image matches the announced CRC, 0 otherwise */
+static void Write_Complete_Reply(uint32_t crc)
+{
+	const uint8_t *status = (crc == write_expected_crc) ? status_ack : status_nack;
+
+	session_link->Send_Frame(Write_Complete, Req_ACK, status, 1);
+}
+
+/* Programs payload size(4) CRC(4) as the image metadata; *size is the range to check, write_expected_crc its CRC */
+static bool Write_Complete_Store(const uint8_t *payload, uint8_t length, uint32_t *size)
+{
+	Custom_Comm_Hold(CUSTOM_HOLD_FLASH, true);
+	bool stored = (Flash_Program(APP_SIZE_ADDRESS, payload, length) == 0);
+	Custom_Comm_Hold(CUSTOM_HOLD_FLASH, false);
+
+	*size = 0;
+	write_expected_crc = 0;
+	if (length >= 8U) {
+		*size = ((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) | ((uint32_t)payload[2] << 8) | payload[3];
+		write_expected_crc = ((uint32_t)payload[4] << 24) | ((uint32_t)payload[5] << 16) | ((uint32_t)payload[6] << 8) | payload[7];
+	}
+
+	if (*size > BL_APP_REGION_SIZE) *size = 0;
+	return stored;
+}
+
+/* NACKed without storing anything while an erase or another check is still running */
+void Write_Complete_Func(const uint8_t *frame)
 {
 	//	Flash_Erase_Sector(5);
 
+	uint32_t size;
+
+	if ((erase_complete != NULL) || (crc_job.complete != NULL)) {
+		session_link->Send_Frame(Write_Complete, Req_ACK, status_nack, sizeof(status_nack));
+		return;
+	}
+
+	Write_Complete_Store(&frame[5], frame[4], &size);
+	CRC_Job_Start(APP_START_ADDRESS, size, Write_Complete_Reply);
+}
+
+static void CRC_Step_Handler(const Event *event)
+{
+	uint32_t chunk = (crc_job.remaining > BOOT_CRC_CHUNK) ? BOOT_CRC_CHUNK : crc_job.remaining;
+	crc_job.crc = CRC_Software_Accumulate_8Bit_Block(crc_job.crc, (volatile uint8_t *)crc_job.address, chunk);
+
+	crc_job.address += chunk;
+	crc_job.remaining -= chunk;
+
+	if (crc_job.remaining != 0U)
+		Event_Post(EVENT_CRC_STEP, 0);
+	else
+		Event_Post(EVENT_CRC_DONE, crc_job.crc);
+}
+
+static void CRC_Done_Handler(const Event *event)
+{
+	// Free the slot first, complete may start the next job
+	void (*complete)(uint32_t crc) = crc_job.complete;
+	crc_job.complete = NULL;
+	if (complete) complete(event->arg);
+
+	// A read stream may be waiting for the CRC job
+	Read_Stream_Service();
+}
+
+/* =========================== Compound Frames =========================== */
+/*
+ * Payload: sub-commands back to back, each opcode(1) length(1) payload(length)
+ * with the payload of that command's own frame. They run in order without
+ * replies of their own and stop at the first failure; a single reply
+ * count(1) done(1) status(1) answers the lot, status Req_ACK once all have run.
+ * Erase_Firmware, Write_Firmware, Write_Block, Write_Complete (store and
+ * verify) and Reboot_MCU can be batched; Reboot_MCU ends the list and resets
+ * once the reply is out. Erase and verify finish on their events, so the list
+ * waits in a pool packet until the last sub-command is done. Either fails
+ * while a standalone erase or check still runs; standalone ones are NACKed
+ * while the batch's own are running.
+ */
+static struct {
+	Packet *list;
+	uint16_t offset;       // next sub-command in list->data
+	uint8_t count;
+	uint8_t done;
+	bool reboot;
+} compound;
+
+static uint8_t compound_reply[3];
+static const uint8_t compound_refused[3] = {0, 0, 0x00};
+
+static void Compound_Finish(uint8_t status)
+{
+	compound_reply[0] = compound.count;
+	compound_reply[1] = compound.done;
+	compound_reply[2] = status;
+
+	Packet_Free(compound.list);
+	compound.list = NULL;
+
+	session_link->Send_Frame(Compound_Command, Req_ACK, compound_reply, sizeof(compound_reply));
+	if (compound.reboot) {
+		session_link->Flush();
+		NVIC_SystemReset();
+	}
+}
+
+static void Compound_Step_Done(bool ok);
+
+static void Compound_Verify_Done(uint32_t crc)
+{
+	Compound_Step_Done(crc == write_expected_crc);
+}
+
+/* Runs sub-commands until one has to wait for its event or the list ends */
+static void Compound_Run(void)
+{
+	while (compound.offset < compound.list->length) {
+		const uint8_t *step = &compound.list->data[compound.offset];
+		uint8_t length = step[1];
+		const uint8_t *payload = &step[2];
+		uint32_t size;
+		bool ok = false;
+
+		compound.offset += 2U + length;
+
+		switch (step[0]) {
+		case Erase_Firmware:
+			if (!Erase_Start(Compound_Step_Done)) break;
+			return;
+
+		case Write_Firmware:
+			ok = Write_Firmware_Data(payload, length);
+			break;
+
+		case Write_Block:
+			ok = (Write_Block_Data(payload, length) > 0);
+			break;
+
+		case Write_Complete:
+			if ((length < 8U) || (erase_complete != NULL) || (crc_job.complete != NULL)) break;
+			if (!Write_Complete_Store(payload, length, &size)) break;
+			CRC_Job_Start(APP_START_ADDRESS, size, Compound_Verify_Done);
+			return;
+
+		case Reboot_MCU:
+			compound.done++;
+			compound.reboot = true;
+			Compound_Finish(Req_ACK);
+			return;
+
+		default:
+			break;
+		}
+
+		if (!ok) {
+			Compound_Finish(status_nack[0]);
+			return;
+		}
+		compound.done++;
+	}
+
+	Compound_Finish(Req_ACK);
+}
+
+/* A sub-command that waited for its event is done */
+static void Compound_Step_Done(bool ok)
+{
+	if (!ok) {
+		Compound_Finish(status_nack[0]);
+		return;
+	}
+
+	compound.done++;
+	Compound_Run();
+}
+
+/* The whole list is checked before anything runs; a malformed one, or one arriving while a batch still runs, is refused */
+void Compound_Command_Func(const uint8_t *frame)
+{
+	uint8_t length = frame[4];
+	uint16_t offset = 0;
+	uint8_t count = 0;
+
+	while (offset < length) {
+		if (((length - offset) < 2U) || ((length - offset - 2U) < frame[6 + offset])) {
+			count = 0;
+			break;
+		}
+		offset += 2U + frame[6 + offset];
+		count++;
+	}
+
+	Packet *list = ((count != 0U) && (compound.list == NULL)) ? Packet_Alloc(PACKET_HANDLER) : NULL;
+	if (list == NULL) {
+		session_link->Send_Frame(Compound_Command, Req_ACK, compound_refused, sizeof(compound_refused));
+		return;
+	}
+
+	compound.list = list;
+	Memory_Copy(compound.list->data, &frame[5], length);
+	compound.list->length = length;
+	compound.offset = 0;
+	compound.count = count;
+	compound.done = 0;
+	compound.reboot = false;
+
+	Compound_Run();
+}
+
+/* =========================== USB DFU =========================== */
+#define DFU_ERASE_TIME_MS      3200U   /* sectors 4 and 5, typical at x8 */
+#define DFU_PROGRAM_TIME_MS    5U      /* DFU_TRANSFER_SIZE bytes at x32 */
+#define DFU_MANIFEST_TIME_MS   10U
+
+/* pid.codes test VID/PID, to be replaced by an allocated pair before shipping */
+static const uint8_t dfu_device_descriptor[18] = {
+		18, 0x01, 0x00, 0x02,                  // bcdUSB 2.00
+		0x00, 0x00, 0x00, USB_EP0_SIZE,
+		0x09, 0x12, 0x01, 0x00,                // VID 0x1209, PID 0x0001
+		BOOTLOADER_VERSION, 0x00,              // bcdDevice
+		1, 2, 3, 1,                            // manufacturer, product, serial, one configuration
+};
+
+static const uint8_t dfu_configuration_descriptor[9 + 9 + DFU_FUNCTIONAL_LENGTH] = {
+		9, 0x02, sizeof(dfu_configuration_descriptor), 0x00, 1, 1, 0, 0x80, 50,
+		9, 0x04, 0, 0, 0, 0xFE, 0x01, 0x02, 4,   // application specific, DFU, DFU mode protocol
+		DFU_FUNCTIONAL_LENGTH, DFU_FUNCTIONAL_DESCRIPTOR, DFU_ATTRIBUTES,
+		DFU_DETACH_TIMEOUT_MS & 0xFFU, DFU_DETACH_TIMEOUT_MS >> 8,
+		DFU_TRANSFER_SIZE & 0xFFU, DFU_TRANSFER_SIZE >> 8,
+		DFU_VERSION_BCD & 0xFFU, DFU_VERSION_BCD >> 8,
+};
+
+static char dfu_serial[25];           // 96 bit unique ID in hex
+static const char * const dfu_strings[] = {"kunal", "STM32F407 Bootloader", dfu_serial, "Application 0x08010000"};
+
+static DFU_Status DFU_Erase(void)
+{
+	int status;
+
 	Flash_Unlock();
-	FLASH->CR &= ~FLASH_CR_PSIZE;
-	FLASH->CR |= (0 << FLASH_CR_PSIZE_Pos);
-	FLASH->CR |= FLASH_CR_PG;
-	DMA_Memory_To_Memory_Transfer(&buffer[5], 8, 1, 0x08020000, 8, 1, buffer[4]);
-	Flash_Write_Disable();
+	status = Flash_Erase_Sector(Sector_4_0x08010000);
+	if (status == 0) status = Flash_Erase_Sector(Sector_5);
 	Flash_Lock();
 
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, len);
-
-
-	buffer[0] = 0xAA;
-	buffer[1] = 0x55;
-	buffer[2] = Write_Complete;
-	buffer[3] = Req_ACK;
-	buffer[4] = Req_ACK;
-	//Read Flash Memory
-	CRC_Rec1 = CRC_Compute_8Bit_Block(&buffer[2], 3);
-	buffer[5]  = (CRC_Rec1 & 0xFF000000) >> 24;
-	buffer[6]  = (CRC_Rec1 & 0x00FF0000) >> 16;
-	buffer[7]  = (CRC_Rec1 & 0x0000FF00) >> 8;
-	buffer[8] = (CRC_Rec1 & 0x000000FF) >> 0;
-	buffer[9] = 0xBB;
-	buffer[10] = 0x66;
-	Custom_Comm_Send(buffer, 11);
-	DMA_Memory_To_Memory_Transfer(buffer1, 8,0, (uint8_t *)buffer, 8, 1, 11);
+	return (status == 0) ? DFU_STATUS_OK : DFU_STATUS_ERR_ERASE;
+}
+
+/* Full words at x32; only the last block of an image can leave a tail for x8 */
+static DFU_Status DFU_Program(uint32_t offset, const uint8_t *data, uint16_t length)
+{
+	uint32_t address = APP_START_ADDRESS + offset;
+	uint16_t words = length & ~3U;
+
+	if ((words != 0U) && (Flash_Program_32(address, data, words) != 0)) return DFU_STATUS_ERR_PROG;
+	if ((words != length) && (Flash_Program(address + words, data + words, length - words) != 0)) return DFU_STATUS_ERR_PROG;
+
+	return (memcmp((const void *)address, data, length) == 0) ? DFU_STATUS_OK : DFU_STATUS_ERR_VERIFY;
+}
+
+/* Size and CRC go in big endian, the way Write_Complete stores them and the boot check reads them */
+static DFU_Status DFU_Manifest(uint32_t size)
+{
+	static uint8_t meta[8];
+
+	CRC_Reset();
+	uint32_t crc = CRC_Accumulate_8Bit_Block((volatile uint8_t *)APP_START_ADDRESS, size);
+
+	for (uint8_t i = 0; i < 4U; i++) {
+		meta[i] = size >> (24U - 8U * i);
+		meta[4U + i] = crc >> (24U - 8U * i);
+	}
+
+	if (Flash_Program(APP_SIZE_ADDRESS, meta, sizeof(meta)) != 0) return DFU_STATUS_ERR_WRITE;
+	return Check_Firmware_Presence() ? DFU_STATUS_OK : DFU_STATUS_ERR_VERIFY;
+}
+
+/* Straight from flash; the stored image when there is one */
+static uint16_t DFU_Upload(uint32_t offset, const uint8_t **data, uint16_t length)
+{
+	uint32_t size = Check_Firmware_Presence() ? __REV(Flash_Read_Single_Word(APP_SIZE_ADDRESS)) : 0U;
+
+	if (offset >= size) return 0;
+	if (length > (size - offset)) length = size - offset;
+
+	*data = (const uint8_t *)(APP_START_ADDRESS + offset);
+	return length;
+}
+
+static void DFU_Detach(void)
+{
+	USB_Disconnect();
+	NVIC_SystemReset();
+}
+
+static void DFU_Work(void)
+{
+	Event_Post(EVENT_DFU_SERVICE, 0);
+}
+
+static void DFU_Service_Handler(const Event *event)
+{
+	DFU_Service();
+}
+
+static DFU_Config dfu_config = {
+		.Size = BL_APP_REGION_SIZE,
+		.Erase_Time_ms = DFU_ERASE_TIME_MS,
+		.Program_Time_ms = DFU_PROGRAM_TIME_MS,
+		.Manifest_Time_ms = DFU_MANIFEST_TIME_MS,
+		.Routines = {DFU_Erase, DFU_Program, DFU_Manifest, DFU_Upload, DFU_Detach, DFU_Work},
+};
+
+static USB_Config usb_config = {
+		.Device_Descriptor = dfu_device_descriptor,
+		.Configuration_Descriptor = dfu_configuration_descriptor,
+		.Strings = dfu_strings,
+		.String_Count = sizeof(dfu_strings) / sizeof(dfu_strings[0]),
+		.ISR_Routines = {DFU_Setup, DFU_Data_Out, DFU_Status_Done, DFU_Reset},
+};
+
+static int8_t USB_DFU_Start(void)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const volatile uint32_t *uid = (const volatile uint32_t *)UID_BASE;
+
+	for (uint8_t i = 0; i < 24U; i++) dfu_serial[i] = hex[(uid[i / 8U] >> (28U - 4U * (i % 8U))) & 0xFU];
+	dfu_serial[24] = '\0';
+
+	DFU_Init(&dfu_config);
+	return USB_Init(&usb_config);
 }
@@ -57,35 +57,67 @@ defined in linker script */
 Reset_Handler:
   ldr   r0, =_estack
   mov   sp, r0          /* set stack pointer */
+
+/* Start the DWT cycle counter so main() can read the reset-to-main cost */
+  ldr   r0, =0xE000EDFC /* CoreDebug->DEMCR */
+  ldr   r1, [r0]
+  orr   r1, r1, #0x01000000 /* TRCENA */
+  str   r1, [r0]
+  ldr   r0, =0xE0001000 /* DWT->CTRL */
+  movs  r1, #0
+  str   r1, [r0, #4]    /* DWT->CYCCNT = 0 */
+  ldr   r1, [r0]
+  orr   r1, r1, #1      /* CYCCNTENA */
+  str   r1, [r0]
+
 /* Call the clock system initialization function.*/
   bl  SystemInit
 
-/* Copy the data segment initializers from flash to SRAM */
+/* Copy the data segment initializers from flash to SRAM, 16 bytes per burst */
   ldr r0, =_sdata
   ldr r1, =_edata
   ldr r2, =_sidata
-  movs r3, #0
+  b LoopCopyDataBurst
+
+CopyDataBurst:
+  ldmia r2!, {r3, r4, r5, r6}
+  stmia r0!, {r3, r4, r5, r6}
+
+LoopCopyDataBurst:
+  subs r3, r1, r0
+  cmp r3, #16
+  bhs CopyDataBurst
   b LoopCopyDataInit
 
 CopyDataInit:
-  ldr r4, [r2, r3]
-  str r4, [r0, r3]
-  adds r3, r3, #4
+  ldr r4, [r2], #4
+  str r4, [r0], #4
 
 LoopCopyDataInit:
-  adds r4, r0, r3
-  cmp r4, r1
+  cmp r0, r1
   bcc CopyDataInit
 
-/* Zero fill the bss segment. */
+/* Zero fill the bss segment, 16 bytes per burst. Buffers that are always
+   written before use live in .noinit and are skipped. */
   ldr r2, =_sbss
   ldr r4, =_ebss
   movs r3, #0
+  movs r5, #0
+  movs r6, #0
+  movs r7, #0
+  b LoopFillZeroBurst
+
+FillZeroBurst:
+  stmia r2!, {r3, r5, r6, r7}
+
+LoopFillZeroBurst:
+  subs r1, r4, r2
+  cmp r1, #16
+  bhs FillZeroBurst
   b LoopFillZerobss
 
 FillZerobss:
-  str  r3, [r2]
-  adds r2, r2, #4
+  str  r3, [r2], #4
 
 LoopFillZerobss:
   cmp r2, r4
@@ -146,7 +178,7 @@ g_pfnVectors:
   .word	PVD_IRQHandler               			/* PVD through EXTI line detection interrupt                          */
   .word	TAMP_STAMP_IRQHandler        			/* Tamper and TimeStamp interrupts through the EXTI line              */
   .word	RTC_WKUP_IRQHandler          			/* RTC Wakeup interrupt through the EXTI line                         */
-  .word	0                            			/* Reserved                                                           */
+  .word	FLASH_IRQHandler             			/* Flash global interrupt                                             */
   .word	RCC_IRQHandler               			/* RCC global interrupt                                               */
   .word	EXTI0_IRQHandler             			/* EXTI Line0 interrupt                                               */
   .word	EXTI1_IRQHandler             			/* EXTI Line1 interrupt                                               */
@@ -273,6 +305,9 @@ g_pfnVectors:
 	.weak	RTC_WKUP_IRQHandler
 	.thumb_set RTC_WKUP_IRQHandler,Default_Handler
 
+	.weak	FLASH_IRQHandler
+	.thumb_set FLASH_IRQHandler,Default_Handler
+
 	.weak	RCC_IRQHandler
 	.thumb_set RCC_IRQHandler,Default_Handler
 
@@ -0,0 +1,14 @@
+/*
+ * GPIO.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef HOST_GPIO_GPIO_H_
+#define HOST_GPIO_GPIO_H_
+
+/* Empty on the host: USB.h and CAN.h include it, the DFU class and CAN_Comm do not use it */
+
+#include "main.h"
+
+#endif /* HOST_GPIO_GPIO_H_ */
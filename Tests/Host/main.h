@@ -0,0 +1,22 @@
+/*
+ * main.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef HOST_MAIN_H_
+#define HOST_MAIN_H_
+
+/*
+ * Stands in for Inc/main.h when the hardware free drivers are built on the
+ * host: the C library headers they rely on, no CMSIS and no registers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#endif /* HOST_MAIN_H_ */
@@ -0,0 +1,19 @@
+/*
+ * CRC.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef HOST_CAN_CRC_CRC_H_
+#define HOST_CAN_CRC_CRC_H_
+
+/* The CRC unit call CAN_Comm makes, without the DMA headers; test_can_comm computes it in software */
+
+#include "main.h"
+
+#define CRC_Polynomial 0x4C11DB7
+#define CRC_INITIAL_VALUE 0xFFFFFFFFU
+
+uint32_t CRC_Compute_8Bit_Block(volatile uint8_t *wordBlock, size_t length);
+
+#endif /* HOST_CAN_CRC_CRC_H_ */
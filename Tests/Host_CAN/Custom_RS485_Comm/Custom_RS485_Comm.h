@@ -0,0 +1,25 @@
+/*
+ * Custom_RS485_Comm.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef HOST_CAN_CUSTOM_RS485_COMM_CUSTOM_RS485_COMM_H_
+#define HOST_CAN_CUSTOM_RS485_COMM_CUSTOM_RS485_COMM_H_
+
+/*
+ * The frame layout CAN_Comm takes from Drivers/Custom_RS485_Comm, without
+ * the UART, DMA and timer headers behind it. Keep in step with that file.
+ */
+
+#include "main.h"
+
+#define CUSTOM_FRAME_HEADER_1          0xAA
+#define CUSTOM_FRAME_HEADER_2          0x55
+#define CUSTOM_FRAME_FOOTER_1          0xBB
+#define CUSTOM_FRAME_FOOTER_2          0x66
+#define CUSTOM_FRAME_HEADER_LENGTH     5U
+#define CUSTOM_FRAME_HEADER_MAX        6U
+#define CUSTOM_FRAME_TRAILER_LENGTH    6U
+
+#endif /* HOST_CAN_CUSTOM_RS485_COMM_CUSTOM_RS485_COMM_H_ */
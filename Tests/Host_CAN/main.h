@@ -0,0 +1,128 @@
+/*
+ * main.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef HOST_CAN_MAIN_H_
+#define HOST_CAN_MAIN_H_
+
+/*
+ * Stands in for Inc/main.h in test_can_comm: the C library headers, the
+ * CMSIS layout of the bxCAN registers with the bits CAN_Comm and the CAN
+ * driver model use, and PRIMASK kept in a variable. CAN1 and CAN2 are
+ * register blocks in RAM, defined by the test.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO volatile
+
+typedef struct
+{
+	__IO uint32_t TIR;
+	__IO uint32_t TDTR;
+	__IO uint32_t TDLR;
+	__IO uint32_t TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t RIR;
+	__IO uint32_t RDTR;
+	__IO uint32_t RDLR;
+	__IO uint32_t RDHR;
+} CAN_FIFOMailBox_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t FR1;
+	__IO uint32_t FR2;
+} CAN_FilterRegister_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t              MCR;
+	__IO uint32_t              MSR;
+	__IO uint32_t              TSR;
+	__IO uint32_t              RF0R;
+	__IO uint32_t              RF1R;
+	__IO uint32_t              IER;
+	__IO uint32_t              ESR;
+	__IO uint32_t              BTR;
+	uint32_t                   RESERVED0[88];
+	CAN_TxMailBox_TypeDef      sTxMailBox[3];
+	CAN_FIFOMailBox_TypeDef    sFIFOMailBox[2];
+	uint32_t                   RESERVED1[12];
+	__IO uint32_t              FMR;
+	__IO uint32_t              FM1R;
+	uint32_t                   RESERVED2;
+	__IO uint32_t              FS1R;
+	uint32_t                   RESERVED3;
+	__IO uint32_t              FFA1R;
+	uint32_t                   RESERVED4;
+	__IO uint32_t              FA1R;
+	uint32_t                   RESERVED5[8];
+	CAN_FilterRegister_TypeDef sFilterRegister[28];
+} CAN_TypeDef;
+
+extern CAN_TypeDef Host_CAN1;
+extern CAN_TypeDef Host_CAN2;
+
+#define CAN1                    (&Host_CAN1)
+#define CAN2                    (&Host_CAN2)
+
+#define CAN_MCR_INRQ            0x00000001U
+#define CAN_MCR_TXFP            0x00000004U
+#define CAN_MCR_ABOM            0x00000040U
+#define CAN_IER_TMEIE           0x00000001U
+#define CAN_IER_FMPIE0          0x00000002U
+#define CAN_IER_FMPIE1          0x00000010U
+#define CAN_TSR_RQCP0           0x00000001U
+#define CAN_TSR_RQCP1           0x00000100U
+#define CAN_TSR_RQCP2           0x00010000U
+#define CAN_TSR_CODE_Pos        24U
+#define CAN_TSR_CODE            0x03000000U
+#define CAN_TSR_TME0            0x04000000U
+#define CAN_TSR_TME1            0x08000000U
+#define CAN_TSR_TME2            0x10000000U
+#define CAN_RF0R_FMP0           0x00000003U
+#define CAN_RF0R_FOVR0          0x00000010U
+#define CAN_TI0R_TXRQ           0x00000001U
+#define CAN_TI0R_STID_Pos       21U
+#define CAN_RI0R_STID_Pos       21U
+#define CAN_RDT0R_DLC           0x0000000FU
+#define CAN_RDT0R_FMI_Pos       8U
+#define CAN_FMR_FINIT           0x00000001U
+
+/* Interrupts are only ever taken between calls into the driver, so masking is a flag */
+extern uint32_t Host_PRIMASK;
+
+static inline uint32_t __get_PRIMASK(void)
+{
+	return Host_PRIMASK;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+	Host_PRIMASK = primask;
+}
+
+static inline void __disable_irq(void)
+{
+	Host_PRIMASK = 1U;
+}
+
+static inline void __enable_irq(void)
+{
+	Host_PRIMASK = 0U;
+}
+
+uint64_t Timebase_Now_us(void);
+
+#endif /* HOST_CAN_MAIN_H_ */
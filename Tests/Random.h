@@ -0,0 +1,38 @@
+/*
+ * Random.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef TESTS_RANDOM_H_
+#define TESTS_RANDOM_H_
+
+#include <stdint.h>
+
+/*
+ * xorshift32, so the simulations print the same figures with any C library.
+ * Seed with a non-zero value.
+ */
+
+static uint32_t random_state = 1U;
+
+static inline void Random_Seed(uint32_t seed)
+{
+	random_state = (seed != 0U) ? seed : 1U;
+}
+
+static inline uint32_t Random_Next(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+/* Uniform in [0, 1) */
+static inline double Random_Unit(void)
+{
+	return (Random_Next() >> 8) * (1.0 / 16777216.0);
+}
+
+#endif /* TESTS_RANDOM_H_ */
@@ -0,0 +1,43 @@
+/*
+ * Test.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef TESTS_TEST_H_
+#define TESTS_TEST_H_
+
+#include <stdio.h>
+
+/* Checks keep going after a failure; Test_Result() is the exit status for main() */
+
+static unsigned test_checks;
+static unsigned test_failures;
+
+#define CHECK(condition)                                                        \
+	do {                                                                        \
+		test_checks++;                                                          \
+		if (!(condition)) {                                                     \
+			test_failures++;                                                    \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+		}                                                                       \
+	} while (0)
+
+#define CHECK_EQUAL(actual, expected)                                           \
+	do {                                                                        \
+		long long _actual = (long long)(actual), _expected = (long long)(expected); \
+		test_checks++;                                                          \
+		if (_actual != _expected) {                                             \
+			test_failures++;                                                    \
+			printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__,    \
+					#actual, _actual, _expected);                               \
+		}                                                                       \
+	} while (0)
+
+static inline int Test_Result(const char *name)
+{
+	printf("%s: %u checks, %u failed\n", name, test_checks, test_failures);
+	return (test_failures == 0U) ? 0 : 1;
+}
+
+#endif /* TESTS_TEST_H_ */
@@ -0,0 +1,98 @@
+/*
+ * sim_can_throughput.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "main.h"
+#include "Random.h"
+
+/*
+ * Analytic estimate of the ISO-TP transport's throughput on classic CAN,
+ * from frame lengths on the bus; CAN_Comm itself is not run (test_can_comm
+ * does that). Frames carry 8 random data bytes on an 11-bit ID and are bit
+ * stuffed as the controller would; ACK slot, EOF and a 3-bit IFS are added.
+ * Host reaction time to flow control is not counted.
+ */
+
+#define SIM_FRAMES          20000U
+#define SIM_REQUEST_ID      0x600U
+#define SIM_WORST_BITS      (111U + 24U)   // 8 data bytes, every stuff bit the format allows
+#define SIM_CHUNK           255.0          // payload bytes per Read/Write_Firmware frame
+#define SIM_WRITE_FRAMES    43U            // FF + 38 CF, FC, 12-byte ACK as FF + CF, FC
+#define SIM_READ_FRAMES     40U            // FF + 38 CF, FC
+#define SIM_PROGRAM_S       16e-6          // byte-wide flash programming
+
+static uint16_t Crc15(const uint8_t *bits, uint32_t count)
+{
+	uint16_t crc = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t next = bits[i] ^ ((crc >> 14) & 1U);
+		crc = (uint16_t)((crc << 1) & 0x7FFFU);
+		if (next) crc ^= 0x4599U;
+	}
+	return crc;
+}
+
+static uint32_t Frame_Bits(uint16_t id, const uint8_t *data, uint8_t length)
+{
+	uint8_t bits[19 + 64 + 15];
+	uint32_t count = 0;
+
+	bits[count++] = 0;                                                   // SOF
+	for (int i = 10; i >= 0; i--) bits[count++] = (id >> i) & 1U;
+	bits[count++] = 0; bits[count++] = 0; bits[count++] = 0;             // RTR, IDE, r0
+	for (int i = 3; i >= 0; i--) bits[count++] = (length >> i) & 1U;
+	for (uint8_t d = 0; d < length; d++) {
+		for (int i = 7; i >= 0; i--) bits[count++] = (data[d] >> i) & 1U;
+	}
+	uint16_t crc = Crc15(bits, count);
+	for (int i = 14; i >= 0; i--) bits[count++] = (crc >> i) & 1U;
+
+	// After five equal bits the controller inserts their complement, which starts the next run
+	uint32_t stuffed = 0, run = 0;
+	int last = -1;
+	for (uint32_t i = 0; i < count; i++) {
+		if (bits[i] == last) run++;
+		else { run = 1; last = bits[i]; }
+		if (run == 5U) {
+			stuffed++;
+			last = !bits[i];
+			run = 1;
+		}
+	}
+	return count + stuffed + 1U + 2U + 7U + 3U;                          // CRC delimiter, ACK, EOF, IFS
+}
+
+static void Print_Row(const char *rate_name, double rate, double frame_bits)
+{
+	double frame_s = frame_bits / rate;
+	double link = 7.0 / frame_s;
+	double read = SIM_CHUNK / (SIM_READ_FRAMES * frame_s);
+	double write = SIM_CHUNK / (SIM_WRITE_FRAMES * frame_s + SIM_CHUNK * SIM_PROGRAM_S);
+
+	printf("| %s | %.1f kB/s | %.1f kB/s | %.1f kB/s |\n", rate_name, link / 1e3, read / 1e3, write / 1e3);
+}
+
+int main(void)
+{
+	uint8_t data[8];
+	uint64_t total = 0;
+
+	Random_Seed(1U);
+	for (uint32_t f = 0; f < SIM_FRAMES; f++) {
+		for (uint8_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)Random_Next();
+		total += Frame_Bits(SIM_REQUEST_ID, data, sizeof(data));
+	}
+	double average = (double)total / SIM_FRAMES;
+
+	printf("Frames average %.1f bits, worst case %u\n\n", average, SIM_WORST_BITS);
+	printf("| Bit rate | Link (7 bytes/frame) | Read_Firmware | Write_Firmware |\n");
+	printf("|----------|----------------------|---------------|----------------|\n");
+	Print_Row("500 kbit/s", 500e3, average);
+	Print_Row("1 Mbit/s", 1e6, average);
+	printf("\nWorst-case stuffing:\n\n");
+	Print_Row("1 Mbit/s", 1e6, SIM_WORST_BITS);
+	return 0;
+}
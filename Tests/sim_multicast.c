@@ -0,0 +1,96 @@
+/*
+ * sim_multicast.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "main.h"
+#include "Random.h"
+
+/*
+ * Analytic estimate of the time to update a fleet with a 64 KB image at
+ * 256000 baud, one node at a time versus multicast Write_Block with
+ * Missing_Query rounds, from the bytes each round puts on the line; the
+ * handlers in Src/main.c are not run. Each node loses each frame
+ * independently with the same probability; replies and queries are never
+ * lost, and turnaround gaps are not counted.
+ */
+
+#define SIM_BLOCKS          265U                   // 64 KB / 248 bytes, rounded up
+#define SIM_BLOCK_FRAME     (248U + 2U + 12U)      // data, sequence, addressed frame overhead
+#define SIM_ACK_FRAME       12U
+#define SIM_QUERY_BYTES     (12U + 34U + 12U)      // query, bitmap reply, turnaround
+#define SIM_BYTES_PER_S     25600.0                // 256000 baud, 10 bits per byte
+#define SIM_MAX_NODES       32U
+
+typedef struct Sim_Case
+{
+	double loss;
+	uint8_t nodes;
+}Sim_Case;
+
+static const Sim_Case sim_cases[] = {
+	{ 0.00, 8 }, { 0.00, 32 }, { 0.01, 32 }, { 0.05, 32 },
+};
+
+static bool node_missing[SIM_MAX_NODES][SIM_BLOCKS];
+
+static double Unicast_Seconds(uint8_t nodes, double loss)
+{
+	uint64_t bytes = 0;
+
+	for (uint8_t n = 0; n < nodes; n++) {
+		for (uint16_t b = 0; b < SIM_BLOCKS; b++) {
+			do {
+				bytes += SIM_BLOCK_FRAME + SIM_ACK_FRAME;
+			} while (Random_Unit() < loss);
+		}
+	}
+	return bytes / SIM_BYTES_PER_S;
+}
+
+static double Multicast_Seconds(uint8_t nodes, double loss)
+{
+	uint64_t bytes = 0;
+	bool todo[SIM_BLOCKS];
+	bool pending = true;
+
+	for (uint16_t b = 0; b < SIM_BLOCKS; b++) {
+		todo[b] = true;
+		for (uint8_t n = 0; n < nodes; n++) node_missing[n][b] = true;
+	}
+
+	while (pending) {
+		for (uint16_t b = 0; b < SIM_BLOCKS; b++) {
+			if (!todo[b]) continue;
+			bytes += SIM_BLOCK_FRAME;
+			for (uint8_t n = 0; n < nodes; n++) {
+				if (node_missing[n][b] && (Random_Unit() >= loss)) node_missing[n][b] = false;
+			}
+		}
+		bytes += (uint64_t)nodes * SIM_QUERY_BYTES;
+
+		pending = false;
+		for (uint16_t b = 0; b < SIM_BLOCKS; b++) {
+			todo[b] = false;
+			for (uint8_t n = 0; n < nodes; n++) todo[b] |= node_missing[n][b];
+			pending |= todo[b];
+		}
+	}
+	return bytes / SIM_BYTES_PER_S;
+}
+
+int main(void)
+{
+	Random_Seed(5U);
+
+	printf("| Loss | Nodes | One at a time | Multicast |\n");
+	printf("|------|-------|---------------|-----------|\n");
+	for (size_t i = 0; i < sizeof(sim_cases) / sizeof(sim_cases[0]); i++) {
+		const Sim_Case *c = &sim_cases[i];
+		double unicast = Unicast_Seconds(c->nodes, c->loss);
+		double multicast = Multicast_Seconds(c->nodes, c->loss);
+		printf("| %.0f%% | %u | %.1f s | %.1f s |\n", c->loss * 100.0, c->nodes, unicast, multicast);
+	}
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * test_autobaud.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "main.h"
+#include "Autobaud/Autobaud.h"
+#include "Random.h"
+#include "Test.h"
+
+/*
+ * Feeds Autobaud_Edge() synthetic falling edge timestamps of an AA 55 / AA 56
+ * header, as EXTI11 would take them from DWT->CYCCNT at 168 MHz, with the
+ * limits Custom_RS485_Comm uses. UART4 runs from PCLK1 = 42 MHz, a clock
+ * ratio of 4 for Autobaud_BRR().
+ */
+
+#define TEST_CORE_HZ        168000000U
+#define TEST_CLOCK_RATIO    4U
+#define TEST_MIN_BAUDRATE   1200U
+#define TEST_MAX_BAUDRATE   1000000U
+
+static const uint8_t header_55[] = { 0, 3, 5, 7, 10, 12, 14, 16, 18 };
+static const uint8_t header_56[] = { 0, 3, 5, 7, 10, 14, 16, 18 };
+
+typedef struct Result
+{
+	int8_t locked_at;                // bit position of the edge that locked, -1 never
+	uint8_t second;
+	uint32_t baudrate;
+	uint16_t brr;
+}Result;
+
+static void Reset(Autobaud *autobaud)
+{
+	Autobaud_Reset(autobaud, TEST_CORE_HZ / TEST_MAX_BAUDRATE, TEST_CORE_HZ / TEST_MIN_BAUDRATE);
+}
+
+/* Header edges from start, each moved by up to +-jitter ticks */
+static Result Feed_Header(Autobaud *autobaud, uint32_t start, double bit_ticks, uint8_t second, uint32_t jitter)
+{
+	const uint8_t *bits = (second == 0x55) ? header_55 : header_56;
+	uint8_t count = (second == 0x55) ? sizeof(header_55) : sizeof(header_56);
+	Result result = { -1, 0, 0, 0 };
+
+	for (uint8_t i = 0; i < count; i++) {
+		int32_t moved = (jitter != 0U) ? (int32_t)(Random_Next() % (2U * jitter + 1U)) - (int32_t)jitter : 0;
+		uint32_t timestamp = start + (uint32_t)(bits[i] * bit_ticks + 0.5) + (uint32_t)moved;
+		if ((Autobaud_Edge(autobaud, timestamp) == AUTOBAUD_LOCKED) && (result.locked_at < 0)) result.locked_at = bits[i];
+	}
+	result.second = autobaud->second;
+	result.baudrate = Autobaud_Baudrate(autobaud, TEST_CORE_HZ);
+	result.brr = Autobaud_BRR(autobaud, TEST_CLOCK_RATIO);
+	return result;
+}
+
+static uint16_t Expected_BRR(uint32_t baudrate)
+{
+	uint32_t pclk = TEST_CORE_HZ / TEST_CLOCK_RATIO;
+	return (uint16_t)((pclk + baudrate / 2U) / baudrate);
+}
+
+static void Test_Standard_Rates(void)
+{
+	static const uint32_t rates[] = { 1200, 9600, 57600, 115200, 256000, 460800, 1000000 };
+
+	for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+		for (uint8_t second = 0x55; second <= 0x56; second++) {
+			Autobaud autobaud;
+			Reset(&autobaud);
+			Result result = Feed_Header(&autobaud, 1000U, (double)TEST_CORE_HZ / rates[r], second, 0);
+
+			CHECK_EQUAL(result.locked_at, 18);
+			CHECK_EQUAL(result.second, second);
+			// Edges fall on whole ticks, so the rate is only as exact as ten bit times in ticks
+			CHECK(labs((long)result.baudrate - (long)rates[r]) * 10000L <= (long)rates[r]);
+			CHECK_EQUAL(result.brr, Expected_BRR(rates[r]));
+		}
+	}
+}
+
+/*
+ * Edges moved by up to a sixteenth of a bit, one receiver oversampling tick
+ * and about the spread of the EXTI entry at 1 Mbaud, still lock. The rate
+ * comes from two of them, so it moves by up to an eighth of a bit in ten.
+ */
+static void Test_Jitter(void)
+{
+	Random_Seed(41U);
+	for (uint32_t run = 0; run < 1000U; run++) {
+		uint32_t rate = 9600U + (Random_Next() % 990400U);
+		double bit_ticks = (double)TEST_CORE_HZ / rate;
+		uint8_t second = (run & 1U) ? 0x56 : 0x55;
+		Autobaud autobaud;
+
+		Reset(&autobaud);
+		Result result = Feed_Header(&autobaud, Random_Next(), bit_ticks, second, (uint32_t)(bit_ticks / 16.0));
+		CHECK_EQUAL(result.locked_at, 18);
+		CHECK_EQUAL(result.second, second);
+		CHECK((result.baudrate > rate * 0.985) && (result.baudrate < rate * 1.015));
+	}
+}
+
+/* The counter wraps inside the header */
+static void Test_Wraparound(void)
+{
+	Autobaud autobaud;
+
+	Reset(&autobaud);
+	Result result = Feed_Header(&autobaud, 0xFFFFFFFFU - 5U * 1458U, 1458.0, 0x55, 0);
+	CHECK_EQUAL(result.locked_at, 18);
+	CHECK_EQUAL(result.second, 0x55);
+	CHECK_EQUAL(result.baudrate, 115226);
+}
+
+/* Noise or the tail of an earlier frame ahead of the header slides out of the window */
+static void Test_Lead_Edges(void)
+{
+	for (uint32_t lead = 1; lead <= 12U; lead++) {
+		Autobaud autobaud;
+		uint32_t start = 0x80000000U;
+
+		Reset(&autobaud);
+		for (uint32_t i = 0; i < lead; i++) Autobaud_Edge(&autobaud, start - 200000U + i * 3700U);
+		Result result = Feed_Header(&autobaud, start, 1458.0, (lead & 1U) ? 0x56 : 0x55, 0);
+		CHECK_EQUAL(result.locked_at, 18);
+		CHECK_EQUAL(result.second, (lead & 1U) ? 0x56 : 0x55);
+	}
+}
+
+static void Test_Rejected(void)
+{
+	Autobaud autobaud;
+
+	// Faster than the EXTI path can follow, and slower than the lowest rate
+	Reset(&autobaud);
+	CHECK_EQUAL(Feed_Header(&autobaud, 0, (double)TEST_CORE_HZ / 2000000U, 0x55, 0).locked_at, -1);
+	CHECK_EQUAL(autobaud.state, AUTOBAUD_WAIT);
+	Reset(&autobaud);
+	CHECK_EQUAL(Feed_Header(&autobaud, 0, (double)TEST_CORE_HZ / 1000U, 0x55, 0).locked_at, -1);
+	CHECK_EQUAL(autobaud.state, AUTOBAUD_WAIT);
+
+	// An edge at 3.4 bits is outside the 0.3 bit tolerance
+	static const double shifted[] = { 0, 3.4, 5, 7, 10 };
+	Reset(&autobaud);
+	for (uint8_t i = 0; i < sizeof(shifted) / sizeof(shifted[0]); i++) Autobaud_Edge(&autobaud, (uint32_t)(shifted[i] * 1458.0));
+	CHECK_EQUAL(autobaud.state, AUTOBAUD_WAIT);
+
+	// Evenly spaced edges (0x55 data) are not a header
+	Reset(&autobaud);
+	for (uint32_t i = 0; i < 40U; i++) CHECK_EQUAL(Autobaud_Edge(&autobaud, i * 2U * 1458U), AUTOBAUD_WAIT);
+}
+
+/* A header-shaped byte pair whose next edge comes too late is dropped, and that edge starts the real header */
+static void Test_False_Header(void)
+{
+	static const uint8_t fake[] = { 0, 3, 5, 7, 10 };
+	Autobaud autobaud;
+
+	Reset(&autobaud);
+	for (uint8_t i = 0; i < sizeof(fake); i++) Autobaud_Edge(&autobaud, fake[i] * 1458U);
+	CHECK_EQUAL(autobaud.state, AUTOBAUD_MEASURED);
+
+	uint32_t start = 25U * 1458U;
+	Result result = Feed_Header(&autobaud, start, 1458.0, 0x56, 0);
+	CHECK_EQUAL(result.locked_at, 18);
+	CHECK_EQUAL(result.second, 0x56);
+	CHECK_EQUAL(result.baudrate, 115226);
+}
+
+int main(void)
+{
+	Test_Standard_Rates();
+	Test_Jitter();
+	Test_Wraparound();
+	Test_Lead_Edges();
+	Test_Rejected();
+	Test_False_Header();
+	return Test_Result("test_autobaud");
+}
@@ -0,0 +1,976 @@
+/*
+ * test_can_comm.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "main.h"
+#include "CAN_Comm/CAN_Comm.h"
+#include "Random.h"
+#include "Test.h"
+
+/*
+ * Runs CAN_Comm against a model of the bxCAN on a host CAN1 register block,
+ * with a host on the other end of the bus, one microsecond per step.
+ *
+ * The bxCAN registers act on access (TSR bits clear on a written one, a
+ * written RFOM pops the FIFO), which plain memory cannot do, so the CAN.h
+ * calls are served here rather than by CAN.c: the same register accesses,
+ * with the hardware's side effects added. Three mailboxes go out in request
+ * order (TXFP), filter banks route received frames into two three-frame
+ * FIFOs, a full FIFO overwrites its newest frame, and the interrupts IER
+ * enables run between steps unless PRIMASK is set. SysTick calls the tick
+ * hook every millisecond.
+ */
+
+#define TEST_REQUEST_ID     0x700U
+#define TEST_RESPONSE_ID    0x708U
+#define TEST_BITRATE        500000U
+#define TEST_FRAME_US       250U     // 8 byte standard data frame at 500 kbit/s, 111 bits plus stuffing
+#define TEST_FIFO_DEPTH     3U
+#define TEST_LOG_MAX        1024U
+#define TEST_QUEUE_MAX      128U
+#define TEST_EVENT_MAX      64U
+#define TEST_MESSAGE_MAX    8U
+#define TEST_FLOW_NONE      0xFFU    // host never answers a first frame
+
+CAN_TypeDef Host_CAN1;
+CAN_TypeDef Host_CAN2;
+uint32_t Host_PRIMASK;
+
+typedef struct Bus_Frame
+{
+	uint64_t start_us;               // ready time while queued by the host
+	uint64_t end_us;
+	uint16_t id;
+	uint8_t dlc;
+	uint8_t data[8];
+}Bus_Frame;
+
+static struct
+{
+	uint64_t now_us;
+	uint64_t next_tick_us;
+	void (*tick_hook)(void);
+	CAN_Config *config;
+
+	uint32_t tx_order[CAN_TX_MAILBOXES];
+	uint32_t tx_requests;
+	CAN_FIFOMailBox_TypeDef fifo[CAN_RX_FIFOS][TEST_FIFO_DEPTH];
+	uint8_t fifo_count[CAN_RX_FIFOS];
+	uint32_t overruns;
+
+	bool busy;
+	int8_t busy_mailbox;             // -1 while the host sends
+	Bus_Frame current;
+
+	Bus_Frame queue[TEST_QUEUE_MAX]; // host frames, sent in order
+	uint16_t queue_head;
+	uint16_t queue_tail;
+
+	Bus_Frame log[TEST_LOG_MAX];     // frames the node sent
+	uint16_t log_count;
+}bus;
+
+static struct
+{
+	uint32_t received[TEST_EVENT_MAX];
+	uint16_t received_count;
+	uint16_t received_taken;
+	uint32_t tx_done[TEST_EVENT_MAX];
+	uint64_t tx_done_us[TEST_EVENT_MAX];
+	uint16_t tx_done_count;
+}events;
+
+/* The host end of the link: answers the node's first frames and reassembles its messages */
+static struct
+{
+	uint8_t flow;                    // ISO-TP flow status for first frames and blocks, TEST_FLOW_NONE never
+	uint8_t block_size;
+	uint8_t stmin;
+	uint8_t waits;                   // WAIT frames ahead of every CTS
+	uint32_t flow_delay_us;          // from the frame that asks for flow control to each answer
+	bool alternate;                  // odd sequence numbers on request_id + 1
+
+	int32_t credit;                  // consecutive frames the last CTS allows
+	uint8_t message[4096];
+	uint16_t length;
+	uint16_t count;
+	uint8_t sn;
+	uint8_t block_count;
+	uint16_t messages;
+	uint16_t message_length[TEST_MESSAGE_MAX];
+	uint8_t messages_data[TEST_MESSAGE_MAX][CAN_COMM_FRAME_MAX];
+	uint32_t errors;                 // anything the node sent against ISO 15765-2 or the padding rule
+
+	bool node_flow_seen;
+	uint8_t node_flow[3];
+}host;
+
+/*------------------------------------ CAN.h on the model ------------------------------------*/
+
+static const uint32_t tx_empty[CAN_TX_MAILBOXES] = { CAN_TSR_TME0, CAN_TSR_TME1, CAN_TSR_TME2 };
+static const uint32_t tx_done[CAN_TX_MAILBOXES] = { CAN_TSR_RQCP0, CAN_TSR_RQCP1, CAN_TSR_RQCP2 };
+
+static volatile uint32_t *Fifo_Register(CAN_TypeDef *port, uint8_t fifo)
+{
+	return fifo ? &port->RF1R : &port->RF0R;
+}
+
+static void Fifo_Load(uint8_t fifo)
+{
+	CAN1->sFIFOMailBox[fifo] = bus.fifo[fifo][0];
+	*Fifo_Register(CAN1, fifo) = (*Fifo_Register(CAN1, fifo) & ~CAN_RF0R_FMP0) | bus.fifo_count[fifo];
+}
+
+int8_t CAN_Init(CAN_Config *config)
+{
+	CAN_TypeDef *port = config->CAN_Port;
+
+	if (port != CAN1) return -1;
+
+	bus.config = config;
+	port->MCR = CAN_MCR_TXFP | CAN_MCR_ABOM;
+	port->BTR = config->Baudrate;
+	port->IER = (uint32_t)config->interrupt;
+	port->TSR = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+	return 1;
+}
+
+int8_t CAN_Filter_Set(uint8_t bank, uint32_t id, uint32_t mask, uint8_t fifo)
+{
+	if ((bank >= CAN_FILTER_BANKS) || (fifo >= CAN_RX_FIFOS)) return -1;
+
+	uint32_t bit = 1UL << bank;
+
+	CAN1->FS1R |= bit;
+	if (fifo) CAN1->FFA1R |= bit;
+	else CAN1->FFA1R &= ~bit;
+	CAN1->sFilterRegister[bank].FR1 = (id & 0x7FFU) << CAN_TI0R_STID_Pos;
+	CAN1->sFilterRegister[bank].FR2 = (mask & 0x7FFU) << CAN_TI0R_STID_Pos;
+	CAN1->FA1R |= bit;
+	return 1;
+}
+
+int8_t CAN_Transmit(CAN_Config *config, const CAN_Frame *frame)
+{
+	CAN_TypeDef *port = config->CAN_Port;
+
+	for (uint8_t mailbox = 0; mailbox < CAN_TX_MAILBOXES; mailbox++) {
+		if ((port->TSR & tx_empty[mailbox]) == 0U) continue;
+
+		CAN_TxMailBox_TypeDef *box = &port->sTxMailBox[mailbox];
+		box->TDTR = frame->dlc & 0x0FU;
+		box->TDLR = ((uint32_t)frame->data[3] << 24) | ((uint32_t)frame->data[2] << 16) |
+				((uint32_t)frame->data[1] << 8) | frame->data[0];
+		box->TDHR = ((uint32_t)frame->data[7] << 24) | ((uint32_t)frame->data[6] << 16) |
+				((uint32_t)frame->data[5] << 8) | frame->data[4];
+		box->TIR = ((frame->id & 0x7FFU) << CAN_TI0R_STID_Pos) | CAN_TI0R_TXRQ;
+
+		port->TSR &= ~tx_empty[mailbox];
+		bus.tx_order[mailbox] = ++bus.tx_requests;
+		return (int8_t)mailbox;
+	}
+	return -1;
+}
+
+uint8_t CAN_TX_Free(CAN_Config *config)
+{
+	uint32_t tsr = config->CAN_Port->TSR;
+	return ((tsr & CAN_TSR_TME0) ? 1U : 0U) + ((tsr & CAN_TSR_TME1) ? 1U : 0U) + ((tsr & CAN_TSR_TME2) ? 1U : 0U);
+}
+
+bool CAN_TX_Idle(CAN_Config *config)
+{
+	uint32_t empty = CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2;
+	return (config->CAN_Port->TSR & empty) == empty;
+}
+
+uint8_t CAN_RX_Pending(CAN_Config *config, uint8_t fifo)
+{
+	return *Fifo_Register(config->CAN_Port, fifo) & CAN_RF0R_FMP0;
+}
+
+bool CAN_Receive(CAN_Config *config, uint8_t fifo, CAN_Frame *frame)
+{
+	CAN_TypeDef *port = config->CAN_Port;
+
+	if ((*Fifo_Register(port, fifo) & CAN_RF0R_FMP0) == 0U) return false;
+
+	CAN_FIFOMailBox_TypeDef *box = &port->sFIFOMailBox[fifo];
+	uint32_t rdtr = box->RDTR;
+
+	frame->ide = CAN_Configuration.ID.Standard;
+	frame->id = box->RIR >> CAN_RI0R_STID_Pos;
+	frame->rtr = CAN_Configuration.Frame.Data_Frame;
+	frame->dlc = ((rdtr & CAN_RDT0R_DLC) > 8U) ? 8U : (rdtr & CAN_RDT0R_DLC);
+	frame->filter = rdtr >> CAN_RDT0R_FMI_Pos;
+	frame->timestamp = 0;
+	for (uint8_t i = 0; i < 4U; i++) {
+		frame->data[i] = box->RDLR >> (8U * i);
+		frame->data[i + 4U] = box->RDHR >> (8U * i);
+	}
+
+	// RFOM: the next frame moves up into the output mailbox
+	memmove(&bus.fifo[fifo][0], &bus.fifo[fifo][1], (TEST_FIFO_DEPTH - 1U) * sizeof(bus.fifo[fifo][0]));
+	bus.fifo_count[fifo]--;
+	Fifo_Load(fifo);
+	return true;
+}
+
+/*-------------------------------------- Other services --------------------------------------*/
+
+uint64_t Timebase_Now_us(void)
+{
+	return bus.now_us;
+}
+
+void Timebase_Set_Tick_Hook(void (*hook)(void))
+{
+	bus.tick_hook = hook;
+}
+
+static void Bus_Step(void);
+
+void Timebase_Deadline_Set(Timebase_Deadline *deadline, uint32_t timeout_us)
+{
+	deadline->forever = (timeout_us == TIMEBASE_WAIT_FOREVER);
+	deadline->expiry_us = bus.now_us + timeout_us;
+}
+
+// Time only passes while the main thread spins, and the interrupts run meanwhile
+bool Timebase_Deadline_Expired(Timebase_Deadline *deadline)
+{
+	Bus_Step();
+	return !deadline->forever && (bus.now_us >= deadline->expiry_us);
+}
+
+// The STM32 CRC unit fed one byte per word, as CRC_Compute_8Bit_Block() does
+uint32_t CRC_Compute_8Bit_Block(volatile uint8_t *wordBlock, size_t length)
+{
+	uint32_t crc = CRC_INITIAL_VALUE;
+
+	for (size_t i = 0; i < length; i++) {
+		crc ^= wordBlock[i];
+		for (uint8_t bit = 0; bit < 32U; bit++) crc = (crc & 0x80000000U) ? (crc << 1) ^ CRC_Polynomial : (crc << 1);
+	}
+	return crc;
+}
+
+bool Event_Post(Event_ID id, uint32_t arg)
+{
+	if (id == EVENT_FRAME_RECEIVED) {
+		if (events.received_count == TEST_EVENT_MAX) return false;
+		events.received[events.received_count++] = arg;
+	} else if (id == EVENT_TX_DONE) {
+		if (events.tx_done_count == TEST_EVENT_MAX) return false;
+		events.tx_done_us[events.tx_done_count] = bus.now_us;
+		events.tx_done[events.tx_done_count++] = arg;
+	}
+	return true;
+}
+
+/*-------------------------------------------- Host --------------------------------------------*/
+
+static void Host_Queue(uint16_t id, const uint8_t *data, uint8_t dlc, uint64_t ready_us)
+{
+	Bus_Frame *frame = &bus.queue[bus.queue_tail];
+
+	frame->start_us = ready_us;
+	frame->id = id;
+	frame->dlc = dlc;
+	memset(frame->data, 0x55, sizeof(frame->data));
+	memcpy(frame->data, data, dlc);
+	bus.queue_tail = (bus.queue_tail + 1U) % TEST_QUEUE_MAX;
+}
+
+static void Host_Flow(void)
+{
+	uint64_t ready = bus.now_us;
+
+	if (host.flow == TEST_FLOW_NONE) return;
+	for (uint8_t w = 0; w < host.waits; w++) {
+		static const uint8_t wait[3] = { 0x31, 0x00, 0x00 };
+		ready += host.flow_delay_us;
+		Host_Queue(TEST_REQUEST_ID, wait, sizeof(wait), ready);
+	}
+	uint8_t flow[3] = { (uint8_t)(0x30U | host.flow), host.block_size, host.stmin };
+	Host_Queue(TEST_REQUEST_ID, flow, sizeof(flow), ready + host.flow_delay_us);
+}
+
+static bool Padded(const Bus_Frame *frame, uint8_t used)
+{
+	for (uint8_t i = used; i < 8U; i++) {
+		if (frame->data[i] != CAN_COMM_PADDING) return false;
+	}
+	return true;
+}
+
+/* A frame from the node has left the bus */
+static void Host_Node_Frame(const Bus_Frame *frame)
+{
+	if ((frame->id != TEST_RESPONSE_ID) || (frame->dlc != 8U)) host.errors++;
+
+	switch (frame->data[0] & 0xF0U) {
+	case 0x10:
+		host.length = ((uint16_t)(frame->data[0] & 0x0FU) << 8) | frame->data[1];
+		memcpy(host.message, &frame->data[2], 6);
+		host.count = 6;
+		host.sn = 1;
+		host.block_count = 0;
+		host.credit = 0;
+		Host_Flow();
+		break;
+
+	case 0x20: {
+		uint16_t chunk = host.length - host.count;
+		if (chunk > 7U) chunk = 7U;
+		if (((frame->data[0] & 0x0FU) != host.sn) || (host.count >= host.length) || !Padded(frame, chunk + 1U)) host.errors++;
+		if (host.credit-- <= 0) host.errors++;
+		if (host.count >= host.length) break;
+
+		memcpy(&host.message[host.count], &frame->data[1], chunk);
+		host.count += chunk;
+		host.sn = (host.sn + 1U) & 0x0FU;
+		if (host.count == host.length) {
+			if (host.messages < TEST_MESSAGE_MAX) {
+				host.message_length[host.messages] = host.length;
+				memcpy(host.messages_data[host.messages], host.message, host.length);
+			}
+			host.messages++;
+		} else if ((host.block_size != 0U) && (++host.block_count == host.block_size)) {
+			host.block_count = 0;
+			Host_Flow();
+		}
+		break;
+	}
+
+	case 0x30:
+		if (!Padded(frame, 3)) host.errors++;
+		host.node_flow_seen = true;
+		memcpy(host.node_flow, frame->data, 3);
+		break;
+
+	default:
+		// The node's frames are never short enough for a single frame
+		host.errors++;
+		break;
+	}
+}
+
+/* A frame from the host has left the bus */
+static void Host_Sent(const Bus_Frame *frame)
+{
+	if ((frame->data[0] & 0xF0U) != 0x30U) return;
+	if ((frame->data[0] & 0x0FU) == 0x00U) host.credit = (frame->data[1] == 0U) ? INT32_MAX : frame->data[1];
+}
+
+static uint16_t Host_Consecutive_ID(uint16_t index)
+{
+	return (host.alternate && (index & 1U)) ? TEST_REQUEST_ID + 1U : TEST_REQUEST_ID;
+}
+
+static void Host_Send_First(const uint8_t *data, uint16_t length)
+{
+	uint8_t first[8] = { (uint8_t)(0x10U | (length >> 8)), (uint8_t)length };
+
+	memcpy(&first[2], data, 6);
+	host.node_flow_seen = false;
+	Host_Queue(TEST_REQUEST_ID, first, 8, bus.now_us);
+}
+
+/* Consecutive frames from index to last, 1 being the one after the first frame */
+static void Host_Send_Consecutive(const uint8_t *data, uint16_t length, uint16_t from, uint16_t last)
+{
+	for (uint16_t index = from; index <= last; index++) {
+		uint16_t offset = 6U + 7U * (index - 1U);
+		uint8_t frame[8] = { (uint8_t)(0x20U | (index & 0x0FU)) };
+		uint8_t chunk = (length - offset < 7U) ? (uint8_t)(length - offset) : 7U;
+
+		memcpy(&frame[1], &data[offset], chunk);
+		Host_Queue(Host_Consecutive_ID(index), frame, chunk + 1U, bus.now_us);
+	}
+}
+
+static uint16_t Consecutive_Count(uint16_t length)
+{
+	return (length - 6U + 7U - 1U) / 7U;
+}
+
+/*--------------------------------------------- Bus ---------------------------------------------*/
+
+static void Fifo_Store(const Bus_Frame *frame)
+{
+	uint32_t rir = (uint32_t)frame->id << CAN_RI0R_STID_Pos;
+
+	for (uint8_t bank = 0; bank < CAN_FILTER_BANKS; bank++) {
+		if (((CAN1->FA1R >> bank) & 1U) == 0U) continue;
+		if (((rir ^ CAN1->sFilterRegister[bank].FR1) & CAN1->sFilterRegister[bank].FR2) != 0U) continue;
+
+		uint8_t fifo = (CAN1->FFA1R >> bank) & 1U;
+		uint8_t slot = bus.fifo_count[fifo];
+		if (slot == TEST_FIFO_DEPTH) {
+			// Not locked (RFLM clear): the newest frame is overwritten
+			slot = TEST_FIFO_DEPTH - 1U;
+			bus.overruns++;
+			*Fifo_Register(CAN1, fifo) |= CAN_RF0R_FOVR0;
+		} else {
+			bus.fifo_count[fifo]++;
+		}
+
+		CAN_FIFOMailBox_TypeDef *box = &bus.fifo[fifo][slot];
+		box->RIR = rir;
+		box->RDTR = ((uint32_t)bank << CAN_RDT0R_FMI_Pos) | frame->dlc;
+		box->RDLR = ((uint32_t)frame->data[3] << 24) | ((uint32_t)frame->data[2] << 16) |
+				((uint32_t)frame->data[1] << 8) | frame->data[0];
+		box->RDHR = ((uint32_t)frame->data[7] << 24) | ((uint32_t)frame->data[6] << 16) |
+				((uint32_t)frame->data[5] << 8) | frame->data[4];
+		Fifo_Load(fifo);
+		return;
+	}
+}
+
+static int8_t Oldest_Mailbox(void)
+{
+	int8_t oldest = -1;
+
+	for (uint8_t mailbox = 0; mailbox < CAN_TX_MAILBOXES; mailbox++) {
+		if ((CAN1->sTxMailBox[mailbox].TIR & CAN_TI0R_TXRQ) == 0U) continue;
+		if ((oldest < 0) || (bus.tx_order[mailbox] < bus.tx_order[oldest])) oldest = (int8_t)mailbox;
+	}
+	return oldest;
+}
+
+static void Bus_Start_Node(int8_t mailbox)
+{
+	CAN_TxMailBox_TypeDef *box = &CAN1->sTxMailBox[mailbox];
+
+	bus.current.id = box->TIR >> CAN_TI0R_STID_Pos;
+	bus.current.dlc = box->TDTR & 0x0FU;
+	for (uint8_t i = 0; i < 4U; i++) {
+		bus.current.data[i] = box->TDLR >> (8U * i);
+		bus.current.data[i + 4U] = box->TDHR >> (8U * i);
+	}
+	bus.busy_mailbox = mailbox;
+}
+
+static void Bus_Step(void)
+{
+	CAN_TypeDef *port = CAN1;
+
+	if (bus.busy && (bus.now_us >= bus.current.end_us)) {
+		bus.busy = false;
+		if (bus.busy_mailbox >= 0) {
+			port->sTxMailBox[bus.busy_mailbox].TIR &= ~CAN_TI0R_TXRQ;
+			port->TSR |= tx_empty[bus.busy_mailbox] | tx_done[bus.busy_mailbox];
+			if (bus.log_count < TEST_LOG_MAX) bus.log[bus.log_count++] = bus.current;
+			Host_Node_Frame(&bus.current);
+		} else {
+			Host_Sent(&bus.current);
+			Fifo_Store(&bus.current);
+		}
+	}
+
+	// Arbitration: the lower identifier wins
+	if (!bus.busy) {
+		int8_t mailbox = Oldest_Mailbox();
+		bool host_ready = (bus.queue_head != bus.queue_tail) && (bus.queue[bus.queue_head].start_us <= bus.now_us);
+
+		if ((mailbox >= 0) && (!host_ready || ((port->sTxMailBox[mailbox].TIR >> CAN_TI0R_STID_Pos) < bus.queue[bus.queue_head].id))) {
+			Bus_Start_Node(mailbox);
+			bus.busy = true;
+		} else if (host_ready) {
+			bus.current = bus.queue[bus.queue_head];
+			bus.queue_head = (bus.queue_head + 1U) % TEST_QUEUE_MAX;
+			bus.busy_mailbox = -1;
+			bus.busy = true;
+		}
+		if (bus.busy) {
+			bus.current.start_us = bus.now_us;
+			bus.current.end_us = bus.now_us + TEST_FRAME_US;
+		}
+	}
+
+	if ((Host_PRIMASK == 0U) && (bus.config != NULL)) {
+		uint32_t completed = tx_done[0] | tx_done[1] | tx_done[2];
+		if ((port->TSR & completed) && (port->IER & CAN_IER_TMEIE)) {
+			port->TSR &= ~completed;
+			bus.config->ISR_Routines.Transmit_Mailbox_Empty_ISR();
+		}
+		if (((port->RF0R & CAN_RF0R_FMP0) && (port->IER & CAN_IER_FMPIE0)) ||
+				((port->RF1R & CAN_RF0R_FMP0) && (port->IER & CAN_IER_FMPIE1))) {
+			bus.config->ISR_Routines.FIFO_Message_Pending_ISR();
+		}
+		// SysTick stays pending while masked
+		if (bus.now_us >= bus.next_tick_us) {
+			bus.next_tick_us += 1000U;
+			if (bus.tick_hook != NULL) bus.tick_hook();
+		}
+	}
+
+	bus.now_us++;
+}
+
+static void Bus_Run(uint32_t us)
+{
+	for (uint32_t i = 0; i < us; i++) Bus_Step();
+}
+
+#define Bus_Run_Until(condition, timeout_us)                                    \
+	({                                                                          \
+		uint64_t _bus_end = bus.now_us + (timeout_us);                          \
+		while (!(condition) && (bus.now_us < _bus_end)) Bus_Step();             \
+		(bool)(condition);                                                      \
+	})
+
+/* A node freshly initialised and receiving, a host that answers with CTS, BS 0 and STmin 0 */
+static void Start(void)
+{
+	uint64_t now = bus.now_us;
+
+	memset(&bus, 0, sizeof(bus));
+	memset(&events, 0, sizeof(events));
+	memset(&host, 0, sizeof(host));
+	memset(&Host_CAN1, 0, sizeof(Host_CAN1));
+	bus.now_us = now;
+	bus.next_tick_us = now - (now % 1000U) + 1000U;
+	Host_PRIMASK = 0;
+
+	CHECK_EQUAL(CAN_Comm_Init(TEST_BITRATE, TEST_REQUEST_ID, TEST_RESPONSE_ID), 1);
+	CAN_Comm_Receive_Start();
+}
+
+static void Fill(uint8_t *data, uint16_t length)
+{
+	for (uint16_t i = 0; i < length; i++) data[i] = (uint8_t)Random_Next();
+}
+
+/* Next EVENT_FRAME_RECEIVED through CAN_Comm_Take() into out; -1 when none was posted, -2 when Take refused it */
+static int Take_Message(uint8_t *out)
+{
+	if (events.received_taken == events.received_count) return -1;
+
+	uint32_t arg = events.received[events.received_taken++];
+	CHECK_EQUAL(arg >> EVENT_SOURCE_Pos, EVENT_SOURCE_CAN1);
+
+	Packet *packet = CAN_Comm_Take(arg);
+	if (packet == NULL) return -2;
+
+	int length = packet->length;
+	CHECK_EQUAL(arg & 0xFFFFU, length);
+	memcpy(out, packet->data, length);
+	Packet_Free(packet);
+	return length;
+}
+
+/* Sends a whole message from the host and checks the node's flow control and delivery */
+static void Check_Receive(const uint8_t *data, uint16_t length)
+{
+	static uint8_t out[PACKET_DATA_LENGTH];
+	uint16_t log_start = bus.log_count;
+
+	Host_Send_First(data, length);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	CHECK_EQUAL(bus.log_count - log_start, 1);
+	CHECK_EQUAL(host.node_flow[0], 0x30);
+	CHECK_EQUAL(host.node_flow[1], 0x00);
+	CHECK_EQUAL(host.node_flow[2], 0x00);
+
+	Host_Send_Consecutive(data, length, 1, Consecutive_Count(length));
+	CHECK(Bus_Run_Until(events.received_count > events.received_taken, 100000U));
+	CHECK_EQUAL(Take_Message(out), length);
+	CHECK(memcmp(out, data, length) == 0);
+}
+
+/* AA 55 command request length payload CRC BB 66, as CAN_Comm_Send_Frame() builds it */
+static uint16_t Build_Frame(uint8_t *frame, uint8_t command, uint8_t request, const uint8_t *payload, uint8_t length)
+{
+	uint16_t size = 0;
+
+	frame[size++] = CUSTOM_FRAME_HEADER_1;
+	frame[size++] = CUSTOM_FRAME_HEADER_2;
+	frame[size++] = command;
+	frame[size++] = request;
+	frame[size++] = length;
+	memcpy(&frame[size], payload, length);
+	size += length;
+
+	uint32_t crc = CRC_Compute_8Bit_Block(&frame[2], size - 2U);
+	for (int8_t shift = 24; shift >= 0; shift -= 8) frame[size++] = crc >> shift;
+	frame[size++] = CUSTOM_FRAME_FOOTER_1;
+	frame[size++] = CUSTOM_FRAME_FOOTER_2;
+	return size;
+}
+
+/* Sends one frame from the node and checks what the host reassembled */
+static void Check_Send(uint8_t command, uint8_t request, const uint8_t *payload, uint8_t length)
+{
+	uint8_t expected[CAN_COMM_FRAME_MAX];
+	uint16_t size = Build_Frame(expected, command, request, payload, length);
+	uint16_t messages = host.messages;
+
+	CHECK_EQUAL(CAN_Comm_Send_Frame(command, request, payload, length), 1);
+	CHECK(Bus_Run_Until(host.messages > messages, 5000000U));
+	CHECK_EQUAL(host.message_length[messages], size);
+	CHECK(memcmp(host.messages_data[messages], expected, size) == 0);
+	CHECK(Bus_Run_Until(CAN_Comm_TX_Free() == CAN_COMM_TX_QUEUE_LENGTH, 10000U));
+}
+
+/*-------------------------------------------- Tests --------------------------------------------*/
+
+static void Test_Init(void)
+{
+	uint8_t out[8];
+
+	Start();
+	CHECK_EQUAL(CAN1->BTR, CAN_Configuration.Baudrate._500_KBPS);
+	CHECK_EQUAL(CAN1->FA1R, 0x3);
+	CHECK_EQUAL(CAN1->FFA1R, 0x2);
+	CHECK_EQUAL(CAN1->sFilterRegister[0].FR1, TEST_REQUEST_ID << CAN_TI0R_STID_Pos);
+	CHECK_EQUAL(CAN1->sFilterRegister[1].FR1, (TEST_REQUEST_ID + 1U) << CAN_TI0R_STID_Pos);
+	CHECK_EQUAL(CAN1->IER, CAN_IER_TMEIE | CAN_IER_FMPIE0 | CAN_IER_FMPIE1);
+
+	// Before CAN_Comm_Receive_Start() frames wait in the FIFO; other identifiers never get there
+	CHECK_EQUAL(CAN_Comm_Init(TEST_BITRATE, TEST_REQUEST_ID, TEST_RESPONSE_ID), 1);
+	CHECK_EQUAL(CAN1->IER, CAN_IER_TMEIE);
+	static const uint8_t single[4] = { 0x03, 0x11, 0x22, 0x33 };
+	Host_Queue(TEST_REQUEST_ID, single, sizeof(single), bus.now_us);
+	Host_Queue(TEST_REQUEST_ID + 2U, single, sizeof(single), bus.now_us);
+	Bus_Run(2U * TEST_FRAME_US + 10U);
+	CHECK_EQUAL(events.received_count, 0);
+	CHECK_EQUAL(CAN1->RF0R & CAN_RF0R_FMP0, 1);
+	CHECK_EQUAL(CAN1->RF1R & CAN_RF0R_FMP0, 0);
+
+	CAN_Comm_Receive_Start();
+	Bus_Run(1);
+	CHECK_EQUAL(CAN1->RF0R & CAN_RF0R_FMP0, 0);
+	CHECK_EQUAL(Take_Message(out), 3);
+	CHECK(memcmp(out, &single[1], 3) == 0);
+	CHECK_EQUAL(Take_Message(out), -1);
+
+	// Any bitrate the driver has no timing for runs at 500k
+	CHECK_EQUAL(CAN_Comm_Init(1000000U, TEST_REQUEST_ID, TEST_RESPONSE_ID), 1);
+	CHECK_EQUAL(CAN1->BTR, CAN_Configuration.Baudrate._1000_KBPS);
+	CHECK_EQUAL(CAN_Comm_Init(123456U, TEST_REQUEST_ID, TEST_RESPONSE_ID), 1);
+	CHECK_EQUAL(CAN1->BTR, CAN_Configuration.Baudrate._500_KBPS);
+}
+
+static void Test_Single_Frame(void)
+{
+	uint8_t out[8];
+	CAN_Comm_Stats stats;
+
+	Start();
+	static const uint8_t full[8] = { 0x07, 1, 2, 3, 4, 5, 6, 7 };
+	Host_Queue(TEST_REQUEST_ID, full, sizeof(full), bus.now_us);
+	Bus_Run(TEST_FRAME_US + 1U);
+	CHECK_EQUAL(Take_Message(out), 7);
+	CHECK(memcmp(out, &full[1], 7) == 0);
+
+	// No data, more data than the frame carries: ignored
+	static const uint8_t empty[8] = { 0x00 };
+	static const uint8_t short_frame[5] = { 0x07, 1, 2, 3, 4 };
+	Host_Queue(TEST_REQUEST_ID, empty, sizeof(empty), bus.now_us);
+	Host_Queue(TEST_REQUEST_ID, short_frame, sizeof(short_frame), bus.now_us);
+	Bus_Run(2U * TEST_FRAME_US + 1U);
+	CHECK_EQUAL(events.received_count, 1);
+
+	// One byte is posted, but no frame is that short: Take() drops it
+	static const uint8_t one[2] = { 0x01, 0xAA };
+	Host_Queue(TEST_REQUEST_ID + 1U, one, sizeof(one), bus.now_us);
+	Bus_Run(TEST_FRAME_US + 1U);
+	CHECK_EQUAL(Take_Message(out), -2);
+	CHECK_EQUAL(Packet_Available(), PACKET_POOL_COUNT);
+
+	CAN_Comm_Get_Stats(&stats);
+	CHECK_EQUAL(stats.rx_messages, 2);
+	CHECK_EQUAL(stats.rx_aborted, 0);
+	CHECK_EQUAL(bus.log_count, 0);
+}
+
+static void Test_Segmented_Receive(void)
+{
+	static const uint16_t lengths[] = { 8, 13, 14, 62, 266, CAN_COMM_FRAME_MAX };
+	uint8_t data[CAN_COMM_FRAME_MAX + 1U];
+	CAN_Comm_Stats stats;
+
+	Start();
+	Random_Seed(42U);
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		Fill(data, lengths[i]);
+		Check_Receive(data, lengths[i]);
+	}
+	CAN_Comm_Get_Stats(&stats);
+	CHECK_EQUAL(stats.rx_messages, sizeof(lengths) / sizeof(lengths[0]));
+	CHECK_EQUAL(host.errors, 0);
+
+	// Longer than any frame: overflow
+	Host_Send_First(data, CAN_COMM_FRAME_MAX + 1U);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	CHECK_EQUAL(host.node_flow[0], 0x32);
+	Host_Send_Consecutive(data, CAN_COMM_FRAME_MAX + 1U, 1, 3);
+	Bus_Run(10000);
+	CHECK_EQUAL(events.received_count, events.received_taken);
+
+	// A lost consecutive frame ends the message
+	Fill(data, 100);
+	Host_Send_First(data, 100);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	Host_Send_Consecutive(data, 100, 1, 2);
+	Host_Send_Consecutive(data, 100, 4, Consecutive_Count(100));
+	Bus_Run(10000);
+	CHECK_EQUAL(events.received_count, events.received_taken);
+
+	// The host stops: N_Cr ends the message, later consecutive frames are ignored
+	Host_Send_First(data, 100);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	Host_Send_Consecutive(data, 100, 1, 3);
+	Bus_Run(CAN_COMM_N_CR_US + 2000U);
+	Host_Send_Consecutive(data, 100, 4, Consecutive_Count(100));
+	Bus_Run(10000);
+	CHECK_EQUAL(events.received_count, events.received_taken);
+
+	CAN_Comm_Get_Stats(&stats);
+	CHECK_EQUAL(stats.rx_aborted, 3);
+
+	// A first frame replaces a message still being reassembled
+	Host_Send_First(data, 100);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	Host_Send_Consecutive(data, 100, 1, 5);
+	Bus_Run(10000);
+	Check_Receive(data, 100);
+	CAN_Comm_Get_Stats(&stats);
+	CHECK_EQUAL(stats.rx_aborted, 4);
+	CHECK_EQUAL(Packet_Available(), PACKET_POOL_COUNT);
+}
+
+static void Test_Segmented_Send(void)
+{
+	uint8_t payload[255];
+	CAN_Comm_Stats stats;
+
+	Start();
+	Random_Seed(43U);
+	Fill(payload, sizeof(payload));
+
+	// The shortest frame, 11 bytes: first frame and one consecutive frame
+	Check_Send(0x11, 0x01, payload, 0);
+	CHECK_EQUAL(bus.log_count, 2);
+
+	uint16_t first = bus.log_count;
+	Check_Send(0x21, 0x02, payload, sizeof(payload));
+	CHECK_EQUAL(bus.log_count - first, 1U + Consecutive_Count(sizeof(payload) + 11U));
+	CHECK_EQUAL(host.errors, 0);
+
+	// BS 0 and STmin 0: the three mailboxes keep the bus busy to the last frame
+	for (uint16_t i = first + 2U; i < bus.log_count; i++) CHECK_EQUAL(bus.log[i].start_us, bus.log[i - 1U].end_us);
+
+	CHECK_EQUAL(events.tx_done_count, 2);
+	CHECK_EQUAL(events.tx_done[0], 0);
+	CHECK_EQUAL(events.tx_done[1], 1);
+	CAN_Comm_Get_Stats(&stats);
+	CHECK_EQUAL(stats.tx_messages, 2);
+	CHECK_EQUAL(stats.tx_aborted, 0);
+}
+
+static void Test_Block_Size(void)
+{
+	uint8_t payload[120];
+
+	Random_Seed(44U);
+	Fill(payload, sizeof(payload));
+	for (uint8_t block_size = 1; block_size <= 4U; block_size++) {
+		Start();
+		host.block_size = block_size;
+		host.flow_delay_us = 3000U;
+
+		// Host_Node_Frame() counts a consecutive frame past the block against the node
+		Check_Send(0x21, 0x03, payload, sizeof(payload));
+		CHECK_EQUAL(host.errors, 0);
+
+		// The node is silent from the end of each block until the next CTS arrives
+		uint16_t frames = Consecutive_Count(sizeof(payload) + 11U);
+		for (uint16_t cf = block_size + 1U; cf <= frames; cf += block_size) {
+			CHECK(bus.log[1U + cf - 1U].start_us - bus.log[1U + cf - 2U].end_us >= 3000U);
+		}
+	}
+}
+
+static void Test_STmin(void)
+{
+	static const struct { uint8_t stmin; uint32_t us; } cases[] = {
+		{ 0x01, 1000U }, { 0x05, 5000U }, { 0x7F, 127000U }, { 0xF1, 100U }, { 0xF5, 500U }, { 0x80, 127000U }, { 0xFA, 127000U },
+	};
+	uint8_t payload[30];
+
+	Random_Seed(45U);
+	Fill(payload, sizeof(payload));
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		Start();
+		host.stmin = cases[i].stmin;
+		Check_Send(0x21, 0x04, payload, sizeof(payload));
+		CHECK_EQUAL(host.errors, 0);
+
+		// The tick loads the next frame: at least STmin apart, at most one tick late
+		for (uint16_t f = 2; f < bus.log_count; f++) {
+			uint64_t gap = bus.log[f].start_us - bus.log[f - 1U].start_us;
+			CHECK(gap >= cases[i].us);
+			CHECK(gap <= cases[i].us + 1000U + TEST_FRAME_US);
+		}
+	}
+}
+
+static void Test_Flow_Control(void)
+{
+	uint8_t payload[40];
+	CAN_Comm_Stats stats;
+
+	Random_Seed(46U);
+	Fill(payload, sizeof(payload));
+
+	// Every WAIT restarts N_Bs, so the CTS may come long after N_Bs
+	Start();
+	host.waits = 3;
+	host.flow_delay_us = CAN_COMM_N_BS_US * 3U / 4U;
+	Check_Send(0x21, 0x05, payload, sizeof(payload));
+	CHECK_EQUAL(host.errors, 0);
+
+	// One WAIT too many, overflow, no flow control at all: the message is given up
+	for (uint8_t run = 0; run < 3U; run++) {
+		Start();
+		host.waits = (run == 0U) ? CAN_COMM_WAIT_MAX + 1U : 0U;
+		host.flow = (run == 1U) ? 0x02 : (run == 2U) ? TEST_FLOW_NONE : 0x00;
+		host.flow_delay_us = 1000U;
+
+		uint64_t sent = bus.now_us;
+		CHECK_EQUAL(CAN_Comm_Send_Frame(0x21, 0x06, payload, sizeof(payload)), 1);
+		CHECK(Bus_Run_Until(events.tx_done_count == 1U, CAN_COMM_N_BS_US + 100000U));
+		Bus_Run(20000);
+		CHECK_EQUAL(bus.log_count, 1);
+		CHECK_EQUAL(host.messages, 0);
+		CHECK_EQUAL(CAN_Comm_TX_Free(), CAN_COMM_TX_QUEUE_LENGTH);
+		CAN_Comm_Get_Stats(&stats);
+		CHECK_EQUAL(stats.tx_aborted, 1);
+		CHECK_EQUAL(stats.tx_messages, 0);
+
+		if (run == 2U) {
+			uint64_t waited = events.tx_done_us[0] - sent;
+			CHECK(waited >= CAN_COMM_N_BS_US);
+			CHECK(waited <= CAN_COMM_N_BS_US + 1000U);
+		}
+
+		// The next message goes out as usual
+		host.waits = 0;
+		host.flow = 0x00;
+		Check_Send(0x21, 0x07, payload, sizeof(payload));
+	}
+}
+
+static void Test_Queue(void)
+{
+	uint8_t payload[5][100];
+
+	Start();
+	Random_Seed(47U);
+	for (uint8_t m = 0; m < 5U; m++) Fill(payload[m], sizeof(payload[m]));
+
+	// Four messages fill the queue without waiting, the fifth waits for the first to go
+	for (uint8_t m = 0; m < CAN_COMM_TX_QUEUE_LENGTH; m++) CHECK_EQUAL(CAN_Comm_Send_Frame(0x21, m, payload[m], 20U * (m + 1U)), 1);
+	CHECK_EQUAL(CAN_Comm_TX_Free(), 0);
+	uint64_t queued = bus.now_us;
+	CHECK_EQUAL(CAN_Comm_Send_Frame(0x21, 4, payload[4], 100), 1);
+	CHECK(bus.now_us > queued);
+	CHECK(events.tx_done_count >= 1U);
+
+	CAN_Comm_Flush();
+	CHECK_EQUAL(CAN_Comm_TX_Free(), CAN_COMM_TX_QUEUE_LENGTH);
+	CHECK(Bus_Run_Until(host.messages == 5U, 10000U));
+	CHECK_EQUAL(host.errors, 0);
+	for (uint8_t m = 0; m < 5U; m++) {
+		uint8_t expected[CAN_COMM_FRAME_MAX];
+		uint16_t size = Build_Frame(expected, 0x21, m, payload[m], (m < 4U) ? 20U * (m + 1U) : 100U);
+		CHECK_EQUAL(host.message_length[m], size);
+		CHECK(memcmp(host.messages_data[m], expected, size) == 0);
+		CHECK_EQUAL(events.tx_done[m], m % CAN_COMM_TX_QUEUE_LENGTH);
+	}
+}
+
+/*
+ * With interrupts held off the FIFOs fill up: six consecutive frames fit
+ * when the host alternates identifiers, and the node reads them back in
+ * sequence number order, not FIFO order.
+ */
+static void Test_FIFO_Ping_Pong(void)
+{
+	uint8_t data[CAN_COMM_FRAME_MAX];
+	uint8_t out[PACKET_DATA_LENGTH];
+	CAN_Comm_Stats stats;
+
+	Start();
+	Random_Seed(48U);
+	Fill(data, sizeof(data));
+
+	host.alternate = true;
+	Host_Send_First(data, 48);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	Host_PRIMASK = 1;
+	Host_Send_Consecutive(data, 48, 1, Consecutive_Count(48));
+	Bus_Run(Consecutive_Count(48) * TEST_FRAME_US + 10U);
+	CHECK_EQUAL(CAN1->RF0R & CAN_RF0R_FMP0, 3);
+	CHECK_EQUAL(CAN1->RF1R & CAN_RF0R_FMP0, 3);
+	CHECK_EQUAL(bus.overruns, 0);
+	Host_PRIMASK = 0;
+	Bus_Run(1);
+	CHECK_EQUAL(Take_Message(out), 48);
+	CHECK(memcmp(out, data, 48) == 0);
+
+	// One identifier: FIFO0 holds three, the sixth frame overwrites the third and the message is lost
+	host.alternate = false;
+	Host_Send_First(data, 48);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	Host_PRIMASK = 1;
+	Host_Send_Consecutive(data, 48, 1, Consecutive_Count(48));
+	Bus_Run(Consecutive_Count(48) * TEST_FRAME_US + 10U);
+	CHECK_EQUAL(bus.overruns, 3);
+	Host_PRIMASK = 0;
+	Bus_Run(1);
+	CHECK_EQUAL(Take_Message(out), -1);
+	CAN_Comm_Get_Stats(&stats);
+	CHECK_EQUAL(stats.rx_aborted, 1);
+
+	// The longest frame, interrupts held for five frame times at a time, sequence numbers wrapping
+	host.alternate = true;
+	bus.overruns = 0;
+	Host_Send_First(data, CAN_COMM_FRAME_MAX);
+	CHECK(Bus_Run_Until(host.node_flow_seen, 10000U));
+	Host_Send_Consecutive(data, CAN_COMM_FRAME_MAX, 1, Consecutive_Count(CAN_COMM_FRAME_MAX));
+	for (uint16_t turn = 0; (turn < 100U) && (events.received_count == events.received_taken); turn++) {
+		Host_PRIMASK = 1;
+		Bus_Run(5U * TEST_FRAME_US);
+		Host_PRIMASK = 0;
+		Bus_Run(1);
+	}
+	CHECK_EQUAL(bus.overruns, 0);
+	CHECK_EQUAL(Take_Message(out), CAN_COMM_FRAME_MAX);
+	CHECK(memcmp(out, data, CAN_COMM_FRAME_MAX) == 0);
+
+	// And with the interrupts on time a host on request_id alone needs no second FIFO
+	host.alternate = false;
+	Check_Receive(data, CAN_COMM_FRAME_MAX);
+	CHECK_EQUAL(bus.overruns, 0);
+	CHECK_EQUAL(Packet_Available(), PACKET_POOL_COUNT);
+}
+
+int main(void)
+{
+	Test_Init();
+	Test_Single_Frame();
+	Test_Segmented_Receive();
+	Test_Segmented_Send();
+	Test_Block_Size();
+	Test_STmin();
+	Test_Flow_Control();
+	Test_Queue();
+	Test_FIFO_Ping_Pong();
+	return Test_Result("test_can_comm");
+}
@@ -0,0 +1,221 @@
+/*
+ * test_cobs.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "main.h"
+#include "COBS/COBS.h"
+#include "Random.h"
+#include "Test.h"
+
+/*
+ * Round trips through the COBS codec the way Custom_RS485_Comm uses it: the
+ * encoder is fed a frame in pieces, the decoder gets the line one byte at a
+ * time into a buffer of the UART4 receive length.
+ */
+
+#define TEST_CAPACITY       300U     // Custom_RX_Buffer_Length
+#define TEST_LINE_MAX       4096U
+
+static uint8_t line[TEST_LINE_MAX];
+static uint16_t line_length;
+static uint8_t decoded[TEST_CAPACITY];
+
+typedef struct Received
+{
+	uint16_t frames;
+	uint16_t length[16];
+	uint8_t data[16][TEST_CAPACITY];
+}Received;
+
+static Received received;
+
+/* Appends frame, encoded in pieces of at most piece bytes, to the line; returns its encoded length */
+static uint16_t Send(const uint8_t *frame, uint16_t length, uint16_t piece)
+{
+	COBS_Encoder encoder;
+
+	COBS_Encode_Start(&encoder, &line[line_length]);
+	for (uint16_t done = 0; done < length; done += piece) {
+		COBS_Encode(&encoder, frame + done, (length - done < piece) ? (length - done) : piece);
+	}
+	uint16_t encoded = COBS_Encode_End(&encoder);
+	line_length += encoded;
+	return encoded;
+}
+
+static void Receive(void)
+{
+	COBS_Decoder decoder = { decoded, TEST_CAPACITY, 0, 0, false, false };
+
+	memset(&received, 0, sizeof(received));
+	for (uint16_t i = 0; i < line_length; i++) {
+		uint16_t length = COBS_Decode(&decoder, line[i]);
+		if ((length != 0U) && (received.frames < 16U)) {
+			received.length[received.frames] = length;
+			memcpy(received.data[received.frames], decoded, length);
+			received.frames++;
+		}
+	}
+}
+
+static bool Only_Delimiters_Are_Zero(uint16_t from, uint16_t encoded)
+{
+	for (uint16_t i = from; i < from + encoded - 1U; i++) {
+		if (line[i] == COBS_DELIMITER) return false;
+	}
+	return line[from + encoded - 1U] == COBS_DELIMITER;
+}
+
+static void Check_Round_Trip(const uint8_t *frame, uint16_t length, uint16_t expected_encoded)
+{
+	line_length = 0;
+	uint16_t encoded = Send(frame, length, 7);
+	CHECK_EQUAL(encoded, expected_encoded);
+	CHECK(encoded <= COBS_ENCODED_MAX(length));
+	CHECK(Only_Delimiters_Are_Zero(0, encoded));
+
+	Receive();
+	CHECK_EQUAL(received.frames, 1);
+	CHECK_EQUAL(received.length[0], length);
+	CHECK(memcmp(received.data[0], frame, length) == 0);
+}
+
+static void Test_Zero_Runs(void)
+{
+	uint8_t frame[TEST_CAPACITY];
+
+	// n zeros: a code byte 0x01 per zero plus the last one, and the delimiter
+	memset(frame, 0, sizeof(frame));
+	Check_Round_Trip(frame, 1, 3);
+	Check_Round_Trip(frame, 2, 4);
+	Check_Round_Trip(frame, TEST_CAPACITY, TEST_CAPACITY + 2U);
+
+	// Zeros at both ends and in runs between data
+	static const uint8_t mixed[] = { 0x00, 0xAA, 0x55, 0x00, 0x00, 0x00, 0x11, 0x00 };
+	Check_Round_Trip(mixed, sizeof(mixed), sizeof(mixed) + 2U);
+}
+
+static void Test_Full_Blocks(void)
+{
+	uint8_t frame[TEST_CAPACITY];
+
+	for (uint16_t i = 0; i < sizeof(frame); i++) frame[i] = (uint8_t)(1U + (i % 255U));
+
+	// 254 non-zero bytes fill a 0xFF block, which is followed by an empty closing block
+	Check_Round_Trip(frame, 253, 255);
+	Check_Round_Trip(frame, 254, 257);
+	Check_Round_Trip(frame, 255, 258);
+	Check_Round_Trip(frame, TEST_CAPACITY, TEST_CAPACITY + 3U);
+
+	line_length = 0;
+	Send(frame, 254, 254);
+	CHECK_EQUAL(line[0], 0xFF);
+
+	// A zero right behind a full block
+	frame[254] = 0x00;
+	Check_Round_Trip(frame, 256, 259);
+}
+
+static void Test_Random_Frames(void)
+{
+	uint8_t frame[TEST_CAPACITY];
+
+	Random_Seed(37U);
+	for (uint32_t run = 0; run < 2000U; run++) {
+		uint16_t length = 1U + (Random_Next() % TEST_CAPACITY);
+		uint32_t zero_odds = Random_Next() % 4U;          // none, rare, common, mostly zeros
+		for (uint16_t i = 0; i < length; i++) {
+			uint32_t r = Random_Next();
+			bool zero = (zero_odds == 1U) ? ((r % 64U) == 0U) : (zero_odds == 2U) ? ((r % 4U) == 0U) : (zero_odds == 3U) && ((r % 4U) != 0U);
+			frame[i] = zero ? 0x00 : (uint8_t)(1U + ((r >> 8) % 255U));
+		}
+
+		line_length = 0;
+		uint16_t encoded = Send(frame, length, 1U + (Random_Next() % 40U));
+		CHECK(encoded <= COBS_ENCODED_MAX(length));
+		CHECK(Only_Delimiters_Are_Zero(0, encoded));
+		Receive();
+		CHECK_EQUAL(received.frames, 1);
+		CHECK_EQUAL(received.length[0], length);
+		CHECK(memcmp(received.data[0], frame, length) == 0);
+	}
+}
+
+/* Frames back to back; corrupting one costs that frame, the next decodes whole */
+static void Test_Resync(void)
+{
+	uint8_t frame[3][64];
+
+	for (uint8_t f = 0; f < 3U; f++) {
+		for (uint8_t i = 0; i < sizeof(frame[f]); i++) frame[f][i] = (uint8_t)((i % 9U == 0U) ? 0x00 : (f * 64U + i));
+	}
+
+	for (uint16_t hit = 0; ; hit++) {
+		line_length = 0;
+		Send(frame[0], sizeof(frame[0]), 64);
+		uint16_t second = line_length;
+		uint16_t encoded = Send(frame[1], sizeof(frame[1]), 64);
+		Send(frame[2], sizeof(frame[2]), 64);
+		if (hit >= encoded - 1U) break;
+
+		// Every byte of the middle frame in turn, code bytes included: changed, or replaced by a stray zero
+		line[second + hit] = (hit & 1U) ? 0x00 : (uint8_t)(line[second + hit] ^ 0x5A);
+		Receive();
+
+		CHECK(received.frames >= 2U);
+		CHECK_EQUAL(received.length[0], sizeof(frame[0]));
+		CHECK(memcmp(received.data[0], frame[0], sizeof(frame[0])) == 0);
+		uint16_t last = received.frames - 1U;
+		CHECK_EQUAL(received.length[last], sizeof(frame[2]));
+		CHECK(memcmp(received.data[last], frame[2], sizeof(frame[2])) == 0);
+	}
+
+	// Line noise before the first delimiter is dropped with it
+	static const uint8_t noise[] = { 0x13, 0x37, 0xFF, 0x02 };
+	memcpy(line, noise, sizeof(noise));
+	line[sizeof(noise)] = COBS_DELIMITER;
+	line_length = sizeof(noise) + 1U;
+	Send(frame[2], sizeof(frame[2]), 64);
+	Receive();
+	CHECK_EQUAL(received.frames, 1);
+	CHECK(memcmp(received.data[0], frame[2], sizeof(frame[2])) == 0);
+}
+
+static void Test_Maximum_Length(void)
+{
+	static uint8_t frame[TEST_CAPACITY + 1U];
+
+	Random_Seed(43U);
+	for (uint16_t i = 0; i < sizeof(frame); i++) frame[i] = (uint8_t)Random_Next();
+
+	// The longest frame fits; one byte more is dropped and the following frame is unharmed
+	line_length = 0;
+	Send(frame, TEST_CAPACITY, 64);
+	Send(frame, TEST_CAPACITY + 1U, 64);
+	Send(frame, 10, 64);
+	Receive();
+	CHECK_EQUAL(received.frames, 2);
+	CHECK_EQUAL(received.length[0], TEST_CAPACITY);
+	CHECK(memcmp(received.data[0], frame, TEST_CAPACITY) == 0);
+	CHECK_EQUAL(received.length[1], 10);
+
+	// Without a buffer the frame is dropped too
+	COBS_Decoder decoder = { NULL, TEST_CAPACITY, 0, 0, false, false };
+	line_length = 0;
+	Send(frame, 10, 64);
+	uint16_t length = 0;
+	for (uint16_t i = 0; i < line_length; i++) length |= COBS_Decode(&decoder, line[i]);
+	CHECK_EQUAL(length, 0);
+}
+
+int main(void)
+{
+	Test_Zero_Runs();
+	Test_Full_Blocks();
+	Test_Random_Frames();
+	Test_Resync();
+	Test_Maximum_Length();
+	return Test_Result("test_cobs");
+}
@@ -0,0 +1,394 @@
+/*
+ * test_dfu.c
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "main.h"
+#include "DFU/DFU.h"
+#include "Random.h"
+#include "Test.h"
+
+/*
+ * Drives the DFU class the way the USB driver does: every control request
+ * goes through DFU_Setup, OUT data is copied into transfer.out one EP0 packet
+ * at a time before DFU_Data_Out, and DFU_Status_Done follows the status stage.
+ * The flash is a RAM array. DFU_Service() only runs while the host sleeps on
+ * a poll timeout, the latest point the main thread could get to it.
+ */
+
+#define TEST_IMAGE_SIZE     (64U * 1024U)
+#define TEST_ERASE_MS       3200U
+#define TEST_PROGRAM_MS     5U
+#define TEST_MANIFEST_MS    10U
+
+static uint8_t flash[TEST_IMAGE_SIZE];
+static uint8_t image[TEST_IMAGE_SIZE];
+
+static struct
+{
+	uint32_t erases;
+	uint32_t programs;
+	uint32_t manifests;
+	uint32_t manifest_size;
+	uint32_t stored_size;            // image length Upload reads back
+	uint32_t fail_offset;            // Program fails here, UINT32_MAX never
+	bool work;
+	bool detached;
+}sim;
+
+static DFU_Status Sim_Erase(void)
+{
+	sim.erases++;
+	memset(flash, 0xFF, sizeof(flash));
+	return DFU_STATUS_OK;
+}
+
+static DFU_Status Sim_Program(uint32_t offset, const uint8_t *data, uint16_t length)
+{
+	sim.programs++;
+	if (offset == sim.fail_offset) return DFU_STATUS_ERR_PROG;
+	for (uint16_t i = 0; i < length; i++) flash[offset + i] &= data[i];
+	return DFU_STATUS_OK;
+}
+
+static DFU_Status Sim_Manifest(uint32_t size)
+{
+	sim.manifests++;
+	sim.manifest_size = size;
+	return DFU_STATUS_OK;
+}
+
+static uint16_t Sim_Upload(uint32_t offset, const uint8_t **data, uint16_t length)
+{
+	if (offset >= sim.stored_size) return 0;
+	*data = &flash[offset];
+	return (sim.stored_size - offset < length) ? (uint16_t)(sim.stored_size - offset) : length;
+}
+
+static void Sim_Detach(void)
+{
+	sim.detached = true;
+}
+
+static void Sim_Work(void)
+{
+	sim.work = true;
+}
+
+static DFU_Config config = {
+		.Size = TEST_IMAGE_SIZE,
+		.Erase_Time_ms = TEST_ERASE_MS,
+		.Program_Time_ms = TEST_PROGRAM_MS,
+		.Manifest_Time_ms = TEST_MANIFEST_MS,
+		.Routines = {Sim_Erase, Sim_Program, Sim_Manifest, Sim_Upload, Sim_Detach, Sim_Work},
+};
+
+static void Setup_Test(void)
+{
+	memset(&sim, 0, sizeof(sim));
+	sim.fail_offset = UINT32_MAX;
+	memset(flash, 0xFF, sizeof(flash));
+	DFU_Init(&config);
+}
+
+/* Host to device request; data goes through EP0 in USB_EP0_SIZE packets. Returns < 0 when stalled */
+static int Control_Out(DFU_Request request, uint16_t value, const uint8_t *data, uint16_t length)
+{
+	USB_Setup setup = { USB_REQUEST_TYPE_CLASS | 0x01U, request, value, 0, length };
+	USB_Transfer transfer = { NULL, NULL, 0 };
+
+	if (DFU_Setup(&setup, &transfer) < 0) return -1;
+	if (length != 0U) {
+		if (transfer.out == NULL) return -1;
+		for (uint16_t done = 0; done < length; done += USB_EP0_SIZE) {
+			uint16_t packet = (length - done < USB_EP0_SIZE) ? (length - done) : USB_EP0_SIZE;
+			memcpy(transfer.out + done, data + done, packet);
+		}
+		if (DFU_Data_Out(&setup, length) < 0) return -1;
+	}
+	DFU_Status_Done(&setup);
+	return 0;
+}
+
+/* Device to host request; returns the bytes received, < 0 when stalled */
+static int Control_In(DFU_Request request, uint8_t *data, uint16_t length)
+{
+	USB_Setup setup = { USB_REQUEST_DIRECTION_IN | USB_REQUEST_TYPE_CLASS | 0x01U, request, 0, 0, length };
+	USB_Transfer transfer = { NULL, NULL, 0 };
+
+	if (DFU_Setup(&setup, &transfer) < 0) return -1;
+	uint16_t total = (transfer.length < length) ? transfer.length : length;
+	for (uint16_t done = 0; done < total; done += USB_EP0_SIZE) {
+		uint16_t packet = (total - done < USB_EP0_SIZE) ? (total - done) : USB_EP0_SIZE;
+		memcpy(data + done, transfer.in + done, packet);
+	}
+	DFU_Status_Done(&setup);
+	return total;
+}
+
+typedef struct Status
+{
+	DFU_Status status;
+	uint32_t poll_ms;
+	DFU_State state;
+}Status;
+
+static Status Get_Status(void)
+{
+	uint8_t reply[6];
+	Status status = { DFU_STATUS_ERR_UNKNOWN, 0, DFU_STATE_APP_IDLE };
+
+	if (Control_In(DFU_GETSTATUS, reply, sizeof(reply)) == 6) {
+		status.status = reply[0];
+		status.poll_ms = reply[1] | (reply[2] << 8) | ((uint32_t)reply[3] << 16);
+		status.state = reply[4];
+	}
+	return status;
+}
+
+/* The host sleeps for the poll timeout; the work it scheduled runs meanwhile */
+static void Host_Sleep(void)
+{
+	if (sim.work) {
+		sim.work = false;
+		DFU_Service();
+	}
+}
+
+/* Sends one block and polls until the device takes the next; returns the final status */
+static Status Download_Block(uint16_t block, const uint8_t *data, uint16_t length)
+{
+	Status status = { DFU_STATUS_ERR_STALLEDPKT, 0, DFU_STATE_ERROR };
+
+	if (Control_Out(DFU_DNLOAD, block, data, length) < 0) return status;
+	for (;;) {
+		status = Get_Status();
+		if (status.state != DFU_STATE_DNBUSY) return status;
+		Host_Sleep();
+	}
+}
+
+static void Fill_Image(uint32_t seed)
+{
+	Random_Seed(seed);
+	for (uint32_t i = 0; i < TEST_IMAGE_SIZE; i++) image[i] = (uint8_t)Random_Next();
+}
+
+static void Test_Full_Download(void)
+{
+	Setup_Test();
+	Fill_Image(7U);
+
+	// First block: the erase is announced with its poll time and only starts after that status stage
+	CHECK(Control_Out(DFU_DNLOAD, 0, image, DFU_TRANSFER_SIZE) == 0);
+	CHECK(!sim.work);
+	Status status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_DNBUSY);
+	CHECK_EQUAL(status.poll_ms, TEST_ERASE_MS);
+	CHECK(sim.work);
+	CHECK_EQUAL(sim.erases, 0);
+	Host_Sleep();
+	CHECK_EQUAL(sim.erases, 1);
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_DNLOAD_IDLE);
+
+	// The second block is accepted while nothing runs, the third waits for a free buffer
+	CHECK(Control_Out(DFU_DNLOAD, 1, image + DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE) == 0);
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_DNLOAD_IDLE);
+	CHECK(Control_Out(DFU_DNLOAD, 2, image + 2U * DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE) == 0);
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_DNBUSY);
+	CHECK_EQUAL(status.poll_ms, TEST_PROGRAM_MS);
+	Host_Sleep();
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_DNLOAD_IDLE);
+
+	for (uint16_t block = 3; block < TEST_IMAGE_SIZE / DFU_TRANSFER_SIZE; block++) {
+		status = Download_Block(block, image + block * DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE);
+		CHECK_EQUAL(status.state, DFU_STATE_DNLOAD_IDLE);
+		CHECK_EQUAL(status.status, DFU_STATUS_OK);
+	}
+
+	// Zero-length DNLOAD: the last queued block programs, then the manifest runs
+	CHECK(Control_Out(DFU_DNLOAD, 64, NULL, 0) == 0);
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_MANIFEST);
+	CHECK_EQUAL(status.poll_ms, TEST_MANIFEST_MS);
+	Host_Sleep();
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_IDLE);
+	CHECK_EQUAL(status.status, DFU_STATUS_OK);
+
+	CHECK_EQUAL(sim.erases, 1);
+	CHECK_EQUAL(sim.programs, TEST_IMAGE_SIZE / DFU_TRANSFER_SIZE);
+	CHECK_EQUAL(sim.manifests, 1);
+	CHECK_EQUAL(sim.manifest_size, TEST_IMAGE_SIZE);
+	CHECK(memcmp(flash, image, TEST_IMAGE_SIZE) == 0);
+
+	// Manifestation tolerant: detach from idle reaches the routine after its status stage
+	CHECK(Control_Out(DFU_DETACH, DFU_DETACH_TIMEOUT_MS, NULL, 0) == 0);
+	CHECK(sim.detached);
+}
+
+static void Test_Short_Last_Block(void)
+{
+	Setup_Test();
+	Fill_Image(11U);
+
+	CHECK_EQUAL(Download_Block(0, image, DFU_TRANSFER_SIZE).state, DFU_STATE_DNLOAD_IDLE);
+	CHECK_EQUAL(Download_Block(1, image + DFU_TRANSFER_SIZE, 100).state, DFU_STATE_DNLOAD_IDLE);
+	CHECK(Control_Out(DFU_DNLOAD, 2, NULL, 0) == 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_MANIFEST);
+	Host_Sleep();
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_IDLE);
+	CHECK_EQUAL(sim.manifest_size, DFU_TRANSFER_SIZE + 100U);
+	CHECK(memcmp(flash, image, DFU_TRANSFER_SIZE + 100U) == 0);
+	CHECK_EQUAL(flash[DFU_TRANSFER_SIZE + 100U], 0xFF);
+}
+
+static void Test_Program_Error(void)
+{
+	Setup_Test();
+	Fill_Image(13U);
+	sim.fail_offset = 2U * DFU_TRANSFER_SIZE;
+
+	CHECK_EQUAL(Download_Block(0, image, DFU_TRANSFER_SIZE).state, DFU_STATE_DNLOAD_IDLE);
+	CHECK_EQUAL(Download_Block(1, image + DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE).state, DFU_STATE_DNLOAD_IDLE);
+
+	// Both buffers are full, the host sleeps, and the failed block surfaces when it polls again
+	Status status = Download_Block(2, image + 2U * DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE);
+	CHECK_EQUAL(status.state, DFU_STATE_ERROR);
+	CHECK_EQUAL(status.status, DFU_STATUS_ERR_PROG);
+
+	// It sticks until CLRSTATUS
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_ERROR);
+	CHECK_EQUAL(status.status, DFU_STATUS_ERR_PROG);
+	CHECK(Control_Out(DFU_DNLOAD, 3, image, DFU_TRANSFER_SIZE) < 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_ERROR);
+
+	CHECK(Control_Out(DFU_CLRSTATUS, 0, NULL, 0) == 0);
+	status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_IDLE);
+	CHECK_EQUAL(status.status, DFU_STATUS_OK);
+
+	// A new download after the error erases again
+	sim.fail_offset = UINT32_MAX;
+	CHECK_EQUAL(Download_Block(0, image, DFU_TRANSFER_SIZE).state, DFU_STATE_DNLOAD_IDLE);
+	CHECK_EQUAL(sim.erases, 2);
+}
+
+static void Test_Abort_Skips_Queued_Block(void)
+{
+	Setup_Test();
+	Fill_Image(17U);
+
+	CHECK_EQUAL(Download_Block(0, image, DFU_TRANSFER_SIZE).state, DFU_STATE_DNLOAD_IDLE);
+	CHECK_EQUAL(Download_Block(1, image + DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE).state, DFU_STATE_DNLOAD_IDLE);
+	uint32_t programs = sim.programs;
+
+	CHECK(Control_Out(DFU_ABORT, 0, NULL, 0) == 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_IDLE);
+	DFU_Service();
+	CHECK_EQUAL(sim.programs, programs);
+	CHECK_EQUAL(flash[DFU_TRANSFER_SIZE], 0xFF);
+}
+
+static void Test_Bus_Reset_Skips_Erase(void)
+{
+	Setup_Test();
+	Fill_Image(19U);
+
+	CHECK(Control_Out(DFU_DNLOAD, 0, image, DFU_TRANSFER_SIZE) == 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_DNBUSY);
+	DFU_Reset();
+	Host_Sleep();
+	CHECK_EQUAL(sim.erases, 0);
+	CHECK_EQUAL(sim.programs, 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_IDLE);
+}
+
+static void Test_Upload(void)
+{
+	static uint8_t received[TEST_IMAGE_SIZE];
+	uint32_t total = 0;
+	int length;
+
+	Setup_Test();
+	Fill_Image(23U);
+	memcpy(flash, image, sizeof(flash));
+	sim.stored_size = 2U * DFU_TRANSFER_SIZE + 952U;
+
+	do {
+		length = Control_In(DFU_UPLOAD, received + total, DFU_TRANSFER_SIZE);
+		CHECK(length >= 0);
+		if (length > 0) total += length;
+		if (length == DFU_TRANSFER_SIZE) CHECK_EQUAL(Get_Status().state, DFU_STATE_UPLOAD_IDLE);
+	} while (length == DFU_TRANSFER_SIZE);
+
+	CHECK_EQUAL(length, 952);
+	CHECK_EQUAL(total, sim.stored_size);
+	CHECK(memcmp(received, image, total) == 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_IDLE);
+
+	// No image: the first block is already short
+	sim.stored_size = 0;
+	CHECK_EQUAL(Control_In(DFU_UPLOAD, received, DFU_TRANSFER_SIZE), 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_IDLE);
+}
+
+static void Test_Oversize_Image(void)
+{
+	Setup_Test();
+	Fill_Image(29U);
+
+	for (uint16_t block = 0; block < TEST_IMAGE_SIZE / DFU_TRANSFER_SIZE; block++) {
+		Download_Block(block, image + block * DFU_TRANSFER_SIZE, DFU_TRANSFER_SIZE);
+	}
+	CHECK(Control_Out(DFU_DNLOAD, 64, image, 4) < 0);
+	Status status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_ERROR);
+	CHECK_EQUAL(status.status, DFU_STATUS_ERR_ADDRESS);
+}
+
+static void Test_Bad_Requests(void)
+{
+	uint8_t big[DFU_TRANSFER_SIZE + 64U] = { 0 };
+
+	Setup_Test();
+
+	// A zero-length DNLOAD is only the end of a download, never its start
+	CHECK(Control_Out(DFU_DNLOAD, 0, NULL, 0) < 0);
+	Status status = Get_Status();
+	CHECK_EQUAL(status.state, DFU_STATE_ERROR);
+	CHECK_EQUAL(status.status, DFU_STATUS_ERR_STALLEDPKT);
+	CHECK(Control_Out(DFU_CLRSTATUS, 0, NULL, 0) == 0);
+
+	CHECK(Control_Out(DFU_DNLOAD, 0, big, sizeof(big)) < 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_ERROR);
+	CHECK(Control_Out(DFU_CLRSTATUS, 0, NULL, 0) == 0);
+
+	// CLRSTATUS outside the error state is itself an error
+	CHECK(Control_Out(DFU_CLRSTATUS, 0, NULL, 0) < 0);
+	CHECK_EQUAL(Get_Status().state, DFU_STATE_ERROR);
+	CHECK(Control_Out(DFU_CLRSTATUS, 0, NULL, 0) == 0);
+
+	uint8_t state = 0xFF;
+	CHECK_EQUAL(Control_In(DFU_GETSTATE, &state, 1), 1);
+	CHECK_EQUAL(state, DFU_STATE_IDLE);
+	CHECK_EQUAL(sim.erases, 0);
+}
+
+int main(void)
+{
+	Test_Full_Download();
+	Test_Short_Last_Block();
+	Test_Program_Error();
+	Test_Abort_Skips_Queued_Block();
+	Test_Bus_Reset_Skips_Erase();
+	Test_Upload();
+	Test_Oversize_Image();
+	Test_Bad_Requests();
+	return Test_Result("test_dfu");
+}